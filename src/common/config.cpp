@@ -29,6 +29,7 @@ using namespace std;
 #define CFG_JSON_PATH_LOGPATH      "LOGPATH"
 #define CFG_JSON_PATH_BIND_IP      "BINDADDR.IP"
 #define CFG_JSON_PATH_BIND_PORT    "BINDADDR.PORT"
+#define CFG_JSON_PATH_ZONE         "ZONE"
 #define CFG_JSON_PATH_JOINADDR     "JOINADDR"
 #define CFG_JSON_PATH_ADDR_IP      "IP"
 #define CFG_JSON_PATH_ADDR_PORT    "PORT"
@@ -36,6 +37,32 @@ using namespace std;
 #define CFG_JSON_PATH_TREMOVE      "PROTOCOL_PARAM.TREMOVE"
 #define CFG_JSON_PATH_PORT_NM      "PROTOCOL_PARAM.NAME"
 #define CFG_JSON_PATH_GOSSIP_B     "PROTOCOL_PARAM.GOSSIP.B"
+#define CFG_JSON_PATH_FEED_SIZE    "STORE_PARAM.CHANGE_FEED.SIZE"
+#define CFG_JSON_PATH_FEED_BATCH   "STORE_PARAM.CHANGE_FEED.BATCH"
+#define CFG_JSON_PATH_WATCH_WINDOW "STORE_PARAM.WATCH.COALESCE"
+#define CFG_JSON_PATH_DIGEST_READ  "STORE_PARAM.READ.DIGEST"
+#define CFG_JSON_PATH_REPAIR_RATE  "STORE_PARAM.READ.REPAIR_RATE"
+#define CFG_JSON_PATH_COALESCE     "STORE_PARAM.READ.COALESCE"
+#define CFG_JSON_PATH_HEDGE_PCT    "STORE_PARAM.READ.HEDGE_PERCENTILE"
+#define CFG_JSON_PATH_HEDGE_DELAY  "STORE_PARAM.READ.HEDGE_DELAY"
+#define CFG_JSON_PATH_HINT_MAX     "STORE_PARAM.HINT.MAX"
+#define CFG_JSON_PATH_HINT_TTL     "STORE_PARAM.HINT.TTL"
+#define CFG_JSON_PATH_HINT_BATCH   "STORE_PARAM.HINT.BATCH"
+#define CFG_JSON_PATH_TRAN_SHARDS  "STORE_PARAM.TRAN_SHARDS"
+#define CFG_JSON_PATH_LOCAL_FAST   "STORE_PARAM.LOCAL_FAST_PATH"
+#define CFG_JSON_PATH_ADMIT_QUEUE  "STORE_PARAM.ADMISSION.MAX_STORE_QUEUE"
+#define CFG_JSON_PATH_ADMIT_PEND   "STORE_PARAM.ADMISSION.MAX_PENDING"
+#define CFG_JSON_PATH_ADMIT_MEM    "STORE_PARAM.ADMISSION.MAX_MEMORY"
+#define CFG_JSON_PATH_SCHED_FLIGHT "STORE_PARAM.SCHED.MAX_INFLIGHT"
+#define CFG_JSON_PATH_TENANTS      "STORE_PARAM.TENANTS"
+#define CFG_JSON_PATH_HOT_THRESH   "STORE_PARAM.HOT_KEY.THRESHOLD"
+#define CFG_JSON_PATH_HOT_WINDOW   "STORE_PARAM.HOT_KEY.WINDOW"
+#define CFG_JSON_PATH_HOT_TTL      "STORE_PARAM.HOT_KEY.TTL"
+#define CFG_JSON_PATH_HOT_CAPACITY "STORE_PARAM.HOT_KEY.CAPACITY"
+#define CFG_JSON_PATH_BATCH_MAX    "STORE_PARAM.BATCH.MAX"
+#define CFG_JSON_PATH_BATCH_BYTES  "STORE_PARAM.BATCH.MAX_BYTES"
+#define CFG_JSON_PATH_BATCH_DELAY  "STORE_PARAM.BATCH.DELAY"
+#define CFG_JSON_PATH_RING_VNODES  "STORE_PARAM.RING.VNODES"
 
 /*
  *******************************************************************************
@@ -159,6 +186,11 @@ unsigned short ConfigPortal::get_bindport() const
                        0);
 }
 
+uint16 ConfigPortal::get_zone() const
+{
+    return m_ptree.get<uint16>(CFG_JSON_PATH_ZONE, MEM_PROT_DEF_ZONE);
+}
+
 long ConfigPortal::get_ringsize() const
 {
     return KV_RING_DEF_SIZE;
@@ -188,6 +220,143 @@ int ConfigPortal::get_quorum_num() const {
     return PLUTO_NODE_REPLICAS_NUM / 2 + 1;
 }
 
+size_t ConfigPortal::get_change_feed_size() const
+{
+    return m_ptree.get(CFG_JSON_PATH_FEED_SIZE, KV_CHANGE_FEED_DEF_SIZE);
+}
+
+size_t ConfigPortal::get_change_feed_batch() const
+{
+    return m_ptree.get(CFG_JSON_PATH_FEED_BATCH, KV_CHANGE_FEED_DEF_BATCH);
+}
+
+int ConfigPortal::get_watch_coalesce_window() const
+{
+    return m_ptree.get(CFG_JSON_PATH_WATCH_WINDOW, KV_WATCH_DEF_COALESCE);
+}
+
+bool ConfigPortal::is_digest_read() const
+{
+    return m_ptree.get(CFG_JSON_PATH_DIGEST_READ, KV_DIGEST_READ_DEF);
+}
+
+bool ConfigPortal::is_read_coalesce() const
+{
+    return m_ptree.get(CFG_JSON_PATH_COALESCE, KV_READ_COALESCE_DEF);
+}
+
+int ConfigPortal::get_read_repair_rate() const
+{
+    return m_ptree.get(CFG_JSON_PATH_REPAIR_RATE, KV_READ_REPAIR_DEF_RATE);
+}
+
+double ConfigPortal::get_hedge_percentile() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HEDGE_PCT, KV_HEDGE_DEF_PERCENTILE);
+}
+
+int ConfigPortal::get_hedge_delay() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HEDGE_DELAY, KV_HEDGE_DEF_DELAY);
+}
+
+int ConfigPortal::get_hint_max() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HINT_MAX, KV_HINT_DEF_MAX);
+}
+
+int ConfigPortal::get_hint_ttl() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HINT_TTL, KV_HINT_DEF_TTL);
+}
+
+int ConfigPortal::get_hint_batch() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HINT_BATCH, KV_HINT_DEF_BATCH);
+}
+
+int ConfigPortal::get_tran_shards() const
+{
+    return m_ptree.get(CFG_JSON_PATH_TRAN_SHARDS, KV_TRAN_DEF_SHARDS);
+}
+
+bool ConfigPortal::is_local_fast_path() const
+{
+    return m_ptree.get(CFG_JSON_PATH_LOCAL_FAST, KV_LOCAL_FAST_PATH_DEF);
+}
+
+int ConfigPortal::get_admit_store_queue() const
+{
+    return m_ptree.get(CFG_JSON_PATH_ADMIT_QUEUE, KV_ADMIT_DEF_STORE_QUEUE);
+}
+
+int ConfigPortal::get_admit_pending() const
+{
+    return m_ptree.get(CFG_JSON_PATH_ADMIT_PEND, KV_ADMIT_DEF_PENDING);
+}
+
+int ConfigPortal::get_admit_memory() const
+{
+    return m_ptree.get(CFG_JSON_PATH_ADMIT_MEM, KV_ADMIT_DEF_MEMORY);
+}
+
+int ConfigPortal::get_sched_inflight() const
+{
+    return m_ptree.get(CFG_JSON_PATH_SCHED_FLIGHT, KV_SCHED_DEF_INFLIGHT);
+}
+
+int ConfigPortal::get_tenant_weight(int tenant) const
+{
+    string path = string(CFG_JSON_PATH_TENANTS) + "." + to_string(tenant) + ".WEIGHT";
+    return m_ptree.get(path, KV_TENANT_DEF_WEIGHT);
+}
+
+int ConfigPortal::get_tenant_inflight(int tenant) const
+{
+    string path = string(CFG_JSON_PATH_TENANTS) + "." + to_string(tenant) + ".MAX_INFLIGHT";
+    return m_ptree.get(path, KV_TENANT_DEF_INFLIGHT);
+}
+
+int ConfigPortal::get_hot_key_threshold() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HOT_THRESH, KV_HOT_KEY_DEF_THRESHOLD);
+}
+
+int ConfigPortal::get_hot_key_window() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HOT_WINDOW, KV_HOT_KEY_DEF_WINDOW);
+}
+
+int ConfigPortal::get_hot_key_ttl() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HOT_TTL, KV_HOT_KEY_DEF_TTL);
+}
+
+int ConfigPortal::get_hot_key_capacity() const
+{
+    return m_ptree.get(CFG_JSON_PATH_HOT_CAPACITY, KV_HOT_KEY_DEF_CAPACITY);
+}
+
+int ConfigPortal::get_batch_max() const
+{
+    return m_ptree.get(CFG_JSON_PATH_BATCH_MAX, KV_BATCH_DEF_MAX);
+}
+
+int ConfigPortal::get_batch_bytes() const
+{
+    return m_ptree.get(CFG_JSON_PATH_BATCH_BYTES, KV_BATCH_DEF_BYTES);
+}
+
+int ConfigPortal::get_batch_delay() const
+{
+    return m_ptree.get(CFG_JSON_PATH_BATCH_DELAY, KV_BATCH_DEF_DELAY);
+}
+
+int ConfigPortal::get_ring_vnodes() const
+{
+    return m_ptree.get(CFG_JSON_PATH_RING_VNODES, KV_RING_DEF_VNODES);
+}
+
 ConfigPortal* GetConfigPortal()
 {
     return ConfigPortal::get_config();
@@ -64,6 +64,9 @@ public:
     std::vector<IPAddr> get_joinaddress() const;
     std::string get_bindip() const;
     unsigned short get_bindport() const;
+    // Rack or zone of this node, replicas of a key are put in different
+    // zones. 0 unknown
+    uint16 get_zone() const;
 
     /**
      * Protocal parameters
@@ -83,6 +86,66 @@ public:
 
     int get_quorum_num() const ;
 
+    /**
+     * Store parameters
+     */
+    // Number of mutations kept by change feed
+    size_t get_change_feed_size() const;
+    // Maximum number of records carried by one feed message
+    size_t get_change_feed_batch() const;
+    // Window in milliseconds to coalesce changes of a watched key
+    int get_watch_coalesce_window() const;
+    // Read the value from one replica and digests from the others
+    bool is_digest_read() const;
+    // Concurrent reads of a key at a coordinator share one transaction
+    bool is_read_coalesce() const;
+    // Read repairs sent to one node per second, 0 disables read repair
+    int get_read_repair_rate() const;
+    // Replica read latency percentile after which a speculative read is sent
+    // to another replica, 0 disables hedged reads
+    double get_hedge_percentile() const;
+    // Delay in milliseconds of speculative read until latencies are known
+    int get_hedge_delay() const;
+    // Hints of writes kept for unavailable replicas, 0 disables hinted handoff
+    int get_hint_max() const;
+    // Seconds a hint is kept before it is dropped
+    int get_hint_ttl() const;
+    // Hints replayed to a node at a time
+    int get_hint_batch() const;
+    // Shards of pending client transactions, 0 is one per hardware thread
+    int get_tran_shards() const;
+    // Answer the client from the local replica directly when it alone
+    // satisfies the request
+    bool is_local_fast_path() const;
+    // Client requests are rejected with BUSY once store operations queued,
+    // pending transactions, or resident memory in MB reaches these. 0
+    // disables the check
+    int get_admit_store_queue() const;
+    int get_admit_pending() const;
+    int get_admit_memory() const;
+    // Client requests in flight before they are queued by tenant, 0 disables
+    // fair queuing
+    int get_sched_inflight() const;
+    // Fair queuing weight and in-flight cap (0 no cap) of a tenant, from
+    // STORE_PARAM.TENANTS.<tenant>
+    int get_tenant_weight(int tenant) const;
+    int get_tenant_inflight(int tenant) const;
+    // A key read this many times in a window (ms) is hot, 0 disables the
+    // hot key cache. Values of hot keys are cached for TTL (ms), up to
+    // capacity keys
+    int get_hot_key_threshold() const;
+    int get_hot_key_window() const;
+    int get_hot_key_ttl() const;
+    int get_hot_key_capacity() const;
+    // Replica writes to a peer are sent in one frame, up to max requests (1
+    // disables batching) and max bytes (0 no cap). The first one waits delay
+    // microseconds for others
+    int get_batch_max() const;
+    int get_batch_bytes() const;
+    int get_batch_delay() const;
+    // Tokens of every member on the store ring
+    int get_ring_vnodes() const;
+
     const std::string& get_config_filename() const {
         return m_cfg_fn;
     }
@@ -65,7 +65,7 @@ struct MemberEntry {
     int32   type;
     uint8   address[PL_IPv6_ADDR_LEN]; // IPv6: 16 bytes, IPv4: 4 bytes
     uint16  portnumber;
-    uint16  reserved;
+    uint16  zone;      // rack or zone of the node, 0 unknown
     int32   next;
 };
 
@@ -101,6 +101,7 @@ public:
         getlog()->sendlog(LogLevel::DEBUG, "af        = %d\n",  e.af);
         getlog()->sendlog(LogLevel::DEBUG, "type      = %d\n",  e.type);
         getlog()->sendlog(LogLevel::DEBUG, "port      = %d\n",  e.portnumber);
+        getlog()->sendlog(LogLevel::DEBUG, "zone      = %d\n",  e.zone);
         getlog()->sendlog(LogLevel::DEBUG, "addr      = ");
         unsigned int i;
         for (i=0; i< PL_IPv6_ADDR_LEN - 1; i++) {
@@ -47,6 +47,17 @@ enum class MsgType : uint32 {
     READRESP,
     DELETEREQ,
     DELETERESP,
+    FEEDREQ,
+    FEEDRESP,
+    WATCHREQ,
+    WATCHRESP,
+    UNWATCHREQ,
+    UNWATCHRESP,
+    WATCHNOTIFY,
+    REPAIRREQ,
+    REPAIRRESP,
+    BATCHREQ,
+    BATCHRESP,
     PLUTO_LAST,
     INVTYPE=PLUTO_LAST
 };
@@ -55,6 +66,8 @@ enum class MsgStatus : int {
     PLUTO_FIRST=0,
     OK=PLUTO_FIRST,
     ERROR,
+    BUSY,       // Overloaded, request rejected without being served
+    CONFLICT,   // Expected version of conditional write mismatch
     PLUTO_LAST,
 };
 
@@ -87,6 +100,17 @@ inline std::string get_desc_msgtype(MsgType type)
     case MsgType::READRESP:   return "READRESP";
     case MsgType::DELETEREQ:  return "DELETEREQ";
     case MsgType::DELETERESP: return "DELETERESP";
+    case MsgType::FEEDREQ:    return "FEEDREQ";
+    case MsgType::FEEDRESP:   return "FEEDRESP";
+    case MsgType::WATCHREQ:   return "WATCHREQ";
+    case MsgType::WATCHRESP:  return "WATCHRESP";
+    case MsgType::UNWATCHREQ: return "UNWATCHREQ";
+    case MsgType::UNWATCHRESP:return "UNWATCHRESP";
+    case MsgType::WATCHNOTIFY:return "WATCHNOTIFY";
+    case MsgType::REPAIRREQ:  return "REPAIRREQ";
+    case MsgType::REPAIRRESP: return "REPAIRRESP";
+    case MsgType::BATCHREQ:   return "BATCHREQ";
+    case MsgType::BATCHRESP:  return "BATCHRESP";
     default: return "Unknown";
     }
 }
@@ -49,14 +49,52 @@
 #define MEM_PROT_DEF_TFAIL     5
 #define MEM_PROT_DEF_TREMOVE   20
 #define MEM_PROT_DEF_NAME      "GOSSIP" 
+#define MEM_PROT_DEF_ZONE      0
 
 #define MEM_PROT_DEF_GOSSIP_B  3
 
+/* Store parameters */
+#define KV_CHANGE_FEED_DEF_SIZE   65536  // Mutations kept by change feed
+#define KV_CHANGE_FEED_DEF_BATCH  256    // Maximum records per feed message
+#define KV_WATCH_DEF_COALESCE     5      // Watch notification coalesce window, ms
+#define KV_DIGEST_READ_DEF        true   // Digest reads enabled
+#define KV_READ_REPAIR_DEF_RATE   100    // Read repairs per node per second
+#define KV_HEDGE_DEF_PERCENTILE   95.0   // Hedged read delay percentile
+#define KV_HEDGE_DEF_DELAY        10     // Hedged read delay without samples, ms
+#define KV_HEDGE_MIN_SAMPLES      100    // Samples before percentile is used
+#define KV_LATENCY_DEF_WINDOW     4096   // Samples before latencies decay
+#define KV_HINT_DEF_MAX           65536  // Hints kept for unavailable replicas
+#define KV_HINT_DEF_TTL           600    // Hint time to live, seconds
+#define KV_HINT_DEF_BATCH         64     // Hints replayed to a node at a time
+#define KV_TRAN_DEF_SHARDS        0      // Transaction shards, 0 for hardware threads
+#define KV_TRAN_POOL_DEF_SIZE     1024   // Free transactions kept by a pool
+#define KV_LOCAL_FAST_PATH_DEF    true   // Local fast path enabled
+#define KV_ADMIT_DEF_STORE_QUEUE  10000  // Store operations queued before shedding
+#define KV_ADMIT_DEF_PENDING      100000 // Pending transactions before shedding
+#define KV_ADMIT_DEF_MEMORY       0      // Resident memory before shedding, MB
+#define KV_SCHED_DEF_INFLIGHT     1024   // Client requests in flight before queuing
+#define KV_TENANT_DEF_WEIGHT      1      // Fair queuing weight of a tenant
+#define KV_TENANT_DEF_INFLIGHT    0      // Requests in flight of a tenant, 0 no cap
+#define KV_READ_COALESCE_DEF      true   // Concurrent reads of a key coalesced
+#define KV_HOT_KEY_DEF_THRESHOLD  100    // Reads of a key in a window it is hot, 0 disables
+#define KV_HOT_KEY_DEF_WINDOW     1000   // Hot key counters are halved every window, ms
+#define KV_HOT_KEY_DEF_TTL        50     // Time to live of a cached value, ms
+#define KV_HOT_KEY_DEF_CAPACITY   1024   // Hot keys cached
+#define KV_HOT_KEY_SKETCH_DEPTH   4      // Rows of hot key sketch
+#define KV_HOT_KEY_SKETCH_WIDTH   2048   // Counters of a row of hot key sketch
+#define KV_BATCH_DEF_MAX          64     // Replica requests in a batch frame, 1 disables
+#define KV_BATCH_DEF_BYTES        65536  // Bytes of a batch frame, 0 no cap
+#define KV_BATCH_DEF_DELAY        20     // Replica write lingers for a batch, us
+#define KV_RING_DEF_VNODES        128    // Tokens of a member on the store ring
+#define KV_MEMBER_WATCH_DEF_WAIT  1000   // Member watcher checks for stop, ms
+
 /* Environment variable names */
 #define ENV_NM_BASE_IPCKEY    "PLUTO_IPCKEY" 
 
 #define    PLSUCCESS    0
 #define    PLERROR      1
+#define    PLEXPIRED    2     // Deadline of the request passed
+#define    PLCONFLICT   3     // Expected version of conditional write mismatch
 
 /**
  *******************************************************************************
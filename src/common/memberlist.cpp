@@ -13,8 +13,15 @@
  */
 
 #include <cstddef>
+#include <climits>
 #include <stdexcept>
 
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
 #include "memberlist.h"
 #include "pladdress.h"
 
@@ -93,7 +100,9 @@ void MemberList::detach()
 void MemberList::clear()
 {
     if (m_ptab) {
+        write_seqbegin();
         m_ptab->clear();
+        write_seqend(true);
     }
 }
 
@@ -130,7 +139,7 @@ entry_iterator MemberList::end()
 }
 
 void MemberList::add_node(int af, const uint8 * addr, unsigned short port,
-                          int64 hb, time_t now)
+                          int64 hb, uint16 zone, time_t now)
 {
     if (!valid_node_addr(af, SOCK_STREAM, addr, port)) {
         throw std::invalid_argument("Invalid node address");
@@ -154,8 +163,17 @@ void MemberList::add_node(int af, const uint8 * addr, unsigned short port,
     node.type      = SOCK_STREAM;
     node.heartbeat = hb;
     node.tm_lasthb = now;
+    node.zone      = zone;
 
-    m_ptab->insert(node);
+    write_seqbegin();
+    try {
+        m_ptab->insert(node);
+    }
+    catch (...) {
+        write_seqend(false);
+        throw;
+    }
+    write_seqend(true);
 }
 
 void MemberList::del_node(int af, const uint8 * addr, unsigned short port)
@@ -181,7 +199,9 @@ void MemberList::del_node(int af, const uint8 * addr, unsigned short port)
     node.type       = SOCK_STREAM;
     node.portnumber = port;
 
+    write_seqbegin();
     m_ptab->erase(node);
+    write_seqend(true);
 }
 
 void MemberList::update_node_heartbeat(int af, const uint8 * addr, unsigned short port,
@@ -211,7 +231,9 @@ void MemberList::update_node_heartbeat(int af, const uint8 * addr, unsigned shor
     node.heartbeat = hb;
     node.tm_lasthb = now;
 
+    write_seqbegin();
     m_ptab->update(node);
+    write_seqend(false);
 }
 
 int MemberList::get_node_heartbeat(int af, const uint8 * addr, unsigned short port,
@@ -246,12 +268,29 @@ int MemberList::get_node_heartbeat(int af, const uint8 * addr, unsigned short po
 
 void MemberList::bulk_add(const std::vector< struct MemberEntry > & nodes)
 {
-    m_ptab->bulk_add(nodes);
+    if (nodes.empty()) {
+        return;
+    }
+
+    // Entries already in the table are only overwritten, membership changes
+    // only if rows were added
+    size_t cnt = m_ptab->size();
+    write_seqbegin();
+    try {
+        m_ptab->bulk_add(nodes);
+    }
+    catch (...) {
+        write_seqend(m_ptab->size() != cnt);
+        throw;
+    }
+    write_seqend(m_ptab->size() != cnt);
 }
 
 void MemberList::bulk_update(const std::vector< struct MemberEntry > &nodes, time_t now)
 {
+    write_seqbegin();
     m_ptab->bulk_update(nodes, now);
+    write_seqend(false);
 }
 
 std::vector<std::pair<bool, int64> > MemberList::bulk_get(const std::vector< struct MemberEntry > & nodes)
@@ -397,3 +436,66 @@ uint64 MemberList::get_ring_size() const
     return 0;
 }
 
+void MemberList::write_seqbegin()
+{
+    if (m_paddr) {
+        __atomic_add_fetch(&m_paddr->seq, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+void MemberList::write_seqend(bool changed)
+{
+    if (m_paddr == nullptr) {
+        return;
+    }
+    __atomic_add_fetch(&m_paddr->seq, 1, __ATOMIC_RELEASE);
+    if (changed) {
+        __atomic_add_fetch(&m_paddr->generation, 1, __ATOMIC_RELEASE);
+        // Waiters are in other processes, so not a private futex
+        syscall(SYS_futex, &m_paddr->generation, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+uint32 MemberList::read_seqbegin() const
+{
+    if (m_paddr == nullptr) {
+        return 0;
+    }
+    uint32 seq;
+    while ((seq = __atomic_load_n(&m_paddr->seq, __ATOMIC_ACQUIRE)) & 1) {
+        sched_yield();
+    }
+    return seq;
+}
+
+bool MemberList::read_seqretry(uint32 seq) const
+{
+    if (m_paddr == nullptr) {
+        return false;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&m_paddr->seq, __ATOMIC_RELAXED) != seq;
+}
+
+uint32 MemberList::get_generation() const
+{
+    if (m_paddr) {
+        return __atomic_load_n(&m_paddr->generation, __ATOMIC_ACQUIRE);
+    }
+    return 0;
+}
+
+uint32 MemberList::wait_generation(uint32 seen, int timeout) const
+{
+    if (m_paddr == nullptr) {
+        return 0;
+    }
+
+    struct timespec ts;
+    ts.tv_sec  = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    // Returns at once if generation isn't 'seen' any more
+    syscall(SYS_futex, &m_paddr->generation, FUTEX_WAIT, seen, &ts, nullptr, 0);
+    return get_generation();
+}
+
@@ -73,13 +73,13 @@ struct Membership {
     uint8   join_addr1[16];
     uint16  join_addr1_port;
     uint16  join_addr2_exist;
-    uint32  reserved1;
+    uint32  seq;            // odd while member table is being written
     uint32  join_add2_af;   
     uint32  join_add2_type; 
     uint8   join_addr2[16];
     uint16  join_addr2_port;
     uint16  reserved2;
-    uint32  reserved3;
+    uint32  generation;     // bumped when members join or leave, futex word
     struct st_entry ent_tab;
 };
 
@@ -107,7 +107,7 @@ public:
     entry_iterator end() const;
 
     void add_node(int af, const uint8 * addr, unsigned short port,
-                  int64 hb, time_t now = std::time(NULL));
+                  int64 hb, uint16 zone = 0, time_t now = std::time(NULL));
     void del_node(int af, const uint8 * addr, unsigned short port);
     void update_node_heartbeat(int af, const uint8 * addr, 
                                unsigned short port,
@@ -162,8 +162,22 @@ public:
 
     pthread_mutex_t* get_mutex() const;
 
+    // Member table is written by membership process only and read by others
+    // without lock: a reader takes the sequence before reading and retries
+    // if it is changed after. Heartbeat updates don't change generation
+    uint32 read_seqbegin() const;
+    bool read_seqretry(uint32 seq) const;
+
+    uint32 get_generation() const;
+    // Blocks until generation isn't 'seen' or timeout (milliseconds) passes,
+    // returns the current generation
+    uint32 wait_generation(uint32 seen, int timeout) const;
+
 protected:
     bool init_entry_table(bool create=false);
+    void write_seqbegin();
+    // 'changed' - members joined or left, bump generation and wake waiters
+    void write_seqend(bool changed);
     bool valid_child_status(uint8 st) const;
     bool valid_node_addr(int af, int type, const uint8 * addr, 
                          unsigned short port);
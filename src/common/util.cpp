@@ -18,6 +18,7 @@
 #include <cctype>
 
 #include <string>
+#include <chrono>
 #include <stdexcept>
 
 #include <signal.h>
@@ -260,3 +261,96 @@ boost::asio::ip::address rawip2address(int af, const unsigned char *ip)
 
     return boost::asio::ip::address();
 }
+
+int64 get_deadline_now()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+bool is_deadline_passed(int64 deadline)
+{
+    return (deadline > 0) && (get_deadline_now() >= deadline);
+}
+
+namespace {
+
+const uint64 HASH_SECRET[4] = { 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+                                0x8ebc6af09c88c6dbULL, 0x589965cc75374cc3ULL };
+
+inline uint64 hash_mix(uint64 a, uint64 b)
+{
+    unsigned __int128 r = a;
+    r *= b;
+    return static_cast<uint64>(r) ^ static_cast<uint64>(r >> 64);
+}
+
+// Little endian reads, compiled to plain loads on x86
+inline uint64 hash_read8(const unsigned char* p)
+{
+    uint64 v = 0;
+    for (int i=7; i>=0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+inline uint64 hash_read4(const unsigned char* p)
+{
+    return static_cast<uint64>(p[0]) | (static_cast<uint64>(p[1]) << 8) |
+           (static_cast<uint64>(p[2]) << 16) | (static_cast<uint64>(p[3]) << 24);
+}
+
+}
+
+uint64 get_hash64(const void* data, size_t sz, uint64 seed)
+{
+    const unsigned char * p = static_cast<const unsigned char*>(data);
+    uint64 a, b;
+
+    seed ^= hash_mix(seed ^ HASH_SECRET[0], HASH_SECRET[1]);
+    if (sz <= 16) {
+        if (sz >= 4) {
+            size_t off = (sz >> 3) << 2;
+            a = (hash_read4(p) << 32) | hash_read4(p + off);
+            b = (hash_read4(p + sz - 4) << 32) | hash_read4(p + sz - 4 - off);
+        }
+        else if (sz > 0) {
+            a = (static_cast<uint64>(p[0]) << 16) | (static_cast<uint64>(p[sz >> 1]) << 8) | p[sz - 1];
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t i = sz;
+        if (i > 48) {
+            // Three independent lanes keep the multipliers busy
+            uint64 see1 = seed, see2 = seed;
+            do {
+                seed = hash_mix(hash_read8(p) ^ HASH_SECRET[1], hash_read8(p + 8) ^ seed);
+                see1 = hash_mix(hash_read8(p + 16) ^ HASH_SECRET[2], hash_read8(p + 24) ^ see1);
+                see2 = hash_mix(hash_read8(p + 32) ^ HASH_SECRET[3], hash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hash_mix(hash_read8(p) ^ HASH_SECRET[1], hash_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hash_read8(p + i - 16);
+        b = hash_read8(p + i - 8);
+    }
+
+    a ^= HASH_SECRET[1];
+    b ^= seed;
+    unsigned __int128 r = a;
+    r *= b;
+    a = static_cast<uint64>(r);
+    b = static_cast<uint64>(r >> 64);
+    return hash_mix(a ^ HASH_SECRET[0] ^ sz, b ^ HASH_SECRET[1]);
+}
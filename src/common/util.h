@@ -20,12 +20,18 @@
 #include <string>
 #include <boost/asio.hpp>
 
+#include "pltypes.h"
+
 /**
  *******************************************************************************
  * Constants                                                                   *
  *******************************************************************************
  */
 
+// Seed of key hash, keys are placed on the ring by it so all nodes of a
+// cluster must agree
+#define PLUTO_HASH_SEED   0x706C75746F6B6579ULL
+
 /**
  *******************************************************************************
  * Function declaractions                                                      *
@@ -43,5 +49,18 @@ boost::asio::ip::tcp::endpoint ip2tcpend(const std::string& ip, unsigned short p
 
 boost::asio::ip::address rawip2address(int af, const unsigned char *rawip);
 
+// Deadlines are milliseconds since epoch of system clock, compared across
+// nodes whose clocks are synchronized. Deadline 0 never passes
+int64 get_deadline_now();
+bool is_deadline_passed(int64 deadline);
+
+// Seeded 64-bit hash (wyhash). Result depends on the bytes and seed only,
+// not on compiler, library or byte order, so it may be stored or sent
+uint64 get_hash64(const void* data, size_t sz, uint64 seed = PLUTO_HASH_SEED);
+
+inline uint64 get_key_hash(const std::string& key) {
+    return get_hash64(key.data(), key.size());
+}
+
 #endif // _UTIL_H_
 
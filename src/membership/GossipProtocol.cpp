@@ -68,6 +68,7 @@ GossipProtocol::GossipProtocol(MemberList *mlist, ConfigPortal * cfg,
     string self_ip(m_pconfig->get_bindip());
 
     m_self_port = m_pconfig->get_bindport();
+    m_self_zone = m_pconfig->get_zone();
     m_self_addr = ip::address::from_string(self_ip);
 
     memset(m_self_rawip, '\0', PL_IPv6_ADDR_LEN);
@@ -159,7 +160,7 @@ int GossipProtocol::node_up()
     else {
         getlog()->sendlog(LogLevel::DEBUG, "I'm joiner\n");
         m_pmember->add_node(m_self_af, m_self_rawip, m_self_port,
-                            m_self_hb);
+                            m_self_hb, m_self_zone);
         send_heartbeat();
     }
 
@@ -260,7 +261,9 @@ void GossipProtocol::handle_joinrequest(Message * msg)
             af = AF_INET6;
             memcpy(rawip, source.first.to_v4().to_bytes().data(), PL_IPv4_ADDR_LEN);
         }
-        m_pmember->add_node(af, rawip, source.second, HEARTBEAT_INITIAL_VALUE);
+        JoinRequestMessage * preq = dynamic_cast<JoinRequestMessage*>(msg);
+        uint16 zone = (preq != nullptr) ? preq->get_zone() : 0;
+        m_pmember->add_node(af, rawip, source.second, HEARTBEAT_INITIAL_VALUE, zone);
         send_joinresponse(source.first, source.second);
     }
 }
@@ -307,6 +310,7 @@ void GossipProtocol::handle_joinresponse(Message * msg)
         m.tm_lasthb = time(NULL);
         m.portnumber= m_self_port;
         m.type      = SOCK_STREAM;
+        m.zone      = m_self_zone;
         memcpy(m.address, m_self_rawip, PL_IPv6_ADDR_LEN);
 
         // Debug
@@ -431,7 +435,7 @@ void GossipProtocol::send_joinrequest()
                                        dest.second);
     Message * pmsg = nullptr;
 
-    pmsg = new JoinRequestMessage(m_self_af, m_self_port, m_self_rawip);
+    pmsg = new JoinRequestMessage(m_self_af, m_self_port, m_self_rawip, m_self_zone);
 
     pmsg->build_msg();
 
@@ -452,7 +456,7 @@ void GossipProtocol::send_joinresponse(const ip::address& ip,
 
     for (auto&& node : *m_pmember) {
         Address addr(node.af, node.type, node.address, node.portnumber);
-        HeartMsgStruct hmsg(node.heartbeat, addr);
+        HeartMsgStruct hmsg(node.heartbeat, addr, node.zone);
 
         pmsg->add_member(hmsg);
     }
@@ -491,7 +495,7 @@ Message * GossipProtocol::construct_heartbeat_msg()
 
     for (auto&& node : *m_pmember) {
         Address addr(node.af, node.type, node.address, node.portnumber);
-        HeartMsgStruct hmsg(node.heartbeat, addr);
+        HeartMsgStruct hmsg(node.heartbeat, addr, node.zone);
 
         pmsg->add_member(hmsg);
     }
@@ -590,6 +594,7 @@ int GossipProtocol::construct_member_from_htmsg(struct MemberEntry& m, const Hea
     m.tm_lasthb = time(NULL);
     m.portnumber= addr.get_port();
     m.type      = SOCK_STREAM;
+    m.zone      = hm.get_zone();
 
     int af;
     const unsigned char* paddr = addr.get_ip_addr(&af);
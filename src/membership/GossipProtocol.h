@@ -100,6 +100,7 @@ private:
     int            m_self_af;
     unsigned char  m_self_rawip[PL_IPv6_ADDR_LEN];
     unsigned short m_self_port;
+    uint16         m_self_zone;
 
     int64          m_self_hb;
 
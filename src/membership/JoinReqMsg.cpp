@@ -32,16 +32,18 @@
 JoinRequestMessage::JoinRequestMessage(unsigned char* msg, size_t sz, 
                                        bool managebuf) : 
    Message(msg, sz, managebuf),
-   m_addr(msgbodyptr(), msgbodysize())
+   m_addr(msgbodyptr(), msgbodysize()),
+   m_zone(0)
 {
    //parse_msg();
 }
 
 JoinRequestMessage::JoinRequestMessage(int af, unsigned short port, 
-                                       unsigned char* ip) :
+                                       unsigned char* ip, uint16 zone) :
    Message(MsgType::JOINREQ),
    m_addr(af, SOCK_STREAM, ip, port,
-          af == AF_INET ? PL_IPv4_ADDR_LEN : PL_IPv6_ADDR_LEN)
+          af == AF_INET ? PL_IPv4_ADDR_LEN : PL_IPv6_ADDR_LEN),
+   m_zone(zone)
 {
 }
 
@@ -51,7 +53,8 @@ JoinRequestMessage::~JoinRequestMessage()
 
 JoinRequestMessage::JoinRequestMessage(JoinRequestMessage&& other) :
    Message(std::move(other)),
-   m_addr(std::move(other.m_addr))
+   m_addr(std::move(other.m_addr)),
+   m_zone(other.m_zone)
 {
 }
 
@@ -61,18 +64,27 @@ JoinRequestMessage& JoinRequestMessage::operator=(JoinRequestMessage&& other)
     Message::operator=(std::move(other));
     if (this != &other) {
         m_addr = std::move(other.m_addr);
+        m_zone = other.m_zone;
     }
     return *this;
 }
 
 size_t JoinRequestMessage::get_bodysize() const
 {
-    return m_addr.get_required_buf_len();
+    return m_addr.get_required_buf_len() + sizeof(int32);
 }
 
 int JoinRequestMessage::build_msg_body(unsigned char* buf, size_t size)
 {
+    /* Format
+     * Address - refer pladdress.h
+     * int32   - zone
+     */
     m_addr.build(buf, size);
+    buf += m_addr.get_required_buf_len();
+
+    int32 ival = htonl(m_zone);
+    memcpy(buf, &ival, sizeof(int32));
     return 0;
 }
 
@@ -80,12 +92,21 @@ void JoinRequestMessage::parse_msg_body(unsigned char* buf, size_t size)
                        throw(parse_error)
 {
     m_addr.parse(buf, size);
+    size_t len = m_addr.get_required_buf_len();
+    if (size < len + sizeof(int32)) {
+        throw parse_error("JoinRequestMessage: no zone");
+    }
+
+    int32 ival;
+    memcpy(&ival, buf + len, sizeof(int32));
+    m_zone = ntohl(ival);
 }
 
 void JoinRequestMessage:: dump_body(int (*output)(const char*, ...),
                                     bool verbose) const
 {
     m_addr.dump(output);
+    output("Zone: %d\n", m_zone);
 }
 
 void JoinRequestMessage::set_ip_addr(int af, unsigned char* ip)
@@ -109,6 +130,16 @@ unsigned short JoinRequestMessage::get_portnumber() const
     return m_addr.get_port();
 }
 
+void JoinRequestMessage::set_zone(uint16 zone)
+{
+    m_zone = zone;
+}
+
+uint16 JoinRequestMessage::get_zone() const
+{
+    return m_zone;
+}
+
 /*
  *******************************************************************************
  *  Inline functions                                                           *
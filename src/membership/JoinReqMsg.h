@@ -33,7 +33,8 @@
 class JoinRequestMessage : public Message{
 public:
     JoinRequestMessage(unsigned char* msg, size_t sz, bool managebuf = true);
-    JoinRequestMessage(int af, unsigned short port, unsigned char* ip);
+    JoinRequestMessage(int af, unsigned short port, unsigned char* ip,
+                       uint16 zone = 0);
     ~JoinRequestMessage();
 
     JoinRequestMessage(const JoinRequestMessage& other) = delete;
@@ -58,8 +59,13 @@ public:
 
     const unsigned char* get_ip_addr(int * af) const;
     unsigned short get_portnumber() const; 
+
+    // Zone of the joining node, 0 unknown
+    void set_zone(uint16 zone);
+    uint16 get_zone() const;
 private:
     Address m_addr;
+    uint16  m_zone;
 };
 
 /*
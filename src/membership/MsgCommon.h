@@ -39,8 +39,9 @@ public:
         parse(buf, size);
     };
   
-    HeartMsgStruct(int64 hb, Address& addr) : m_addr(addr) {
+    HeartMsgStruct(int64 hb, Address& addr, uint16 zone = 0) : m_addr(addr) {
         set_heartbeat(hb);
+        set_zone(zone);
     }
 
     /*HeartMsgStruct(const HeartMsgStruct& other):
@@ -74,6 +75,7 @@ public:
         /* Format 
          * Address - refer pladdress.h
          * int64   - heartbeat
+         * int32   - zone
          */
         if (buf==nullptr) {
             throw parse_error("null buffer");
@@ -97,6 +99,9 @@ public:
         lval2 = ntohl(lval2);
         llval = llval << 32 | lval2;
         m_heartbeat = llval;
+
+        memcpy(&lval1, buf, sizeof(int32));
+        m_zone = ntohl(lval1);
     }
 
     // serialize 
@@ -130,10 +135,14 @@ public:
         buf += sizeof(int32);
         memcpy(buf, &lval2, sizeof(int32));
         buf += sizeof(int32);
+
+        lval1 = htonl(m_zone);
+        memcpy(buf, &lval1, sizeof(int32));
+        buf += sizeof(int32);
     }
 
     size_t get_required_buf_len() const  {
-        return m_addr.get_required_buf_len() + sizeof(int64);
+        return m_addr.get_required_buf_len() + sizeof(int64) + sizeof(int32);
     }
 
     void set_address(const Address& addr) {
@@ -152,13 +161,23 @@ public:
         return m_heartbeat;
     }
 
+    void set_zone(uint16 zone) {
+        m_zone = zone;
+    }
+
+    uint16 get_zone() const {
+        return m_zone;
+    }
+
     void dump(int (*output)(const char*,...)=printf) const {
         m_addr.dump(output);
         output("Heartbeat: %ld\n", m_heartbeat);
+        output("Zone: %d\n", m_zone);
     }
 private:
     Address   m_addr;
     int64     m_heartbeat;
+    uint16    m_zone;
 };
 
 /**
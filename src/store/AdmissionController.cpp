@@ -0,0 +1,160 @@
+/**
+ *******************************************************************************
+ * AdmissionController.cpp                                                     *
+ *                                                                             *
+ * Admission controller:                                                       *
+ *   - Tracks queued store work, pending transactions and memory               *
+ *   - Rejects new client requests with BUSY once a threshold is crossed       *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "AdmissionController.h"
+#include "CreatMessage.h"
+#include "ReadMessage.h"
+#include "UpdateMessage.h"
+#include "DeleteMessage.h"
+#include "StoreStats.h"
+#include "config.h"
+
+#include <cstdio>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+AdmissionController* AdmissionController::s_inst = new AdmissionController();
+
+AdmissionController* AdmissionController::get_admission()
+{
+    return s_inst;
+}
+
+AdmissionController::AdmissionController() :
+   m_store_queue(0),
+   m_pending(0),
+   m_memory(0),
+   m_max_store_queue(KV_ADMIT_DEF_STORE_QUEUE),
+   m_max_pending(KV_ADMIT_DEF_PENDING),
+   m_max_memory(KV_ADMIT_DEF_MEMORY * 1024LL * 1024LL),
+   m_shedding(false)
+{
+}
+
+AdmissionController::~AdmissionController()
+{
+}
+
+void AdmissionController::configure(ConfigPortal * pcfg)
+{
+    m_max_store_queue = pcfg->get_admit_store_queue();
+    m_max_pending     = pcfg->get_admit_pending();
+    m_max_memory      = pcfg->get_admit_memory() * 1024LL * 1024LL;
+}
+
+void AdmissionController::sample_memory()
+{
+    if (m_max_memory <= 0) {
+        return;
+    }
+
+    // Second field is resident pages
+    FILE * fp = fopen("/proc/self/statm", "r");
+    if (fp == nullptr) {
+        return;
+    }
+    long long size = 0, resident = 0;
+    if (fscanf(fp, "%lld %lld", &size, &resident) == 2) {
+        m_memory = resident * sysconf(_SC_PAGESIZE);
+    }
+    fclose(fp);
+}
+
+bool AdmissionController::is_overloaded() const
+{
+    if ((m_max_store_queue > 0) && (m_store_queue.load(memory_order_relaxed) >= m_max_store_queue)) {
+        return true;
+    }
+    if ((m_max_pending > 0) && (m_pending.load(memory_order_relaxed) >= m_max_pending)) {
+        return true;
+    }
+    if ((m_max_memory > 0) && (m_memory.load(memory_order_relaxed) >= m_max_memory)) {
+        return true;
+    }
+    return false;
+}
+
+bool AdmissionController::admit(const StoreMessage * pmsg)
+{
+    if (!pmsg->is_client_request()) {
+        return true;
+    }
+
+    bool overloaded = is_overloaded();
+    if (overloaded != m_shedding.exchange(overloaded)) {
+        if (overloaded) {
+            getlog()->sendlog(LogLevel::WARNING, "Overloaded, shedding client requests: store queue=%lld, pending=%lld, memory=%lld\n",
+                             m_store_queue.load(), m_pending.load(), m_memory.load());
+        }
+        else {
+            getlog()->sendlog(LogLevel::INFO, "Load is back, admitting client requests\n");
+        }
+    }
+    if (overloaded) {
+        GetStoreStats()->incr(StatCounter::BUSY);
+    }
+    return !overloaded;
+}
+
+StoreMessage * AdmissionController::construct_busy_resp(const StoreMessage * preq)
+{
+    StoreMessage * presp = nullptr;
+    switch(preq->get_msgtype()) {
+    case MsgType::CREATREQ:
+        presp = new CreatResponseMessage(MessageOriginator::Client, preq->get_txid(), MsgStatus::BUSY);
+        break;
+    case MsgType::READREQ:
+        presp = new ReadResponseMessage(MessageOriginator::Client, preq->get_txid(), MsgStatus::BUSY);
+        break;
+    case MsgType::UPDATEREQ:
+        presp = new UpdateResponseMessage(MessageOriginator::Client, preq->get_txid(), MsgStatus::BUSY);
+        break;
+    case MsgType::DELETEREQ:
+        presp = new DeleteResponseMessage(MessageOriginator::Client, preq->get_txid(), MsgStatus::BUSY);
+        break;
+    default:
+        return nullptr;
+    }
+
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Build busy response failed\n");
+        delete presp;
+        return nullptr;
+    }
+    return presp;
+}
+
+AdmissionController* GetAdmission()
+{
+    return AdmissionController::get_admission();
+}
+
+/* eof */
@@ -0,0 +1,98 @@
+/**
+ *******************************************************************************
+ * AdmissionController.h                                                       *
+ *                                                                             *
+ * Admission controller:                                                       *
+ *   - Tracks queued store work, pending transactions and memory               *
+ *   - Rejects new client requests with BUSY once a threshold is crossed       *
+ *******************************************************************************
+ */
+
+#ifndef _ADMISSION_CONTROLLER_H_
+#define _ADMISSION_CONTROLLER_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <atomic>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+class StoreMessage;
+class ConfigPortal;
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * Only new client CRUD requests are rejected, requests of other nodes and
+ * the work of requests admitted already are always served, so that load
+ * drains instead of piling up. Gauges can be updated from any thread.
+ */
+class AdmissionController {
+private:
+    AdmissionController();
+public:
+    ~AdmissionController();
+
+    // Thresholds are cached, must be called before server runs
+    void configure(ConfigPortal * pcfg);
+
+    // Operations posted to the store strand and not run yet
+    void add_store_queue(int64 n) {
+        m_store_queue.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Client transactions pending on replicas
+    void add_pending(int64 n) {
+        m_pending.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Sample resident memory of the process, called periodically
+    void sample_memory();
+
+    // Returns false if the request must be rejected
+    bool admit(const StoreMessage * pmsg);
+
+    // Response of 'preq' with BUSY status, built and ready to send. Returns
+    // nullptr if 'preq' has no response type
+    static StoreMessage * construct_busy_resp(const StoreMessage * preq);
+
+    static AdmissionController* get_admission();
+private:
+    bool is_overloaded() const;
+private:
+    static AdmissionController* s_inst;
+
+    std::atomic<int64> m_store_queue;
+    std::atomic<int64> m_pending;
+    std::atomic<int64> m_memory;      // bytes
+
+    // 0 disables the threshold
+    int64              m_max_store_queue;
+    int64              m_max_pending;
+    int64              m_max_memory;  // bytes
+
+    std::atomic<bool>  m_shedding;
+};
+
+AdmissionController* GetAdmission();
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _ADMISSION_CONTROLLER_H_
+
@@ -0,0 +1,193 @@
+/**
+ *******************************************************************************
+ * BatchMessage.h                                                              *
+ *                                                                             *
+ * Server batch request/response message                                       *
+ *******************************************************************************
+ */
+
+#ifndef _BATCH_MSG_COMMON_H_
+#define _BATCH_MSG_COMMON_H_
+
+/**
+ *******************************************************************************
+ * Headers                                                                     *
+ *******************************************************************************
+ */
+#include <string>
+#include <vector>
+
+#include "stdinclude.h"
+#include "StoreMessage.h"
+#include "plexcept.h"
+
+/**
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/**
+ *******************************************************************************
+ * Class declaraction                                                          *
+ *******************************************************************************
+ */
+
+/**
+ * Carries built messages to one peer in a single frame. Each message keeps
+ * its own header, transaction id and deadline; the batch itself is only the
+ * envelope, its transaction id is not used.
+ */
+class BatchMessage : public StoreMessage {
+public:
+    BatchMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       StoreMessage(buf, sz, managebuf),
+       m_payload(),
+       m_offsets() {
+    }
+
+    BatchMessage(MsgType type,
+                 MessageOriginator originator,
+                 int64 txid) :
+       StoreMessage(type, originator, txid),
+       m_payload(),
+       m_offsets() {
+    }
+
+    virtual ~BatchMessage() {
+    }
+
+    // 'pmsg' must be built, its raw message is copied
+    int add_message(const StoreMessage * pmsg) {
+        if ((pmsg == nullptr) || (pmsg->get_raw() == nullptr)) {
+            return -1;
+        }
+        m_offsets.push_back(m_payload.size());
+        m_payload.insert(m_payload.end(), pmsg->get_raw(), pmsg->get_raw() + pmsg->get_size());
+        return 0;
+    }
+
+    size_t get_count() const {
+        return m_offsets.size();
+    }
+
+    // Raw message 'i', to be extracted by message factory
+    unsigned char* get_message(size_t i, size_t& sz) {
+        size_t end = (i + 1 < m_offsets.size()) ? m_offsets[i + 1] : m_payload.size();
+        sz = end - m_offsets[i];
+        return m_payload.data() + m_offsets[i];
+    }
+
+    int build_storemsg_body(unsigned char* buf, size_t sz) {
+        /**
+         * Format:
+         *  int32 -- message count
+         *  raw messages, each starts with common header
+         */
+        if (buf == nullptr) {
+            getlog()->sendlog(LogLevel::ERROR, "Batch message, build body nullptr received\n");
+            return -1;
+        }
+
+        if (sz < get_storemsg_bodysize()) {
+            getlog()->sendlog(LogLevel::ERROR, "Batch message, build body no enough buffer, size=%d, required %d\n",
+                                                sz, get_storemsg_bodysize());
+            return -1;
+        }
+        int32 ival = htonl(static_cast<int32>(m_offsets.size()));
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        if (!m_payload.empty()) {
+            memcpy(buf, m_payload.data(), m_payload.size());
+        }
+        return 0;
+    }
+
+    void parse_storemsg_body(const unsigned char* buf, const size_t sz)
+       throw (parse_error) {
+        if (buf == nullptr) {
+            throw parse_error("BatchMessage: parse got null ptr!");
+        }
+
+        if (sz < sizeof(int32)) {
+            throw parse_error("BatchMessage: invalid length expected: " + std::to_string(sizeof(int32)));
+        }
+
+        int32 cnt;
+        memcpy(&cnt, buf, sizeof(int32));
+        cnt = ntohl(cnt);
+        buf += sizeof(int32);
+
+        size_t left = sz - sizeof(int32);
+        m_payload.assign(buf, buf + left);
+        m_offsets.clear();
+
+        size_t pos = 0;
+        for (int32 i=0; i<cnt; i++) {
+            MsgCommonHdr hdr;
+            if (left - pos < sizeof(MsgCommonHdr)) {
+                throw parse_error("BatchMessage: in-complete message " + std::to_string(i));
+            }
+            memcpy(&hdr, m_payload.data() + pos, sizeof(MsgCommonHdr));
+            if ((hdr.size < sizeof(MsgCommonHdr)) || (hdr.size > left - pos)) {
+                throw parse_error("BatchMessage: invalid message size " + std::to_string(hdr.size));
+            }
+            m_offsets.push_back(pos);
+            pos += hdr.size;
+        }
+        if (pos != left) {
+            throw parse_error("BatchMessage: trailing bytes " + std::to_string(left - pos));
+        }
+    }
+
+    size_t get_storemsg_bodysize() const {
+        return sizeof(int32) + m_payload.size();
+    }
+
+    void dump_storemsg_body(int (*output)(const char*, ...)=printf,
+                            bool verbose=false) const {
+        output("Messages: '%d'\n", m_offsets.size());
+    }
+private:
+    std::vector<unsigned char> m_payload;
+    std::vector<size_t >       m_offsets;
+};
+
+class BatchRequestMessage : public BatchMessage {
+public:
+    BatchRequestMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       BatchMessage(buf, sz, managebuf) {
+    }
+
+    BatchRequestMessage(MessageOriginator originator,
+                        int64 txid) :
+       BatchMessage(MsgType::BATCHREQ, originator, txid) {
+    }
+
+    ~BatchRequestMessage() {
+    }
+};
+
+class BatchResponseMessage : public BatchMessage {
+public:
+    BatchResponseMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       BatchMessage(buf, sz, managebuf) {
+    }
+
+    BatchResponseMessage(MessageOriginator originator,
+                         int64 txid) :
+       BatchMessage(MsgType::BATCHRESP, originator, txid) {
+    }
+
+    ~BatchResponseMessage() {
+    }
+};
+
+/**
+ *******************************************************************************
+ * Function declaractions                                                      *
+ *******************************************************************************
+ */
+
+#endif // _BATCH_MSG_COMMON_H_
@@ -0,0 +1,110 @@
+/**
+ *******************************************************************************
+ * ChangeFeed.cpp                                                              *
+ *                                                                             *
+ * Change feed:                                                                *
+ *   - Bounded in-memory ring of mutations applied to the key value store      *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "ChangeFeed.h"
+
+using namespace std;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+ChangeFeed::ChangeFeed(size_t capacity) :
+   m_ring(),
+   m_capacity(capacity),
+   m_count(0),
+   m_next_seq(1)
+{
+    if (m_capacity == 0) {
+        m_capacity = 1;
+    }
+    m_ring.resize(m_capacity);
+}
+
+ChangeFeed::~ChangeFeed()
+{
+}
+
+uint64 ChangeFeed::append(ChangeOperation op, int replica_type,
+                          const string& key,
+                          const vector<unsigned char>& v,
+                          bool moved)
+{
+    uint64 seq = m_next_seq++;
+
+    if (m_count < m_capacity) {
+        m_count++;
+    }
+
+    ChangeRecord & rec = m_ring[seq % m_capacity];
+    rec.seq          = seq;
+    rec.op           = op;
+    rec.replica_type = replica_type;
+    rec.key          = key;
+    rec.moved        = moved;
+    if (op == ChangeOperation::DELETE) {
+        rec.value.clear();
+    }
+    else {
+        rec.value = v;
+    }
+
+    return seq;
+}
+
+uint64 ChangeFeed::get_first_seq() const
+{
+    return m_next_seq - m_count;
+}
+
+int ChangeFeed::read(uint64 from_seq, size_t max,
+                     vector<ChangeRecord>& v,
+                     uint64& next_seq) const
+{
+    uint64 first = get_first_seq();
+
+    v.clear();
+    if (from_seq == 0) {
+        from_seq = first;
+    }
+
+    if (from_seq < first) {
+        getlog()->sendlog(LogLevel::INFO, "Change feed: sequence '%llu' overwritten, oldest '%llu'\n",
+                                           from_seq, first);
+        next_seq = first;
+        return -1;
+    }
+
+    uint64 seq = from_seq;
+    for (; (seq < m_next_seq) && (v.size() < max); seq++) {
+        v.push_back(m_ring[seq % m_capacity]);
+    }
+    next_seq = seq;
+
+    return 0;
+}
+
+/* eof */
+
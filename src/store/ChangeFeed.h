@@ -0,0 +1,106 @@
+/**
+ *******************************************************************************
+ * ChangeFeed.h                                                                *
+ *                                                                             *
+ * Change feed:                                                                *
+ *   - Bounded in-memory ring of mutations applied to the key value store      *
+ *******************************************************************************
+ */
+
+#ifndef _CHANGE_FEED_H_
+#define _CHANGE_FEED_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+enum class ChangeOperation : int {
+    PLUTO_FIRST = 0,
+    CREAT = PLUTO_FIRST,
+    UPDATE,
+    DELETE,
+    PLUTO_LAST
+};
+
+inline std::string get_change_op_desc(ChangeOperation op) {
+    switch(op) {
+    case ChangeOperation::CREAT:  return "CREAT";
+    case ChangeOperation::UPDATE: return "UPDATE";
+    case ChangeOperation::DELETE: return "DELETE";
+    default: return "Unknown: " + std::to_string(static_cast<int>(op));
+    }
+    return "Bad";
+}
+
+struct ChangeRecord {
+    uint64                     seq;
+    ChangeOperation            op;
+    int32                      replica_type;
+    std::string                key;
+    std::vector<unsigned char> value;   // empty for DELETE
+    bool                       moved;   // replica type changed by rebalance
+};
+
+/**
+ * Sequence numbers start from 1 and increase by one for every mutation, the
+ * ring keeps the latest 'capacity' records.
+ * NO lock for the feed, it is guarded by the store lock of
+ * KVStoreAsyncAccessor!!!
+ */
+class ChangeFeed {
+public:
+    explicit ChangeFeed(size_t capacity = KV_CHANGE_FEED_DEF_SIZE);
+    ~ChangeFeed();
+
+    uint64 append(ChangeOperation op, int replica_type,
+                  const std::string& key,
+                  const std::vector<unsigned char>& v,
+                  bool moved = false);
+
+    // Copy at most 'max' records starting from 'from_seq' (0 means the oldest
+    // record retained). 'next_seq' is the sequence to resume from.
+    // Returns -1 if 'from_seq' has been overwritten, in which case 'next_seq'
+    // is the oldest sequence retained and the consumer has to resync.
+    int read(uint64 from_seq, size_t max,
+             std::vector<ChangeRecord>& v,
+             uint64& next_seq) const;
+
+    // Sequence of the oldest record retained
+    uint64 get_first_seq() const;
+    // Sequence that will be assigned to next mutation
+    uint64 get_next_seq() const {
+        return m_next_seq;
+    }
+private:
+    std::vector<ChangeRecord > m_ring;
+    size_t                     m_capacity;
+    size_t                     m_count;
+    uint64                     m_next_seq;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _CHANGE_FEED_H_
+
@@ -19,12 +19,21 @@
 #include "ReadMessage.h"
 #include "UpdateMessage.h"
 #include "DeleteMessage.h"
+#include "FeedMessage.h"
+#include "WatchMessage.h"
+#include "RepairMessage.h"
 
-#include "StoreClient.h"
+#include "PeerChannel.h"
 #include "ClientMessageHandler.h"
 #include "ConnectionManager.h"
+#include "StoreStats.h"
+#include "HintStore.h"
+#include "AdmissionController.h"
+#include "FairScheduler.h"
 
 #include <chrono>
+#include <algorithm>
+#include <thread>
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
 
@@ -45,47 +54,84 @@ using namespace boost::asio;
 ClientMessageHandler::ClientMessageHandler(io_service & io,
                                            ConnectionManager& mgr,
                                            StoreManager& store,
-                                           ConfigPortal * pcfg):
+                                           ConfigPortal * pcfg,
+                                           FairScheduler * psched):
    StoreMessageHandler(io, mgr, store, pcfg),
-   m_strand(io),
-   m_pending_tran()
+   m_psched(psched),
+   m_shards(),
+   m_last_version(0),
+   m_repair_mtx(),
+   m_repair_limits(),
+   m_flight_mtx(),
+   m_flights(),
+   m_hotkeys(pcfg),
+   m_hints(io, mgr, pcfg),
+   m_feed_strand(io),
+   m_feed_subs(),
+   m_feed_sub_cnt(0),
+   m_feed_last_seq(0),
+   m_watch(io, pcfg)
 {
+    int shards = m_pconfig->get_tran_shards();
+    if (shards <= 0) {
+        shards = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    for (int i=0; i<shards; i++) {
+        m_shards.push_back(std::unique_ptr<TranShard >(new TranShard(io)));
+    }
+
+    m_store.add_change_listener([this](const ChangeRecord& rec) {
+                                    handle_store_change(rec.seq);
+                                    m_watch.handle_change(rec);
+                                });
+    m_store.add_member_listener([this](const std::vector<MemberEntry >& members) {
+                                    m_hints.handle_members(members);
+                                    // Primary of a key may have moved, or
+                                    // the node restarted losing the watches
+                                    m_watch.async_get_watches(
+                                        [this](const std::vector<std::pair<std::string, bool> >& v) {
+                                            for (auto&& w : v) {
+                                                forward_watch(w.first, w.second, true);
+                                            }
+                                        });
+                                });
+    m_watch.set_unwatch_handler([this](const std::string& key, bool prefix) {
+                                    forward_watch(key, prefix, false);
+                                });
+    m_conn_mgr.set_push_handler([this](StoreMessage* pmsg) {
+                                    handle_watch_notify(pmsg);
+                                });
 }
 
 ClientMessageHandler::~ClientMessageHandler()
 {
-    for (auto && t: m_pending_tran) {
-        if (t.second!=nullptr) {
-            delete t.second;
+    for (auto && s: m_shards) {
+        for (auto && t: s->pending) {
+            if (t.second!=nullptr) {
+                delete t.second;
+            }
         }
+        s->pending.clear();
     }
-    m_pending_tran.clear();
 }
 
-void ClientMessageHandler::handle_time_event()
+ClientMessageHandler::TranShard::TranShard(io_service& io) :
+   strand(io),
+   pending(),
+   pool(),
+   timeouts(get_wheel_tick(std::chrono::steady_clock::now())),
+   wheel_timer(io),
+   wheel_running(false),
+   hedge_timers(),
+   read_latency()
 {
-    m_strand.post([this]() {
-        using namespace std::chrono;
+}
 
-        system_clock::time_point now = system_clock::now();
-        duration<int, std::milli> expires(m_pconfig->get_message_timeout());
-        for (auto it = m_pending_tran.begin(); it != m_pending_tran.end(); ) {
-            if (it->second->get_creat_time() + expires < now) {
-                // Expires 
-                if (!it->second->is_client_response()) {
-                    StoreMessage * resp = construct_client_resp_msg(it->second, MsgStatus::ERROR);
-                    if (resp != nullptr) {
-                        send_message(resp);
-                    }
-                }
-                delete it->second;
-                it = m_pending_tran.erase(it);
-            }
-            else {
-                it++;
-            }
-        }
-    });
+ClientMessageHandler::TranShard& ClientMessageHandler::get_shard(unsigned long long txid)
+{
+    // txid is address of the request, low bits are alignment
+    uint64 h = (txid >> 4) * 0x9E3779B97F4A7C15ULL;
+    return *m_shards[(h >> 32) % m_shards.size()];
 }
 
 int ClientMessageHandler::handle_create_request(CreatRequestMessage* pmsg)
@@ -93,36 +139,47 @@ int ClientMessageHandler::handle_create_request(CreatRequestMessage* pmsg)
     // Find who is in charge of the key, and then send server request message to
     // these nodes.
     if (pmsg == nullptr) return -1;
-    async_find_nodes(pmsg->get_key(), [this, pmsg](const std::vector<MemberEntry > &v) {
+    async_find_nodes(pmsg->get_key_hash(), [this, pmsg](const std::vector<MemberEntry > &v) {
             std::vector<unsigned char> val;
-            std::map<ip::tcp::endpoint, StoreClient* > node_clt;
+            std::map<ip::tcp::endpoint, PeerChannel_ptr > node_chn;
             unsigned long long txid = reinterpret_cast<unsigned long long>(pmsg);
 
             pmsg->get_value(val);
+            m_hotkeys.invalidate(pmsg->get_key(), pmsg->get_key_hash());
+            if (local_write(pmsg, pmsg->get_key(), pmsg->get_key_hash(), val,
+                            get_required_replies(pmsg->get_consistency(), v.size()), v)) {
+                return;
+            }
+            uint64 version = get_next_version();
 
-            ClientTransaction * pclt_tran = new ClientTransaction(pmsg, 
+            int timeout = get_request_timeout(pmsg, pmsg->get_timeout());
+            ClientTransaction * pclt_tran = get_shard(txid).pool.acquire(pmsg, 
                                             ClientTransaction::REQUEST_TYPE::CREAT, 
-                                            v);
+                                            v,
+                                            get_required_replies(pmsg->get_consistency(), v.size()),
+                                            timeout);
+            pclt_tran->set_version(version);
             // TODO: handle errors
-            prepare_node_tran(v, pclt_tran, node_clt);
+            prepare_node_tran(v, pclt_tran, node_chn);
             add_pending_tran(pmsg, pclt_tran);
 
             int replica_type = -1;
             for (auto&& n : v) {
                 boost::asio::ip::tcp::endpoint ep = get_node_endpoint(n);
                 replica_type++;
-                if (node_clt.find(ep) == node_clt.end()) {
-                    getlog()->sendlog(LogLevel::ERROR, "Can't find client for node '%s:%d'\n",
+                if (node_chn.find(ep) == node_chn.end()) {
+                    getlog()->sendlog(LogLevel::ERROR, "Can't find channel for node '%s:%d'\n",
                                      ep.address().to_string().c_str(), ep.port());
                     continue;
                 }
-                StoreClient * pclt = node_clt[ep];
-                if (pclt == nullptr) {
+                PeerChannel_ptr pchn = node_chn[ep];
+                if (pchn.get() == nullptr) {
                     m_store.async_creat(pmsg->get_key(), replica_type, 
-                                        val.data(), val.size(), 
+                                        val.data(), val.size(), version,
                                         [this, txid](int rc) {
                                             handle_store_cud_complete(rc, txid);
-                                        });
+                                        },
+                                        get_deadline_now() + timeout);
                 }
                 else {
                     // Construct server request messages
@@ -131,13 +188,10 @@ int ClientMessageHandler::handle_create_request(CreatRequestMessage* pmsg)
                                                                          reinterpret_cast<int64>(pmsg));
                     preq->set_key(pmsg->get_key());
                     preq->set_value(val.data(), val.size());
+                    preq->set_version(version);
                     preq->set_replica_type(replica_type);
                     preq->set_dest_endpoint(ep);
-                    pclt->async_call(ep, preq, 
-                                     [this, txid](const ClientErrorCode& e,
-                                                  StoreMessage* presp) {
-                                         handle_clt_crud_complete(static_cast<int>(e), presp, txid);
-                                     });
+                    call_node(ep, pchn, preq, txid, timeout);
                 }
             }
         }); 
@@ -153,47 +207,54 @@ int ClientMessageHandler::handle_create_response(CreatResponseMessage* pmsg)
 int ClientMessageHandler::handle_read_request(ReadRequestMessage* pmsg)
 {
     if (pmsg == nullptr) return -1;
-    async_find_nodes(pmsg->get_key(), [this, pmsg](const std::vector<MemberEntry > &v) {
-            std::map<ip::tcp::endpoint, StoreClient* > node_clt;
+    async_find_nodes(pmsg->get_key_hash(), [this, pmsg](const std::vector<MemberEntry > &v) {
             unsigned long long txid = reinterpret_cast<unsigned long long>(pmsg);
 
-            ClientTransaction * pclt_tran = new ClientTransaction(pmsg, 
+            GetStoreStats()->incr(StatCounter::READ);
+            int required = get_required_replies(pmsg->get_consistency(), v.size());
+            m_hotkeys.record(pmsg->get_key_hash());
+            if (cached_read(pmsg, required)) {
+                return;
+            }
+            if (local_read(pmsg, v)) {
+                return;
+            }
+
+            int timeout  = get_request_timeout(pmsg, pmsg->get_timeout());
+            if (join_flight(pmsg, required)) {
+                // Answered by the read of the key in flight
+                return;
+            }
+            ClientTransaction * pclt_tran = get_shard(txid).pool.acquire(pmsg, 
                                             ClientTransaction::REQUEST_TYPE::READ, 
-                                            v);
-            // TODO: handle errors
-            prepare_node_tran(v, pclt_tran, node_clt);
+                                            v,
+                                            required,
+                                            timeout);
+
+            // Hedged reads ask the replicas required only, another replica
+            // is asked when a reply is late
+            std::vector<int> order = get_read_order(v.data(), v.size());
+            bool hedge = (m_pconfig->get_hedge_percentile() > 0) && (static_cast<size_t>(required) < v.size());
+            size_t initial = hedge ? required : v.size();
+
+            bool digest = m_pconfig->is_digest_read() && (v.size() > 1);
+            ip::tcp::endpoint data_ep;
+            if (digest) {
+                data_ep = get_node_endpoint(v[order[0]]);
+                pclt_tran->set_data_node(data_ep);
+            }
+            for (size_t i=0; i<initial; i++) {
+                pclt_tran->start_wait_reply(get_node_endpoint(v[order[i]]), order[i]);
+            }
             add_pending_tran(pmsg, pclt_tran);
 
-            int replica_type = -1;
-            for (auto&& n : v) {
-                boost::asio::ip::tcp::endpoint ep = get_node_endpoint(n);
-                replica_type++;
-                if (node_clt.find(ep) == node_clt.end()) {
-                    getlog()->sendlog(LogLevel::ERROR, "Can't find client for node '%s:%d'\n",
-                                     ep.address().to_string().c_str(), ep.port());
-                    continue;
-                }
-                StoreClient * pclt = node_clt[ep];
-                if (pclt == nullptr) {
-                    m_store.async_read(pmsg->get_key(), replica_type, 
-                              [this, txid](int rc, unsigned char* val, size_t sz) {
-                                  handle_store_r_complete(rc, txid, val, sz);
-                              });
-                }
-                else {
-                    // Construct server request messages
-                    // Send to node n
-                    ReadRequestMessage * preq = new ReadRequestMessage(MessageOriginator::Server,
-                                                                       reinterpret_cast<int64>(pmsg));
-                    preq->set_key(pmsg->get_key());
-                    preq->set_replica_type(replica_type);
-                    preq->set_dest_endpoint(ep);
-                    pclt->async_call(ep, preq, 
-                                     [this, txid](const ClientErrorCode& e,
-                                                  StoreMessage* presp) {
-                                         handle_clt_crud_complete(static_cast<int>(e), presp, txid);
-                                     });
-                }
+            for (size_t i=0; i<initial; i++) {
+                const MemberEntry & n = v[order[i]];
+                send_read(pmsg->get_key(), txid, n, order[i],
+                          digest && (get_node_endpoint(n) != data_ep), timeout);
+            }
+            if (hedge) {
+                start_hedge_timer(txid);
             }
         }); 
     return 0;
@@ -208,36 +269,48 @@ int ClientMessageHandler::handle_read_response(ReadResponseMessage* pmsg)
 int ClientMessageHandler::handle_update_request(UpdateRequestMessage* pmsg)
 {
     if (pmsg == nullptr) return -1;
-    async_find_nodes(pmsg->get_key(), [this, pmsg](const std::vector<MemberEntry > &v) {
+    async_find_nodes(pmsg->get_key_hash(), [this, pmsg](const std::vector<MemberEntry > &v) {
             std::vector<unsigned char> val;
-            std::map<ip::tcp::endpoint, StoreClient* > node_clt;
+            std::map<ip::tcp::endpoint, PeerChannel_ptr > node_chn;
             unsigned long long txid = reinterpret_cast<unsigned long long>(pmsg);
 
             pmsg->get_value(val);
+            m_hotkeys.invalidate(pmsg->get_key(), pmsg->get_key_hash());
+            if (local_write(pmsg, pmsg->get_key(), pmsg->get_key_hash(), val,
+                            get_required_replies(pmsg->get_consistency(), v.size()), v)) {
+                return;
+            }
+            uint64 version = get_next_version();
 
-            ClientTransaction * pclt_tran = new ClientTransaction(pmsg, 
+            int timeout = get_request_timeout(pmsg, pmsg->get_timeout());
+            ClientTransaction * pclt_tran = get_shard(txid).pool.acquire(pmsg, 
                                             ClientTransaction::REQUEST_TYPE::UPDATE, 
-                                            v);
+                                            v,
+                                            get_required_replies(pmsg->get_consistency(), v.size()),
+                                            timeout);
+            pclt_tran->set_version(version);
             // TODO: handle errors
-            prepare_node_tran(v, pclt_tran, node_clt);
+            prepare_node_tran(v, pclt_tran, node_chn);
             add_pending_tran(pmsg, pclt_tran);
 
             int replica_type = -1;
             for (auto&& n : v) {
                 boost::asio::ip::tcp::endpoint ep = get_node_endpoint(n);
                 replica_type++;
-                if (node_clt.find(ep) == node_clt.end()) {
-                    getlog()->sendlog(LogLevel::ERROR, "Can't find client for node '%s:%d'\n",
+                if (node_chn.find(ep) == node_chn.end()) {
+                    getlog()->sendlog(LogLevel::ERROR, "Can't find channel for node '%s:%d'\n",
                                      ep.address().to_string().c_str(), ep.port());
                     continue;
                 }
-                StoreClient * pclt = node_clt[ep];
-                if (pclt == nullptr) {
+                PeerChannel_ptr pchn = node_chn[ep];
+                if (pchn.get() == nullptr) {
                     m_store.async_update(pmsg->get_key(), replica_type, 
-                                        val.data(), val.size(), 
+                                        val.data(), val.size(), version,
                                         [this, txid](int rc) {
                                             handle_store_cud_complete(rc, txid);
-                                        });
+                                        },
+                                        get_deadline_now() + timeout,
+                                        pmsg->get_expected_version());
                 }
                 else {
                     // Construct server request messages
@@ -246,13 +319,11 @@ int ClientMessageHandler::handle_update_request(UpdateRequestMessage* pmsg)
                                                                          reinterpret_cast<int64>(pmsg));
                     preq->set_key(pmsg->get_key());
                     preq->set_value(val.data(), val.size());
+                    preq->set_version(version);
+                    preq->set_expected_version(pmsg->get_expected_version());
                     preq->set_replica_type(replica_type);
                     preq->set_dest_endpoint(ep);
-                    pclt->async_call(ep, preq, 
-                                     [this, txid](const ClientErrorCode& e,
-                                                  StoreMessage* presp) {
-                                         handle_clt_crud_complete(static_cast<int>(e), presp, txid);
-                                     });
+                    call_node(ep, pchn, preq, txid, timeout);
                 }
             }
         }); 
@@ -268,32 +339,45 @@ int ClientMessageHandler::handle_update_response(UpdateResponseMessage* pmsg)
 int ClientMessageHandler::handle_delete_request(DeleteRequestMessage* pmsg)
 {
     if (pmsg == nullptr) return -1;
-    async_find_nodes(pmsg->get_key(), [this, pmsg](const std::vector<MemberEntry > &v) {
-            std::map<ip::tcp::endpoint, StoreClient* > node_clt;
+    async_find_nodes(pmsg->get_key_hash(), [this, pmsg](const std::vector<MemberEntry > &v) {
+            std::map<ip::tcp::endpoint, PeerChannel_ptr > node_chn;
             unsigned long long txid = reinterpret_cast<unsigned long long>(pmsg);
 
-            ClientTransaction * pclt_tran = new ClientTransaction(pmsg, 
+            m_hotkeys.invalidate(pmsg->get_key(), pmsg->get_key_hash());
+            if (local_write(pmsg, pmsg->get_key(), pmsg->get_key_hash(), std::vector<unsigned char>(),
+                            get_required_replies(pmsg->get_consistency(), v.size()), v)) {
+                return;
+            }
+
+            int timeout = get_request_timeout(pmsg, pmsg->get_timeout());
+            ClientTransaction * pclt_tran = get_shard(txid).pool.acquire(pmsg, 
                                             ClientTransaction::REQUEST_TYPE::DELETE, 
-                                            v);
+                                            v,
+                                            get_required_replies(pmsg->get_consistency(), v.size()),
+                                            timeout);
+            // Orders a delete hint against later writes of the key
+            pclt_tran->set_version(get_next_version());
             // TODO: handle errors
-            prepare_node_tran(v, pclt_tran, node_clt);
+            prepare_node_tran(v, pclt_tran, node_chn);
             add_pending_tran(pmsg, pclt_tran);
 
             int replica_type = -1;
             for (auto&& n : v) {
                 boost::asio::ip::tcp::endpoint ep = get_node_endpoint(n);
                 replica_type++;
-                if (node_clt.find(ep) == node_clt.end()) {
-                    getlog()->sendlog(LogLevel::ERROR, "Can't find client for node '%s:%d'\n",
+                if (node_chn.find(ep) == node_chn.end()) {
+                    getlog()->sendlog(LogLevel::ERROR, "Can't find channel for node '%s:%d'\n",
                                      ep.address().to_string().c_str(), ep.port());
                     continue;
                 }
-                StoreClient * pclt = node_clt[ep];
-                if (pclt == nullptr) {
+                PeerChannel_ptr pchn = node_chn[ep];
+                if (pchn.get() == nullptr) {
                     m_store.async_delete(pmsg->get_key(), replica_type, 
                                         [this, txid](int rc) {
                                             handle_store_cud_complete(rc, txid);
-                                        });
+                                        },
+                                        get_deadline_now() + timeout,
+                                        pmsg->get_expected_version());
                 }
                 else {
                     // Construct server request messages
@@ -301,13 +385,10 @@ int ClientMessageHandler::handle_delete_request(DeleteRequestMessage* pmsg)
                     DeleteRequestMessage * preq = new DeleteRequestMessage(MessageOriginator::Server,
                                                                          reinterpret_cast<int64>(pmsg));
                     preq->set_key(pmsg->get_key());
+                    preq->set_expected_version(pmsg->get_expected_version());
                     preq->set_replica_type(replica_type);
                     preq->set_dest_endpoint(ep);
-                    pclt->async_call(ep, preq, 
-                                     [this, txid](const ClientErrorCode& e,
-                                                  StoreMessage* presp) {
-                                         handle_clt_crud_complete(static_cast<int>(e), presp, txid);
-                                     });
+                    call_node(ep, pchn, preq, txid, timeout);
                 }
             }
         }); 
@@ -320,6 +401,266 @@ int ClientMessageHandler::handle_delete_response(DeleteResponseMessage* pmsg)
     return 0;
 }
 
+int ClientMessageHandler::handle_feed_request(FeedRequestMessage* pmsg)
+{
+    if (pmsg == nullptr) return -1;
+
+    Connection_ptr pconn = pmsg->get_connection();
+    if (pconn.get() == nullptr) {
+        getlog()->sendlog(LogLevel::ERROR, "Feed request without connection\n");
+        delete pmsg;
+        return -1;
+    }
+
+    FeedSubscription sub;
+    sub.conn      = pconn;
+    sub.txid      = pmsg->get_txid();
+    sub.next_seq  = pmsg->get_start_seq();
+    sub.max_batch = pmsg->get_max_batch();
+    sub.busy      = false;
+    sub.acked     = false;
+    if ((sub.max_batch == 0) || (sub.max_batch > m_pconfig->get_change_feed_batch())) {
+        sub.max_batch = m_pconfig->get_change_feed_batch();
+    }
+    delete pmsg;
+
+    Connection * key = pconn.get();
+    m_feed_strand.post([this, key, sub]() {
+        if (m_feed_subs.find(key) == m_feed_subs.end()) {
+            m_feed_sub_cnt++;
+        }
+        m_feed_subs[key] = sub;
+        pump_feed(key);
+    });
+    return 0;
+}
+
+void ClientMessageHandler::handle_store_change(uint64 seq)
+{
+    // Called by store strand for every mutation, skip the post if nobody
+    // subscribes
+    if (m_feed_sub_cnt == 0) {
+        return;
+    }
+
+    m_feed_strand.post([this, seq]() {
+        if (seq > m_feed_last_seq) {
+            m_feed_last_seq = seq;
+        }
+        for (auto&& s : m_feed_subs) {
+            if (!s.second.busy && s.second.next_seq <= seq) {
+                pump_feed(s.first);
+            }
+        }
+    });
+}
+
+void ClientMessageHandler::pump_feed(Connection* key)
+{
+    auto it = m_feed_subs.find(key);
+    if ((it == m_feed_subs.end()) || it->second.busy) {
+        return;
+    }
+    it->second.busy = true;
+
+    m_store.async_read_changes(it->second.next_seq, it->second.max_batch,
+                               [this, key](int rc, std::vector<ChangeRecord>& v, 
+                                           uint64 next_seq) {
+        // Build response in store strand to avoid copying records again
+        FeedResponseMessage * presp = new FeedResponseMessage(MessageOriginator::Client,
+                                                              0, MsgStatus::OK);
+        presp->set_records(v);
+        m_feed_strand.post([this, key, presp, rc, next_seq]() {
+                               send_feed(key, presp, rc, next_seq);
+                           });
+    });
+}
+
+void ClientMessageHandler::send_feed(Connection* key, 
+                                     FeedResponseMessage* presp,
+                                     int rc, uint64 next_seq)
+{
+    auto it = m_feed_subs.find(key);
+    if (it == m_feed_subs.end()) {
+        delete presp;
+        return;
+    }
+
+    FeedSubscription & sub = it->second;
+    Connection_ptr pconn = sub.conn.lock();
+    if ((pconn.get() == nullptr) || !pconn->is_open()) {
+        // Subscriber gone
+        delete presp;
+        m_feed_subs.erase(it);
+        m_feed_sub_cnt--;
+        return;
+    }
+
+    sub.busy = false;
+    if (rc != 0) {
+        // Records overwritten, subscriber has to resync and subscribe again
+        presp->set_status(MsgStatus::ERROR);
+    }
+    else if (presp->get_records().empty() && sub.acked) {
+        delete presp;
+        return;
+    }
+
+    presp->set_txid(sub.txid);
+    presp->set_next_seq(next_seq);
+    presp->set_connection(pconn);
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Feed response build failed\n");
+        delete presp;
+        return;
+    }
+    pconn->do_write(presp);
+    sub.acked    = true;
+    sub.next_seq = next_seq;
+
+    if (rc != 0) {
+        m_feed_subs.erase(it);
+        m_feed_sub_cnt--;
+        return;
+    }
+
+    if (sub.next_seq <= m_feed_last_seq) {
+        // Changes arrived while reading
+        pump_feed(key);
+    }
+}
+
+int ClientMessageHandler::handle_watch_request(WatchRequestMessage* pmsg)
+{
+    if (pmsg == nullptr) return -1;
+
+    Connection_ptr pconn = pmsg->get_connection();
+    if (pconn.get() == nullptr) {
+        getlog()->sendlog(LogLevel::ERROR, "Watch request without connection\n");
+        delete pmsg;
+        return -1;
+    }
+
+    m_watch.add_watch(pconn, pmsg->get_txid(), pmsg->get_key(), pmsg->is_prefix());
+    forward_watch(pmsg->get_key(), pmsg->is_prefix(), true);
+
+    WatchResponseMessage * presp = new WatchResponseMessage(MessageOriginator::Client,
+                                                            pmsg->get_txid(),
+                                                            MsgStatus::OK);
+    delete pmsg;
+
+    presp->set_connection(pconn);
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Watch response build failed\n");
+        delete presp;
+        return -1;
+    }
+    pconn->do_write(presp);
+    return 0;
+}
+
+int ClientMessageHandler::handle_unwatch_request(UnwatchRequestMessage* pmsg)
+{
+    if (pmsg == nullptr) return -1;
+
+    Connection_ptr pconn = pmsg->get_connection();
+    if (pconn.get() == nullptr) {
+        getlog()->sendlog(LogLevel::ERROR, "Unwatch request without connection\n");
+        delete pmsg;
+        return -1;
+    }
+
+    m_watch.remove_watch(pconn.get(), pmsg->get_key(), pmsg->is_prefix());
+
+    UnwatchResponseMessage * presp = new UnwatchResponseMessage(MessageOriginator::Client,
+                                                                pmsg->get_txid(),
+                                                                MsgStatus::OK);
+    delete pmsg;
+
+    presp->set_connection(pconn);
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Unwatch response build failed\n");
+        delete presp;
+        return -1;
+    }
+    pconn->do_write(presp);
+    return 0;
+}
+
+void ClientMessageHandler::forward_watch(const std::string& key, bool prefix, bool watch)
+{
+    std::shared_ptr<const TokenRing > ring = m_store.get_ring_snapshot();
+    std::vector<MemberEntry > nodes;
+    if (watch && !prefix) {
+        std::vector<MemberEntry > v = ring->get_nodes(key);
+        if (!v.empty()) {
+            nodes.push_back(v[0]);
+        }
+    }
+    else {
+        nodes = ring->get_members();
+    }
+
+    for (auto&& n : nodes) {
+        if (is_self(n)) {
+            // Matched by local store changes
+            continue;
+        }
+        ip::tcp::endpoint ep = get_node_endpoint(n);
+        PeerChannel_ptr pchn = m_conn_mgr.get_channel(ep);
+
+        WatchReqMessage * preq = nullptr;
+        if (watch) {
+            preq = new WatchRequestMessage(MessageOriginator::Server, 0);
+        }
+        else {
+            preq = new UnwatchRequestMessage(MessageOriginator::Server, 0);
+        }
+        preq->set_key(key);
+        preq->set_prefix(prefix);
+        preq->set_dest_endpoint(ep);
+        pchn->async_call(preq, m_pconfig->get_message_timeout(),
+                         [ep, key](const ClientErrorCode& e, StoreMessage* presp) {
+                             if (presp == nullptr) {
+                                 // Tried again next membership period
+                                 getlog()->sendlog(LogLevel::WARNING, "Forward watch of '%s' to '%s:%d' failed, error=%d\n",
+                                                  key.c_str(), ep.address().to_string().c_str(), ep.port(),
+                                                  static_cast<int>(e));
+                                 return;
+                             }
+                             delete presp;
+                         });
+    }
+}
+
+void ClientMessageHandler::handle_watch_notify(StoreMessage* pmsg)
+{
+    WatchNotifyMessage * pnotify = dynamic_cast<WatchNotifyMessage*>(pmsg);
+    if (pnotify != nullptr) {
+        // Node of the primary replica has filtered the change already
+        ChangeRecord rec;
+        rec.seq          = pnotify->get_seq();
+        rec.op           = pnotify->get_operation();
+        rec.replica_type = 0;
+        rec.key          = pnotify->get_key();
+        rec.moved        = false;
+        pnotify->get_value(rec.value);
+        m_watch.handle_change(rec);
+    }
+    delete pmsg;
+}
+
+void ClientMessageHandler::handle_connection_close(Connection* pconn)
+{
+    m_watch.remove_watch(pconn);
+
+    m_feed_strand.post([this, pconn]() {
+        if (m_feed_subs.erase(pconn) != 0) {
+            m_feed_sub_cnt--;
+        }
+    });
+}
+
 ip::tcp::endpoint ClientMessageHandler::get_node_endpoint(const struct MemberEntry& e)
 {
      return ip::tcp::endpoint(rawip2address(e.af, e.address), e.portnumber);
@@ -333,82 +674,848 @@ ip::tcp::endpoint ClientMessageHandler::get_self_endpoint() const
 int ClientMessageHandler::prepare_node_tran(
                           const std::vector<struct MemberEntry > & nodes,
                           ClientTransaction * pclt_tran,
-                          std::map<ip::tcp::endpoint, StoreClient* > & node_clt)
+                          std::map<ip::tcp::endpoint, PeerChannel_ptr > & node_chn)
 {
     if (pclt_tran==nullptr) return -1;
-    node_clt.clear();
+    node_chn.clear();
+    int replica_type = 0;
     for (auto&& n : nodes) {
         boost::asio::ip::tcp::endpoint ep = get_node_endpoint(n);
-        StoreClient * pclt = nullptr;
+        PeerChannel_ptr pchn;
         if (!is_self(n)) {
-            pclt = new StoreClient(m_pconfig, m_io);
+            pchn = m_conn_mgr.get_channel(ep);
         }
-        pclt_tran->start_wait_reply(ep, pclt);
-        node_clt[ep] = pclt;
+        pclt_tran->start_wait_reply(ep, replica_type++);
+        node_chn[ep] = pchn;
     }
     return 0;
 }
 
+std::vector<int> ClientMessageHandler::get_read_order(const struct MemberEntry * nodes,
+                                                      size_t cnt)
+{
+    // Self first, then replicas of the same zone, cross zone reads cost
+    // more bandwidth and latency
+    std::vector<int> order;
+    size_t near = 0;
+    for (size_t i=0; i<cnt; i++) {
+        if (is_self(nodes[i])) {
+            order.insert(order.begin(), static_cast<int>(i));
+            near++;
+        }
+        else if ((m_self_zone != 0) && (nodes[i].zone == m_self_zone)) {
+            order.insert(order.begin() + near, static_cast<int>(i));
+            near++;
+        }
+        else {
+            order.push_back(static_cast<int>(i));
+        }
+    }
+    return order;
+}
+
+int ClientMessageHandler::get_local_replica(const std::vector<struct MemberEntry >& nodes,
+                                            int required)
+{
+    if (!m_pconfig->is_local_fast_path() || (required != 1)) {
+        return -1;
+    }
+    for (size_t i=0; i<nodes.size(); i++) {
+        if (is_self(nodes[i])) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool ClientMessageHandler::local_read(ReadRequestMessage* pmsg,
+                                      const std::vector<struct MemberEntry >& nodes)
+{
+    int replica_type = get_local_replica(nodes, 
+                       get_required_replies(pmsg->get_consistency(), nodes.size()));
+    if (replica_type < 0) {
+        return false;
+    }
+
+    std::vector<unsigned char> val;
+    uint64 version = 0;
+    if (m_store.sync_read(pmsg->get_key(), replica_type, val, version) != 0) {
+        // Missing locally, other replicas may have it
+        return false;
+    }
+
+    ReadResponseMessage * presp = new ReadResponseMessage(MessageOriginator::Client,
+                                                          reinterpret_cast<int64>(pmsg),
+                                                          MsgStatus::OK);
+    presp->set_value(val.data(), val.size());
+    presp->set_version(version);
+    presp->set_connection(pmsg->get_connection());
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Build local read response failed\n");
+        delete presp;
+        return false;
+    }
+    send_message(presp);
+
+    GetStoreStats()->incr(StatCounter::LOCAL);
+    finish_request(pmsg);
+    delete pmsg;
+    return true;
+}
+
+bool ClientMessageHandler::cached_read(ReadRequestMessage* pmsg, int required)
+{
+    std::vector<unsigned char> val;
+    uint64 version = 0;
+    if (!m_hotkeys.lookup(pmsg->get_key(), required, val, version)) {
+        return false;
+    }
+
+    ReadResponseMessage * presp = new ReadResponseMessage(MessageOriginator::Client,
+                                                          reinterpret_cast<int64>(pmsg),
+                                                          MsgStatus::OK);
+    presp->set_value(val.data(), val.size());
+    presp->set_version(version);
+    presp->set_connection(pmsg->get_connection());
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Build cached read response failed\n");
+        delete presp;
+        return false;
+    }
+    send_message(presp);
+
+    GetStoreStats()->incr(StatCounter::HOT_HIT);
+    finish_request(pmsg);
+    delete pmsg;
+    return true;
+}
+
+void ClientMessageHandler::update_hot_key(ClientTransaction * pclt_trn, MsgStatus status)
+{
+    if (!m_hotkeys.is_enabled()) {
+        return;
+    }
+
+    KeyReqMessage * pread = nullptr;
+    KVReqMessage * pwrite = nullptr;
+    switch(pclt_trn->get_type()) {
+    case ClientTransaction::REQUEST_TYPE::READ:
+        pread = dynamic_cast<KeyReqMessage*>(pclt_trn->get_msg());
+        if ((pread != nullptr) && (status == MsgStatus::OK)) {
+            ClientTransaction::ValueView v = { nullptr, 0 };
+            uint64 version = 0;
+            pclt_trn->get_read_value(v, version);
+            m_hotkeys.fill(pread->get_key(), pread->get_key_hash(), pclt_trn->get_required_count(),
+                            v.data, v.size, version, pclt_trn->get_creat_time());
+        }
+        break;
+    case ClientTransaction::REQUEST_TYPE::CREAT:
+    case ClientTransaction::REQUEST_TYPE::UPDATE:
+        // Write lands on replicas after the mark of its start, mark again
+        pwrite = dynamic_cast<KVReqMessage*>(pclt_trn->get_msg());
+        if (pwrite != nullptr) {
+            m_hotkeys.invalidate(pwrite->get_key(), pwrite->get_key_hash());
+        }
+        break;
+    case ClientTransaction::REQUEST_TYPE::DELETE:
+        pread = dynamic_cast<KeyReqMessage*>(pclt_trn->get_msg());
+        if (pread != nullptr) {
+            m_hotkeys.invalidate(pread->get_key(), pread->get_key_hash());
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+bool ClientMessageHandler::local_write(StoreMessage* pmsg, const std::string& key, uint64 key_hash,
+                                       const std::vector<unsigned char>& val, int required,
+                                       const std::vector<struct MemberEntry >& nodes)
+{
+    int self_type = get_local_replica(nodes, required);
+    if (self_type < 0) {
+        return false;
+    }
+
+    MsgType op = pmsg->get_msgtype();
+    uint64 version = get_next_version();
+    uint64 expected = 0;
+    int timeout = 0;
+    int rc = PLERROR;
+    switch(op) {
+    case MsgType::CREATREQ:
+        timeout = get_request_timeout(pmsg, dynamic_cast<KVReqMessage*>(pmsg)->get_timeout());
+        rc = m_store.sync_create(key, self_type, val.data(), val.size(), version);
+        break;
+    case MsgType::UPDATEREQ:
+        timeout  = get_request_timeout(pmsg, dynamic_cast<KVReqMessage*>(pmsg)->get_timeout());
+        expected = dynamic_cast<KVReqMessage*>(pmsg)->get_expected_version();
+        rc = m_store.sync_update(key, self_type, val.data(), val.size(), version, expected);
+        break;
+    case MsgType::DELETEREQ:
+        timeout  = get_request_timeout(pmsg, dynamic_cast<KeyReqMessage*>(pmsg)->get_timeout());
+        expected = dynamic_cast<KeyReqMessage*>(pmsg)->get_expected_version();
+        rc = m_store.sync_delete(key, self_type, expected);
+        break;
+    default:
+        return false;
+    }
+    if (rc != 0) {
+        // Nothing is changed, transaction decides with the other replicas
+        return false;
+    }
+    // A read started after the first mark may have cached the value the
+    // write just replaced
+    m_hotkeys.invalidate(key, key_hash);
+
+    int64 txid = reinterpret_cast<int64>(pmsg);
+    StoreMessage * presp = nullptr;
+    if (op == MsgType::CREATREQ) {
+        presp = new CreatResponseMessage(MessageOriginator::Client, txid, MsgStatus::OK);
+    }
+    else if (op == MsgType::UPDATEREQ) {
+        presp = new UpdateResponseMessage(MessageOriginator::Client, txid, MsgStatus::OK);
+    }
+    else {
+        presp = new DeleteResponseMessage(MessageOriginator::Client, txid, MsgStatus::OK);
+    }
+    presp->set_connection(pmsg->get_connection());
+    if (presp->build_msg() != 0) {
+        // Local replica is written, the others still have to be
+        getlog()->sendlog(LogLevel::ERROR, "Build local write response failed\n");
+        delete presp;
+    }
+    else {
+        send_message(presp);
+    }
+    GetStoreStats()->incr(StatCounter::LOCAL);
+
+    // Other replicas are written in background, the ones failed catch up by
+    // hinted handoff. Creates and updates go as repairs of the new version,
+    // a replica holding a newer value keeps it. Delete takes the expected
+    // version checked by local replica already
+    int replica_type = -1;
+    for (auto&& n : nodes) {
+        replica_type++;
+        if (replica_type == self_type) {
+            continue;
+        }
+        ip::tcp::endpoint ep = get_node_endpoint(n);
+        PeerChannel_ptr pchn = m_conn_mgr.get_channel(ep);
+        if (pchn.get() == nullptr) {
+            getlog()->sendlog(LogLevel::ERROR, "Can't find channel for node '%s:%d'\n",
+                             ep.address().to_string().c_str(), ep.port());
+            continue;
+        }
+
+        StoreMessage * preq = nullptr;
+        if (op == MsgType::DELETEREQ) {
+            DeleteRequestMessage * pdel = new DeleteRequestMessage(MessageOriginator::Server, txid);
+            pdel->set_key(key);
+            pdel->set_expected_version(expected);
+            preq = pdel;
+        }
+        else {
+            RepairRequestMessage * prep = new RepairRequestMessage(MessageOriginator::Server, txid);
+            prep->set_key(key);
+            prep->set_value(val.data(), val.size());
+            prep->set_version(version);
+            preq = prep;
+        }
+        preq->set_replica_type(replica_type);
+        preq->set_dest_endpoint(ep);
+        preq->set_deadline(get_deadline_now() + timeout);
+        pchn->async_call(preq, timeout,
+                         [this, ep, op, key, replica_type, val, version, expected](const ClientErrorCode& e,
+                                                                                    StoreMessage* presp) {
+                             handle_local_write_complete(e, presp, ep, op, key, replica_type,
+                                                         val, version, expected);
+                         });
+    }
+
+    finish_request(pmsg);
+    delete pmsg;
+    return true;
+}
+
+void ClientMessageHandler::handle_local_write_complete(const ClientErrorCode& e, StoreMessage* presp,
+                                                       const ip::tcp::endpoint& ep, MsgType op,
+                                                       const std::string& key, int replica_type,
+                                                       const std::vector<unsigned char>& val,
+                                                       uint64 version, uint64 expected)
+{
+    if (presp == nullptr) {
+        if ((e == ClientErrorCode::ERROR_IO) || (e == ClientErrorCode::ERROR_TIMEOUT)) {
+            m_hints.add_hint(ep, op, key, replica_type, val, version, expected);
+        }
+        getlog()->sendlog(LogLevel::WARNING, "Background write of '%s' to '%s:%d' failed, error=%d\n",
+                         key.c_str(), ep.address().to_string().c_str(), ep.port(),
+                         static_cast<int>(e));
+        return;
+    }
+
+    MsgStatus status = MsgStatus::ERROR;
+    KVRespMessage * pkv = dynamic_cast<KVRespMessage*>(presp);
+    KeyRespMessage * pdel = dynamic_cast<KeyRespMessage*>(presp);
+    if (pkv != nullptr) {
+        status = pkv->get_status();
+    }
+    else if (pdel != nullptr) {
+        status = pdel->get_status();
+    }
+    delete presp;
+
+    if (status == MsgStatus::OK) {
+        if (op != MsgType::DELETEREQ) {
+            m_hints.clear_hint(ep, key, replica_type, version);
+        }
+        return;
+    }
+    if (status == MsgStatus::BUSY) {
+        // Rejected without being served, try again by hinted handoff
+        m_hints.add_hint(ep, op, key, replica_type, val, version, expected);
+    }
+    getlog()->sendlog(LogLevel::WARNING, "Background write of '%s' to '%s:%d' failed, status=%d\n",
+                     key.c_str(), ep.address().to_string().c_str(), ep.port(),
+                     static_cast<int>(status));
+}
+
+void ClientMessageHandler::send_read(const std::string& key, unsigned long long txid,
+                                     const struct MemberEntry& n, int replica_type,
+                                     bool digest, int timeout_ms)
+{
+    ip::tcp::endpoint ep = get_node_endpoint(n);
+    if (is_self(n)) {
+        // Local value costs no bandwidth, always read it
+        m_store.async_read(key, replica_type, 
+                  [this, txid](int rc, const unsigned char* val, size_t sz,
+                               uint64 version) {
+                      handle_store_r_complete(rc, txid, val, sz, version);
+                  },
+                  get_deadline_now() + timeout_ms);
+        return;
+    }
+
+    PeerChannel_ptr pchn = m_conn_mgr.get_channel(ep);
+    if (pchn.get() == nullptr) {
+        getlog()->sendlog(LogLevel::ERROR, "Can't find channel for node '%s:%d'\n",
+                         ep.address().to_string().c_str(), ep.port());
+        handle_clt_crud_complete(static_cast<int>(ClientErrorCode::GENERIC_ERROR),
+                                 nullptr, txid, ep);
+        return;
+    }
+
+    ReadRequestMessage * preq = new ReadRequestMessage(MessageOriginator::Server,
+                                                       static_cast<int64>(txid));
+    preq->set_key(key);
+    preq->set_replica_type(replica_type);
+    preq->set_digest_only(digest);
+    preq->set_dest_endpoint(ep);
+    call_node(ep, pchn, preq, txid, timeout_ms);
+}
+
+int ClientMessageHandler::send_hedge(ClientTransaction * pclt_trn)
+{
+    ReadRequestMessage * pclt_req = dynamic_cast<ReadRequestMessage*>(pclt_trn->get_msg());
+    if (pclt_req == nullptr) {
+        return -1;
+    }
+
+    using namespace std::chrono;
+    long long left = duration_cast<milliseconds>(pclt_trn->get_deadline() - 
+                                                 steady_clock::now()).count();
+    if (left <= 0) {
+        return -1;
+    }
+
+    const struct MemberEntry * v = pclt_trn->get_nodes();
+    for (auto&& i : get_read_order(v, pclt_trn->get_node_count())) {
+        ip::tcp::endpoint ep = get_node_endpoint(v[i]);
+        if (pclt_trn->is_node_asked(ep)) {
+            continue;
+        }
+        // Value is asked again if the replica asked for it is late
+        bool digest = pclt_trn->has_data_node() && !pclt_trn->is_data_pending();
+        pclt_trn->start_wait_reply(ep, i, true);
+        GetStoreStats()->incr(StatCounter::HEDGE);
+        send_read(pclt_req->get_key(), pclt_trn->get_txid(), v[i], i,
+                  digest, static_cast<int>(left));
+        return 0;
+    }
+    return -1;
+}
+
+void ClientMessageHandler::start_hedge_timer(unsigned long long txid)
+{
+    TranShard & shard = get_shard(txid);
+    shard.strand.post([this, &shard, txid]() {
+        auto it = shard.pending.find(txid);
+        if ((it == shard.pending.end()) || it->second->is_client_response() ||
+            !it->second->has_spare_node()) {
+            return;
+        }
+
+        std::shared_ptr<deadline_timer> ptimer = std::make_shared<deadline_timer>(m_io);
+        shard.hedge_timers[txid] = ptimer;
+        ptimer->expires_from_now(boost::posix_time::microseconds(get_hedge_delay(shard)));
+        ptimer->async_wait(shard.strand.wrap([this, &shard, txid, ptimer](const boost::system::error_code& ec) {
+            if (ec == error::operation_aborted) {
+                return;
+            }
+            shard.hedge_timers.erase(txid);
+
+            auto it = shard.pending.find(txid);
+            if ((it == shard.pending.end()) || it->second->is_client_response()) {
+                return;
+            }
+            if (send_hedge(it->second) == 0) {
+                // Still late after the delay, ask next replica
+                start_hedge_timer(txid);
+            }
+        }));
+    });
+}
+
+void ClientMessageHandler::cancel_hedge_timer(TranShard& shard, unsigned long long txid)
+{
+    auto it = shard.hedge_timers.find(txid);
+    if (it != shard.hedge_timers.end()) {
+        it->second->cancel();
+        shard.hedge_timers.erase(it);
+    }
+}
+
+int64 ClientMessageHandler::get_hedge_delay(const TranShard& shard) const
+{
+    // Each shard sees a random sample of the reads
+    int64 us = shard.read_latency.get_percentile(m_pconfig->get_hedge_percentile(),
+                                             KV_HEDGE_MIN_SAMPLES);
+    if (us < 0) {
+        us = m_pconfig->get_hedge_delay() * 1000LL;
+    }
+    return us;
+}
+
+int ClientMessageHandler::fetch_read_value(ClientTransaction * pclt_trn)
+{
+    ip::tcp::endpoint ep;
+    int replica_type;
+    if (!pclt_trn->get_fetch_node(ep, replica_type)) {
+        return -1;
+    }
+
+    ReadRequestMessage * pclt_req = dynamic_cast<ReadRequestMessage*>(pclt_trn->get_msg());
+    PeerChannel_ptr pchn = m_conn_mgr.get_channel(ep);
+    if ((pclt_req == nullptr) || (pchn.get() == nullptr)) {
+        getlog()->sendlog(LogLevel::ERROR, "Can't fetch value from node '%s:%d'\n",
+                         ep.address().to_string().c_str(), ep.port());
+        return -1;
+    }
+
+    using namespace std::chrono;
+    long long left = duration_cast<milliseconds>(pclt_trn->get_deadline() - 
+                                                 steady_clock::now()).count();
+    if (left <= 0) {
+        return -1;
+    }
+
+    pclt_trn->start_fetch(ep);
+
+    ReadRequestMessage * preq = new ReadRequestMessage(MessageOriginator::Server,
+                                                       pclt_trn->get_txid());
+    preq->set_key(pclt_req->get_key());
+    preq->set_replica_type(replica_type);
+    preq->set_dest_endpoint(ep);
+    preq->set_deadline(get_deadline_now() + left);
+
+    unsigned long long txid = pclt_trn->get_txid();
+    pchn->async_call(preq, static_cast<int>(left),
+                     [this, txid, ep](const ClientErrorCode& e,
+                                      StoreMessage* presp) {
+                         handle_clt_fetch_complete(presp, txid, ep);
+                     });
+    return 0;
+}
+
+uint64 ClientMessageHandler::get_next_version()
+{
+    using namespace std::chrono;
+    uint64 now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    uint64 last = m_last_version.load();
+    uint64 next;
+    do {
+        next = std::max(now, last + 1);
+    } while (!m_last_version.compare_exchange_weak(last, next));
+    return next;
+}
+
 void ClientMessageHandler::handle_store_cud_complete(int rc, unsigned long long txid)
 {
-    m_strand.post([this, rc, txid]() {
-        auto it = m_pending_tran.find(txid);
-        if (it != m_pending_tran.end()) {
+    TranShard & shard = get_shard(txid);
+    shard.strand.post([this, &shard, rc, txid]() {
+        auto it = shard.pending.find(txid);
+        if (it != shard.pending.end()) {
             it->second->add_reply(get_self_endpoint(), 
-                                  rc);
-            handle_node_reply(it);
+                                  (rc == PLCONFLICT) ? static_cast<int>(MsgStatus::CONFLICT) : rc);
+            handle_node_reply(shard, it);
         }
     });
 }
 
 void ClientMessageHandler::handle_store_r_complete(int rc, unsigned long long txid,
-                                                   unsigned char* data, size_t sz)
+                                                   const unsigned char* data, size_t sz,
+                                                   uint64 version)
 {
-    m_strand.post([=]() {
-        auto it = m_pending_tran.find(txid);
-        if (it != m_pending_tran.end()) {
+    // Value is freed when the handler returns
+    std::vector<unsigned char> v(data, data + sz);
+    TranShard & shard = get_shard(txid);
+    shard.strand.post([this, &shard, rc, txid, v, version]() {
+        auto it = shard.pending.find(txid);
+        if (it != shard.pending.end()) {
             it->second->add_reply(get_self_endpoint(), 
-                                  rc, data, sz);
-            handle_node_reply(it);
+                                  rc, v.data(), v.size(),
+                                  version, get_value_digest(v.data(), v.size()));
+            handle_node_reply(shard, it);
         }
     });
 }
 
+void ClientMessageHandler::call_node(const ip::tcp::endpoint& ep,
+                                     PeerChannel_ptr pchn,
+                                     StoreMessage* preq,
+                                     unsigned long long txid,
+                                     int timeout_ms)
+{
+    // Channel assigns its own transaction id to the request, the reply is
+    // matched back to the client transaction by the handler. Replica drops
+    // the request once the transaction would time out
+    preq->set_deadline(get_deadline_now() + timeout_ms);
+    pchn->async_call(preq, timeout_ms,
+                     [this, txid, ep](const ClientErrorCode& e,
+                                      StoreMessage* presp) {
+                         handle_clt_crud_complete(static_cast<int>(e), presp, txid, ep);
+                     });
+}
+
 void ClientMessageHandler::handle_clt_crud_complete(int rc, 
                                                     StoreMessage * pmsg,
-                                                    unsigned long long txid)
+                                                    unsigned long long txid,
+                                                    const ip::tcp::endpoint& ep)
 {
-    m_strand.post([this, rc, pmsg, txid]() {
-        auto it = m_pending_tran.find(txid);
-        if (it != m_pending_tran.end()) {
-            it->second->add_reply(pmsg);
-            handle_node_reply(it);
+    TranShard & shard = get_shard(txid);
+    shard.strand.post([this, &shard, rc, pmsg, txid, ep]() {
+        auto it = shard.pending.find(txid);
+        if (it != shard.pending.end()) {
+            ClientTransaction * pclt_trn = it->second;
+            bool hedged = false;
+            if (pclt_trn->get_type() == ClientTransaction::REQUEST_TYPE::READ) {
+                hedged = pclt_trn->is_hedged(ep);
+                if (pmsg != nullptr) {
+                    using namespace std::chrono;
+                    shard.read_latency.add(duration_cast<microseconds>(steady_clock::now() - 
+                                       pclt_trn->get_sent_time(ep)).count());
+                }
+            }
+            else if ((pmsg == nullptr) && 
+                     ((rc == static_cast<int>(ClientErrorCode::ERROR_IO)) ||
+                      (rc == static_cast<int>(ClientErrorCode::ERROR_TIMEOUT)))) {
+                add_hint(pclt_trn, ep);
+            }
+            else if (pmsg != nullptr) {
+                clear_hint(pclt_trn, ep, pmsg);
+            }
+            pclt_trn->add_reply(ep, pmsg);
+            if (handle_node_reply(shard, it) && hedged) {
+                GetStoreStats()->incr(StatCounter::HEDGE_WIN);
+            }
+        }
+        if (pmsg != nullptr) {
+            delete pmsg;
         }
     });
 }
 
-void ClientMessageHandler::handle_node_reply(std::map<unsigned long long, ClientTransaction* >::iterator& it)
+void ClientMessageHandler::handle_clt_fetch_complete(StoreMessage * pmsg,
+                                                     unsigned long long txid,
+                                                     const ip::tcp::endpoint& ep)
 {
+    TranShard & shard = get_shard(txid);
+    shard.strand.post([this, &shard, pmsg, txid, ep]() {
+        auto it = shard.pending.find(txid);
+        if (it != shard.pending.end()) {
+            it->second->add_fetch_reply(ep, pmsg);
+            handle_node_reply(shard, it);
+        }
+        if (pmsg != nullptr) {
+            delete pmsg;
+        }
+    });
+}
+
+bool ClientMessageHandler::handle_node_reply(TranShard& shard, TRAN_MAP::iterator it)
+{
+    bool answered = false;
     CheckOperation op = check_clnt_tran(it->second);
+    if (op==CheckOperation::HEDGE) {
+        // Replies required can only be reached by asking another replica
+        if (send_hedge(it->second) != 0) {
+            op = CheckOperation::ERROR;
+        }
+    }
+    if (op==CheckOperation::FETCH) {
+        if (fetch_read_value(it->second) != 0) {
+            op = CheckOperation::ERROR;
+        }
+    }
     if (op==CheckOperation::SEND_RESP) {
         // construct response message and send back
         StoreMessage * resp = construct_client_resp_msg(it->second, MsgStatus::OK);
         if (resp != nullptr) {
             send_message(resp);
             it->second->mark_send_clnt_resp();
+            answer_waiters(it->second, MsgStatus::OK);
+            update_hot_key(it->second, MsgStatus::OK);
+            answered = true;
         }
     }
+    if (op==CheckOperation::ERROR) {
+        // Required replies can't be reached any more, fail the client now
+        // and keep the transaction for the replies still pending
+        StoreMessage * resp = construct_client_resp_msg(it->second, get_failed_status(it->second));
+        if (resp != nullptr) {
+            send_message(resp);
+        }
+        it->second->mark_send_clnt_resp();
+        answer_waiters(it->second, MsgStatus::ERROR);
+        update_hot_key(it->second, MsgStatus::ERROR);
+        op = check_clnt_tran(it->second);
+    }
     if (op==CheckOperation::DELETE) {
         if (!it->second->is_client_response()) {
             // failed
-            StoreMessage * resp = construct_client_resp_msg(it->second, MsgStatus::ERROR);
+            StoreMessage * resp = construct_client_resp_msg(it->second, get_failed_status(it->second));
             if (resp != nullptr) {
                 send_message(resp);
             }
+            answer_waiters(it->second, MsgStatus::ERROR);
+            update_hot_key(it->second, MsgStatus::ERROR);
         }
-        delete it->second;
-        m_pending_tran.erase(it);
+        read_repair(it->second);
+        cancel_hedge_timer(shard, it->first);
+        shard.timeouts.cancel(it->first);
+        finish_request(it->second->get_msg());
+        shard.pool.release(it->second);
+        shard.pending.erase(it);
+        GetAdmission()->add_pending(-1);
     }
+    return answered;
+}
+
+void ClientMessageHandler::read_repair(ClientTransaction * pclt_trn)
+{
+    if ((pclt_trn->get_type() != ClientTransaction::REQUEST_TYPE::READ) ||
+        (m_pconfig->get_read_repair_rate() <= 0)) {
+        return;
+    }
+
+    std::vector<std::pair<ip::tcp::endpoint, int> > stale;
+    pclt_trn->get_stale_nodes(stale);
+    if (stale.empty()) {
+        return;
+    }
+
+    ClientTransaction::ValueView val;
+    uint64 version = 0;
+    ReadRequestMessage * pclt_req = dynamic_cast<ReadRequestMessage*>(pclt_trn->get_msg());
+    if ((pclt_req == nullptr) || (pclt_trn->get_read_value(val, version) != 0)) {
+        return;
+    }
+
+    for (auto&& s : stale) {
+        const ip::tcp::endpoint & ep = s.first;
+        if (!acquire_repair_token(ep)) {
+            getlog()->sendlog(LogLevel::DEBUG, "Read repair to '%s:%d' skipped, rate limited\n",
+                             ep.address().to_string().c_str(), ep.port());
+            continue;
+        }
+
+        if (ep == get_self_endpoint()) {
+            GetStoreStats()->incr(StatCounter::READ_REPAIR);
+            m_store.async_repair(pclt_req->get_key(), s.second,
+                                 val.data, val.size, version,
+                                 [](int rc) {
+                                     (void)rc;
+                                 });
+            continue;
+        }
+
+        PeerChannel_ptr pchn = m_conn_mgr.get_channel(ep);
+        if (pchn.get() == nullptr) {
+            continue;
+        }
+        GetStoreStats()->incr(StatCounter::READ_REPAIR);
+        RepairRequestMessage * preq = new RepairRequestMessage(MessageOriginator::Server,
+                                                               pclt_trn->get_txid());
+        preq->set_key(pclt_req->get_key());
+        preq->set_value(val.data, val.size);
+        preq->set_version(version);
+        preq->set_replica_type(s.second);
+        preq->set_dest_endpoint(ep);
+        pchn->async_call(preq, m_pconfig->get_message_timeout(),
+                         [ep](const ClientErrorCode& e, StoreMessage* presp) {
+                             if (e != ClientErrorCode::SUCCESS) {
+                                 getlog()->sendlog(LogLevel::WARNING, "Read repair to '%s:%d' failed, rc=%d\n",
+                                                  ep.address().to_string().c_str(), ep.port(),
+                                                  static_cast<int>(e));
+                             }
+                             if (presp != nullptr) {
+                                 delete presp;
+                             }
+                         });
+    }
+}
+
+bool ClientMessageHandler::join_flight(ReadRequestMessage* pmsg, int required)
+{
+    if (!m_pconfig->is_read_coalesce()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex > lock(m_flight_mtx);
+    auto it = m_flights.find(pmsg->get_key());
+    if (it == m_flights.end()) {
+        // Lead a new flight
+        ReadFlight & f = m_flights[pmsg->get_key()];
+        f.txid     = reinterpret_cast<unsigned long long>(pmsg);
+        f.required = required;
+        return false;
+    }
+    if (it->second.required < required) {
+        // Weaker read in flight can't answer it
+        return false;
+    }
+    it->second.waiters.push_back(pmsg);
+    GetStoreStats()->incr(StatCounter::COALESCED);
+    return true;
+}
+
+void ClientMessageHandler::answer_waiters(ClientTransaction * pclt_trn, MsgStatus status)
+{
+    ReadRequestMessage * preq = dynamic_cast<ReadRequestMessage*>(pclt_trn->get_msg());
+    if ((pclt_trn->get_type() != ClientTransaction::REQUEST_TYPE::READ) || (preq == nullptr)) {
+        return;
+    }
+
+    std::vector<ReadRequestMessage* > waiters;
+    {
+        std::lock_guard<std::mutex > lock(m_flight_mtx);
+        auto it = m_flights.find(preq->get_key());
+        if ((it == m_flights.end()) ||
+            (it->second.txid != static_cast<unsigned long long>(pclt_trn->get_txid()))) {
+            return;
+        }
+        waiters.swap(it->second.waiters);
+        m_flights.erase(it);
+    }
+
+    ClientTransaction::ValueView v = { nullptr, 0 };
+    uint64 version = 0;
+    if (status == MsgStatus::OK) {
+        pclt_trn->get_read_value(v, version);
+    }
+    for (auto&& p : waiters) {
+        ReadResponseMessage * presp = new ReadResponseMessage(MessageOriginator::Client,
+                                                              reinterpret_cast<int64>(p),
+                                                              status);
+        presp->set_value(v.data, v.size);
+        presp->set_version(version);
+        presp->set_connection(p->get_connection());
+        if (presp->build_msg() != 0) {
+            getlog()->sendlog(LogLevel::ERROR, "Build coalesced read response failed\n");
+            delete presp;
+        }
+        else {
+            send_message(presp);
+        }
+
+        finish_request(p);
+        delete p;
+    }
+}
+
+void ClientMessageHandler::finish_request(const StoreMessage* pmsg)
+{
+    if ((m_psched != nullptr) && (pmsg != nullptr)) {
+        m_psched->complete(pmsg->get_tenant());
+    }
+}
+
+void ClientMessageHandler::add_hint(ClientTransaction * pclt_trn,
+                                    const ip::tcp::endpoint& ep)
+{
+    std::vector<unsigned char> val;
+    std::string key;
+    MsgType op;
+    uint64 expected = 0;
+    switch(pclt_trn->get_type()) {
+    case ClientTransaction::REQUEST_TYPE::CREAT:
+    case ClientTransaction::REQUEST_TYPE::UPDATE:
+    {
+        KVReqMessage * preq = dynamic_cast<KVReqMessage*>(pclt_trn->get_msg());
+        if (preq == nullptr) {
+            return;
+        }
+        key = preq->get_key();
+        preq->get_value(val);
+        op  = preq->get_msgtype();
+        break;
+    }
+    case ClientTransaction::REQUEST_TYPE::DELETE:
+    {
+        KeyReqMessage * preq = dynamic_cast<KeyReqMessage*>(pclt_trn->get_msg());
+        if (preq == nullptr) {
+            return;
+        }
+        key      = preq->get_key();
+        op       = preq->get_msgtype();
+        expected = preq->get_expected_version();
+        break;
+    }
+    default:
+        return;
+    }
+
+    m_hints.add_hint(ep, op, key, pclt_trn->get_replica_type(ep),
+                     val, pclt_trn->get_version(), expected);
+}
+
+void ClientMessageHandler::clear_hint(ClientTransaction * pclt_trn,
+                                      const ip::tcp::endpoint& ep,
+                                      StoreMessage * presp)
+{
+    // Only a value written by create or update outdates a delete hint
+    if ((pclt_trn->get_type() != ClientTransaction::REQUEST_TYPE::CREAT) &&
+        (pclt_trn->get_type() != ClientTransaction::REQUEST_TYPE::UPDATE)) {
+        return;
+    }
+    KVRespMessage * pkv = dynamic_cast<KVRespMessage*>(presp);
+    KVReqMessage * preq = dynamic_cast<KVReqMessage*>(pclt_trn->get_msg());
+    if ((pkv == nullptr) || (pkv->get_status() != MsgStatus::OK) || (preq == nullptr)) {
+        return;
+    }
+    m_hints.clear_hint(ep, preq->get_key(), pclt_trn->get_replica_type(ep),
+                       pclt_trn->get_version());
+}
+
+bool ClientMessageHandler::acquire_repair_token(const ip::tcp::endpoint& ep)
+{
+    std::lock_guard<std::mutex > lock(m_repair_mtx);
+    auto it = m_repair_limits.find(ep);
+    if (it == m_repair_limits.end()) {
+        double rate = m_pconfig->get_read_repair_rate();
+        it = m_repair_limits.insert(std::make_pair(ep, TokenBucket(rate, rate))).first;
+    }
+    return it->second.try_acquire();
 }
 
 ClientMessageHandler::CheckOperation ClientMessageHandler::check_clnt_tran(ClientTransaction* pclt_trn)
@@ -416,9 +1523,24 @@ ClientMessageHandler::CheckOperation ClientMessageHandler::check_clnt_tran(Clien
     int total_reply;
     int succ_reply;
     std::tie(total_reply, succ_reply) = pclt_trn->get_reply_count();
-    if (succ_reply >= m_pconfig->get_quorum_num()) {
-        if (!pclt_trn->is_client_response()) {
-            return CheckOperation::SEND_RESP;
+    if (!pclt_trn->is_client_response()) {
+        if (succ_reply >= pclt_trn->get_required_count()) {
+            if ((pclt_trn->get_type() != ClientTransaction::REQUEST_TYPE::READ) ||
+                pclt_trn->has_newest_value()) {
+                return CheckOperation::SEND_RESP;
+            }
+            // Digests mismatch, or the replica asked for value failed
+            if (pclt_trn->is_data_pending() || pclt_trn->is_fetching()) {
+                return CheckOperation::NOP;
+            }
+            return CheckOperation::FETCH;
+        }
+        int pending = pclt_trn->get_wait_count() - total_reply;
+        if (succ_reply + pending < pclt_trn->get_required_count()) {
+            if (pclt_trn->has_spare_node()) {
+                return CheckOperation::HEDGE;
+            }
+            return CheckOperation::ERROR;
         }
     }
     if (total_reply >= pclt_trn->get_wait_count()) {
@@ -427,6 +1549,39 @@ ClientMessageHandler::CheckOperation ClientMessageHandler::check_clnt_tran(Clien
     return CheckOperation::NOP;
 }
 
+int ClientMessageHandler::get_required_replies(ConsistencyLevel level, size_t nodes) const
+{
+    int required = 0;
+    switch(level) {
+    case ConsistencyLevel::ONE:
+        required = 1;
+        break;
+    case ConsistencyLevel::QUORUM:
+        required = nodes / 2 + 1;
+        break;
+    case ConsistencyLevel::ALL:
+        required = nodes;
+        break;
+    default:
+        required = m_pconfig->get_quorum_num();
+        break;
+    }
+    // Nobody to reply, transaction fails on timeout
+    return std::max(required, 1);
+}
+
+int ClientMessageHandler::get_request_timeout(const StoreMessage* pmsg, int32 timeout) const
+{
+    if (timeout <= 0) {
+        timeout = m_pconfig->get_message_timeout();
+    }
+    if (pmsg->get_deadline() > 0) {
+        int64 left = pmsg->get_deadline() - get_deadline_now();
+        timeout = static_cast<int32>(std::max<int64>(std::min<int64>(timeout, left), 1));
+    }
+    return timeout;
+}
+
 void ClientMessageHandler::add_pending_tran(StoreMessage* pmsg, 
                                             ClientTransaction * pclt_trn)
 {
@@ -434,15 +1589,82 @@ void ClientMessageHandler::add_pending_tran(StoreMessage* pmsg,
         getlog()->sendlog(LogLevel::FATAL, "add pending transaction, nullptr\n");
         return ;
     }
-    m_strand.post([this, pmsg, pclt_trn]() {
-            if (m_pending_tran.find(reinterpret_cast<unsigned long long>(pmsg)) != m_pending_tran.end()) {
+    unsigned long long txid = reinterpret_cast<unsigned long long>(pmsg);
+    TranShard & shard = get_shard(txid);
+    shard.strand.post([this, &shard, txid, pclt_trn]() {
+            if (!shard.pending.insert(std::make_pair(txid, pclt_trn)).second) {
                 return;
             }
-            m_pending_tran.insert(std::make_pair(reinterpret_cast<unsigned long long>(pmsg), pclt_trn));
+            GetAdmission()->add_pending(1);
+
+            // Client is answered with error and the transaction is deleted
+            // when the deadline of the request is reached
+            shard.timeouts.add(txid, get_wheel_tick(pclt_trn->get_deadline()));
+            start_wheel_timer(shard);
         });
 
 }
 
+uint64 ClientMessageHandler::get_wheel_tick(std::chrono::steady_clock::time_point tp)
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(tp.time_since_epoch()).count();
+}
+
+void ClientMessageHandler::start_wheel_timer(TranShard& shard)
+{
+    if (shard.wheel_running || shard.timeouts.empty()) {
+        return;
+    }
+    shard.wheel_running = true;
+    shard.wheel_timer.expires_from_now(boost::posix_time::milliseconds(1));
+    shard.wheel_timer.async_wait(shard.strand.wrap([this, &shard](const boost::system::error_code& ec) {
+        shard.wheel_running = false;
+        if (ec == error::operation_aborted) {
+            return;
+        }
+        handle_wheel_timer(shard);
+    }));
+}
+
+void ClientMessageHandler::handle_wheel_timer(TranShard& shard)
+{
+    std::vector<TimingWheel::TIMER_ID > expired;
+    shard.timeouts.advance(get_wheel_tick(std::chrono::steady_clock::now()), expired);
+    for (auto&& txid : expired) {
+        auto it = shard.pending.find(txid);
+        if (it == shard.pending.end()) {
+            continue;
+        }
+        if (!it->second->is_client_response()) {
+            StoreMessage * resp = construct_client_resp_msg(it->second, get_failed_status(it->second));
+            if (resp != nullptr) {
+                send_message(resp);
+            }
+            answer_waiters(it->second, MsgStatus::ERROR);
+            update_hot_key(it->second, MsgStatus::ERROR);
+        }
+        read_repair(it->second);
+        cancel_hedge_timer(shard, it->first);
+        finish_request(it->second->get_msg());
+        shard.pool.release(it->second);
+        shard.pending.erase(it);
+        GetAdmission()->add_pending(-1);
+    }
+    start_wheel_timer(shard);
+}
+
+MsgStatus ClientMessageHandler::get_failed_status(const ClientTransaction* pclt_trn) const
+{
+    if (pclt_trn->get_conflict_count() > 0) {
+        // Expected version isn't the current one on some replica, client
+        // should read again before retry
+        GetStoreStats()->incr(StatCounter::CONFLICT);
+        return MsgStatus::CONFLICT;
+    }
+    return MsgStatus::ERROR;
+}
+
 StoreMessage* ClientMessageHandler::construct_client_resp_msg(ClientTransaction* pclt_trn,
                                                               MsgStatus status)
 {
@@ -461,16 +1683,20 @@ StoreMessage* ClientMessageHandler::construct_client_resp_msg(ClientTransaction*
     {
         presp = new ReadResponseMessage(MessageOriginator::Client,
                                         pclt_trn->get_txid(), status);
-        std::vector<unsigned char> v;
-        pclt_trn->get_read_value(v);
-        dynamic_cast<ReadResponseMessage*>(presp)->set_value(v);
+        ClientTransaction::ValueView v = { nullptr, 0 };
+        uint64 version = 0;
+        pclt_trn->get_read_value(v, version);
+        dynamic_cast<ReadResponseMessage*>(presp)->set_value(v.data, v.size);
+        dynamic_cast<ReadResponseMessage*>(presp)->set_version(version);
         break;
     }
     case ClientTransaction::REQUEST_TYPE::UPDATE:
-        //presp = construct_update_response(pclt_trn->get_txid(), status);
+        presp = new UpdateResponseMessage(MessageOriginator::Client,
+                                          pclt_trn->get_txid(), status);
         break;
     case ClientTransaction::REQUEST_TYPE::DELETE:
-        //presp = construct_delete_response(pclt_trn->get_txid(), status);
+        presp = new DeleteResponseMessage(MessageOriginator::Client,
+                                          pclt_trn->get_txid(), status);
         break;
     default:
         break;
@@ -478,6 +1704,11 @@ StoreMessage* ClientMessageHandler::construct_client_resp_msg(ClientTransaction*
 
     if (presp != nullptr) {
         presp->set_connection(pclt_trn->get_msg()->get_connection());
+        if (presp->build_msg() != 0) {
+            getlog()->sendlog(LogLevel::ERROR, "Build client response failed\n");
+            delete presp;
+            presp = nullptr;
+        }
     }
 
     return presp;
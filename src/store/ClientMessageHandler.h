@@ -17,10 +17,23 @@
  */
 #include "stdinclude.h"
 #include "StoreMessage.h"
+#include "KVMessage.h"
 #include "StoreMessageHandler.h"
+#include "WatchManager.h"
+#include "PeerChannel.h"
+#include "TokenBucket.h"
+#include "LatencyTracker.h"
+#include "HintStore.h"
+#include "HotKeyCache.h"
+#include "TimingWheel.h"
 //#include "Connection.h"
 
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
 #include <boost/asio.hpp>
 
 /*
@@ -28,6 +41,8 @@
  *  Forward declaraction                                                       *
  *******************************************************************************
  */
+class Connection;
+class FairScheduler;
 
 /*
  *******************************************************************************
@@ -40,10 +55,11 @@ public:
     ClientMessageHandler(boost::asio::io_service& io,
                          ConnectionManager& mgr,
                          StoreManager & store,
-                         ConfigPortal * pcfg);
+                         ConfigPortal * pcfg,
+                         FairScheduler * psched = nullptr);
     ~ClientMessageHandler();
 
-    virtual void handle_time_event();
+    virtual void handle_connection_close(Connection* pconn);
 protected:
     virtual int handle_create_request(CreatRequestMessage* pmsg);
     virtual int handle_create_response(CreatResponseMessage* pmsg);
@@ -57,35 +73,203 @@ protected:
     virtual int handle_delete_request(DeleteRequestMessage* pmsg);
     virtual int handle_delete_response(DeleteResponseMessage* pmsg);
 
+    virtual int handle_feed_request(FeedRequestMessage* pmsg);
+
+    virtual int handle_watch_request(WatchRequestMessage* pmsg);
+    virtual int handle_unwatch_request(UnwatchRequestMessage* pmsg);
+    // Key is watched on the node holding its primary replica, prefix on
+    // every node; unwatch goes to every node
+    void forward_watch(const std::string& key, bool prefix, bool watch);
+    // Change matched by a watch forwarded to other node
+    void handle_watch_notify(StoreMessage* pmsg);
+
     void handle_store_cud_complete(int rc, unsigned long long txid);
     void handle_store_r_complete(int rc, unsigned long long txid, 
-                                 unsigned char* data, size_t sz);
-    void handle_clt_crud_complete(int rc, StoreMessage* pmsg, unsigned long long txid);
+                                 const unsigned char* data, size_t sz,
+                                 uint64 version);
+    void handle_clt_crud_complete(int rc, StoreMessage* pmsg, unsigned long long txid,
+                                  const boost::asio::ip::tcp::endpoint& ep);
+    void handle_clt_fetch_complete(StoreMessage* pmsg, unsigned long long txid,
+                                   const boost::asio::ip::tcp::endpoint& ep);
 private:
+    typedef std::unordered_map<unsigned long long, ClientTransaction* > TRAN_MAP;
+
+    // Pending transactions are sharded by txid, all the state of a shard is
+    // called by the strand of the shard
+    struct TranShard {
+        explicit TranShard(boost::asio::io_service& io);
+
+        boost::asio::io_service::strand  strand;
+        TRAN_MAP                         pending;
+        ClientTransactionPool            pool;
+
+        // Deadlines of pending transactions
+        TimingWheel                      timeouts;
+        boost::asio::deadline_timer      wheel_timer;
+        bool                             wheel_running;
+
+        // Speculative read timers and replica read latencies
+        std::map<unsigned long long, std::shared_ptr<boost::asio::deadline_timer> > hedge_timers;
+        LatencyTracker                   read_latency;
+    };
+
+    TranShard& get_shard(unsigned long long txid);
+
     void add_pending_tran(StoreMessage * pmsg, ClientTransaction* clt_trn);
 
     int prepare_node_tran(const std::vector<struct MemberEntry >&, 
                           ClientTransaction *,
-                          std::map<boost::asio::ip::tcp::endpoint, StoreClient* > &);
+                          std::map<boost::asio::ip::tcp::endpoint, PeerChannel_ptr > &);
+
+    // Replicas in the order they are asked by a read: self if it is a
+    // replica, replicas of the same zone, then in preference order. First
+    // one is asked for the value by a digest read
+    std::vector<int> get_read_order(const struct MemberEntry * nodes, size_t cnt);
+    void send_read(const std::string& key, unsigned long long txid,
+                   const struct MemberEntry& n, int replica_type,
+                   bool digest, int timeout_ms);
+
+    // Local fast path: the local replica alone satisfies the request, it is
+    // accessed synchronously and the client is answered without transaction.
+    // Returns false if the request goes the transaction path
+    int get_local_replica(const std::vector<struct MemberEntry >& nodes, int required);
+    bool local_read(ReadRequestMessage* pmsg,
+                    const std::vector<struct MemberEntry >& nodes);
+    bool local_write(StoreMessage* pmsg, const std::string& key, uint64 key_hash,
+                     const std::vector<unsigned char>& val, int required,
+                     const std::vector<struct MemberEntry >& nodes);
+    // Reply of a replica written in background by local fast path
+    void handle_local_write_complete(const ClientErrorCode& e, StoreMessage* presp,
+                                     const boost::asio::ip::tcp::endpoint& ep, MsgType op,
+                                     const std::string& key, int replica_type,
+                                     const std::vector<unsigned char>& val,
+                                     uint64 version, uint64 expected);
+
+    // Speculative read to a replica not asked yet
+    int send_hedge(ClientTransaction * pclt_trn);
+    void start_hedge_timer(unsigned long long txid);
+    void cancel_hedge_timer(TranShard& shard, unsigned long long txid);
+    // Microseconds to wait for replies before a speculative read
+    int64 get_hedge_delay(const TranShard& shard) const;
+    // Fetch the value from the replica with newest version, digests mismatch
+    int fetch_read_value(ClientTransaction * pclt_trn);
+
+    // Version of the value written, increases with time
+    uint64 get_next_version();
+
+    // Write the value read to stale replicas, client has been answered
+    void read_repair(ClientTransaction * pclt_trn);
+    bool acquire_repair_token(const boost::asio::ip::tcp::endpoint& ep);
+
+    // Singleflight reads: concurrent reads of a key are answered by the
+    // transaction of the first one. Returns true if 'pmsg' waits for the
+    // read in flight, false if it leads a flight or can't join
+    bool join_flight(ReadRequestMessage* pmsg, int required);
+    // Client of the read led by 'pclt_trn' is answered, answer the waiters
+    // with the same result
+    void answer_waiters(ClientTransaction * pclt_trn, MsgStatus status);
+
+    // Answer the read from the hot key cache. Returns true if answered
+    bool cached_read(ReadRequestMessage* pmsg, int required);
+    // Client of 'pclt_trn' is answered: value read of a hot key is cached,
+    // a write drops the cached value
+    void update_hot_key(ClientTransaction * pclt_trn, MsgStatus status);
 
-    void handle_node_reply(std::map<unsigned long long, ClientTransaction* >::iterator& );
+    // Client request is done with, frees its slot of the fair scheduler
+    void finish_request(const StoreMessage* pmsg);
+
+    // Keep the write failed to an unavailable replica for hinted handoff
+    void add_hint(ClientTransaction * pclt_trn, const boost::asio::ip::tcp::endpoint& ep);
+    // Drop the delete hint of the replica the write just reached
+    void clear_hint(ClientTransaction * pclt_trn, const boost::asio::ip::tcp::endpoint& ep,
+                    StoreMessage * presp);
+
+    // Send request to remote node over the channel to the node
+    void call_node(const boost::asio::ip::tcp::endpoint& ep, PeerChannel_ptr pchn,
+                   StoreMessage* preq, unsigned long long txid, int timeout_ms);
+
+    // Returns true if the client is answered successfully
+    bool handle_node_reply(TranShard& shard, TRAN_MAP::iterator it);
     enum class CheckOperation : int {
         NOP = 0,
         SEND_RESP,
+        HEDGE,
+        FETCH,
         DELETE,
         ERROR
     };
     CheckOperation check_clnt_tran(ClientTransaction* pclt_trn);
 
+    // Successful replies required by the consistency level of the request
+    int get_required_replies(ConsistencyLevel level, size_t nodes) const;
+    // Timeout of the request in milliseconds, cut to the deadline of the
+    // client if it is earlier
+    int get_request_timeout(const StoreMessage* pmsg, int32 timeout) const;
+
+    // CONFLICT if any replica rejected the conditional write, else ERROR
+    MsgStatus get_failed_status(const ClientTransaction* pclt_trn) const;
     StoreMessage* construct_client_resp_msg(ClientTransaction *, MsgStatus);
 
+    // Transaction timeouts, ticks are milliseconds of steady clock
+    static uint64 get_wheel_tick(std::chrono::steady_clock::time_point tp);
+    void start_wheel_timer(TranShard& shard);
+    void handle_wheel_timer(TranShard& shard);
+
     boost::asio::ip::tcp::endpoint get_node_endpoint(const struct MemberEntry& e); 
     boost::asio::ip::tcp::endpoint get_self_endpoint() const;
 
+    // Change feed subscriptions, called by feed strand
+    void handle_store_change(uint64 seq);
+    void pump_feed(Connection* pconn);
+    void send_feed(Connection* pconn, FeedResponseMessage* presp, 
+                   int rc, uint64 next_seq);
+private:
+    struct FeedSubscription {
+        std::weak_ptr<Connection > conn;
+        int64                      txid;
+        uint64                     next_seq;
+        size_t                     max_batch;
+        bool                       busy;   // a read from store is pending
+        bool                       acked;  // first response sent
+    };
 private:
-    boost::asio::io_service::strand  m_strand;
+    FairScheduler *                  m_psched;
+
+    std::vector<std::unique_ptr<TranShard > > m_shards;
+
+    std::atomic<uint64>              m_last_version;
+
+    // Read repair rate limit of each node, shared by shards
+    std::mutex                       m_repair_mtx;
+    std::map<boost::asio::ip::tcp::endpoint, TokenBucket > m_repair_limits;
+
+    // Reads in flight by key, shared by shards
+    struct ReadFlight {
+        ReadFlight() : txid(0), required(0), waiters() {
+        }
+
+        unsigned long long                txid;       // of the leader
+        int                               required;   // replies of the leader
+        std::vector<ReadRequestMessage* > waiters;
+    };
+    std::mutex                       m_flight_mtx;
+    std::unordered_map<std::string, ReadFlight > m_flights;
+
+    // Values of hot keys, shared by shards
+    HotKeyCache                      m_hotkeys;
+
+    // Writes to replicas unavailable, replayed when they are back
+    HintStore                        m_hints;
+
+    // Change feed subscriptions, keyed by connection
+    boost::asio::io_service::strand  m_feed_strand;
+    std::map<Connection*, FeedSubscription > m_feed_subs;
+    std::atomic<size_t>              m_feed_sub_cnt;
+    uint64                           m_feed_last_seq;
 
-    std::map<unsigned long long, ClientTransaction* > m_pending_tran;
+    // Key/prefix watches of clients, forwarded to the nodes of primary
+    // replicas again every membership period
+    WatchManager                     m_watch;
 };
 
 /*
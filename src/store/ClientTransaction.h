@@ -22,7 +22,9 @@
 
 #include <tuple>
 #include <utility>
-#include <map>
+#include <vector>
+#include <algorithm>
+#include <mutex>
 #include <chrono>
 #include <boost/asio.hpp>
 
@@ -38,6 +40,11 @@
  *******************************************************************************
  */
 
+/**
+ * Replica slots are kept inline, up to PLUTO_NODE_REPLICAS_NUM. Transactions
+ * are recycled by ClientTransactionPool, value buffers of the slots keep their
+ * capacity across requests.
+ */
 class ClientTransaction {
 public:
     enum REQUEST_TYPE {
@@ -47,28 +54,45 @@ public:
         DELETE
     };
 
-    ClientTransaction(StoreMessage * pmsg,
-                      REQUEST_TYPE   tp,
-                      const std::vector<struct MemberEntry > & nodes) :
-       m_pmsg(pmsg),
-       m_txid(reinterpret_cast<long long>(pmsg)),
-       m_type(tp),
-       m_crttm(std::chrono::system_clock::now()),
+    // Value held by a reply, valid until the transaction is released
+    struct ValueView {
+        const unsigned char* data;
+        size_t               size;
+    };
+
+    ClientTransaction() :
+       m_pmsg(nullptr),
+       m_txid(0),
+       m_type(REQUEST_TYPE::CREAT),
+       m_crttm(),
+       m_deadline(),
+       m_required(0),
+       m_timeout(0),
        m_waitcnt(0),
        m_rplycnt(0),
        m_succcnt(0),
+       m_conflictcnt(0),
        m_rplyst(REPLY_STATE::INITIAL),
-       m_nodes(nodes),
-       m_replys() {
+       m_node_cnt(0),
+       m_reply_cnt(0),
+       m_data_ep(),
+       m_has_data_ep(false),
+       m_fetching(0),
+       m_version(0) {
     }
+
+    // required   -- successful replies needed to answer the client
+    // timeout_ms -- the transaction is failed if not answered in time
+    ClientTransaction(StoreMessage * pmsg,
+                      REQUEST_TYPE   tp,
+                      const std::vector<struct MemberEntry > & nodes,
+                      int            required,
+                      int            timeout_ms) :
+       ClientTransaction() {
+        init(pmsg, tp, nodes, required, timeout_ms);
+    }
+
     ~ClientTransaction() {
-        for (auto& r : m_replys) {
-            StoreClient * pclt = std::get<1>(r.second);
-            if (pclt != nullptr) {
-                delete pclt;
-            }
-        }
-        m_replys.clear();
     }
 
     ClientTransaction(const ClientTransaction& other) = delete;
@@ -77,14 +101,59 @@ public:
     ClientTransaction& operator=(const ClientTransaction& other) = delete;
     ClientTransaction& operator=(const ClientTransaction&& other) = delete;
 
+    // Start tracking a request, the transaction must be clear
+    void init(StoreMessage * pmsg,
+              REQUEST_TYPE   tp,
+              const std::vector<struct MemberEntry > & nodes,
+              int            required,
+              int            timeout_ms) {
+        m_pmsg     = pmsg;
+        m_txid     = reinterpret_cast<long long>(pmsg);
+        m_type     = tp;
+        m_crttm    = std::chrono::steady_clock::now();
+        m_deadline = m_crttm + std::chrono::milliseconds(timeout_ms);
+        m_required = required;
+        m_timeout  = timeout_ms;
+        m_node_cnt = std::min(nodes.size(), static_cast<size_t>(PLUTO_NODE_REPLICAS_NUM));
+        std::copy(nodes.begin(), nodes.begin() + m_node_cnt, m_nodes);
+    }
+
+    // Forget the request, value buffers are kept for reuse
+    void clear() {
+        m_pmsg        = nullptr;
+        m_txid        = 0;
+        m_waitcnt     = 0;
+        m_rplycnt     = 0;
+        m_succcnt     = 0;
+        m_conflictcnt = 0;
+        m_rplyst      = REPLY_STATE::INITIAL;
+        m_node_cnt    = 0;
+        m_reply_cnt   = 0;
+        m_has_data_ep = false;
+        m_fetching    = 0;
+        m_version     = 0;
+    }
+
     long long get_txid() const {
         return m_txid;
     }
 
-    std::chrono::system_clock::time_point get_creat_time() const {
+    std::chrono::steady_clock::time_point get_creat_time() const {
         return m_crttm;
     }
 
+    std::chrono::steady_clock::time_point get_deadline() const {
+        return m_deadline;
+    }
+
+    int get_required_count() const {
+        return m_required;
+    }
+
+    int get_timeout() const {
+        return m_timeout;
+    }
+
     // total_reply, success_reply
     std::tuple<int, int > get_reply_count() const {
         return std::make_tuple(m_rplycnt, m_succcnt);
@@ -94,6 +163,11 @@ public:
         return m_waitcnt;
     }
 
+    // Replicas rejected the conditional write by version mismatch
+    int get_conflict_count() const {
+        return m_conflictcnt;
+    }
+
     REQUEST_TYPE get_type() const {
         return m_type;
     }
@@ -102,15 +176,113 @@ public:
         return m_pmsg;
     }
 
-    int get_read_value(std::vector<unsigned char>& v) const {
-        // TODO: check if read data is same or not
-        std::map<boost::asio::ip::tcp::endpoint, NODE_TYPE >::const_iterator it =
-            m_replys.begin();
-        if (it != m_replys.end()) {
-            v = std::get<3>(it->second);
-            return 0;
+    // Version of the value written by create/update, time of a delete
+    void set_version(uint64 version) {
+        m_version = version;
+    }
+
+    uint64 get_version() const {
+        return m_version;
+    }
+
+    // Replica type asked of the node, -1 if the node is not asked
+    int get_replica_type(const boost::asio::ip::tcp::endpoint& ep) const {
+        const NodeReply * r = find_reply(ep);
+        if (r == nullptr) {
+            return -1;
         }
-        return -1;
+        return r->replica_type;
+    }
+
+    // Value of the newest successful reply
+    int get_read_value(ValueView& v, uint64& version) const {
+        const NodeReply * r = get_newest_value_reply();
+        if (r == nullptr) {
+            return -1;
+        }
+        v.data  = r->value.data();
+        v.size  = r->value.size();
+        version = r->version;
+        return 0;
+    }
+
+    // Replica asked for the value by a digest read, others reply digests
+    void set_data_node(const boost::asio::ip::tcp::endpoint& ep) {
+        m_data_ep     = ep;
+        m_has_data_ep = true;
+    }
+
+    bool has_data_node() const {
+        return m_has_data_ep;
+    }
+
+    // Still waiting for the replica asked for the value
+    bool is_data_pending() const {
+        if (!m_has_data_ep) {
+            return false;
+        }
+        const NodeReply * r = find_reply(m_data_ep);
+        return (r != nullptr) && (r->state == REPLY_STATE::WAITING);
+    }
+
+    // The newest version replied is held by a reply carrying the value
+    bool has_newest_value() const {
+        return get_newest_value_reply() != nullptr;
+    }
+
+    // Replica to fetch the value from when the digests mismatch, false if
+    // the replica with newest version has been fetched already
+    bool get_fetch_node(boost::asio::ip::tcp::endpoint& ep, int& replica_type) const {
+        const NodeReply * pnewest = get_newest_reply();
+        if (pnewest == nullptr) {
+            return false;
+        }
+        for (size_t i=0; i<m_reply_cnt; i++) {
+            const NodeReply & r = m_replys[i];
+            if (is_same_value(r, *pnewest) && !r.fetched) {
+                ep           = r.ep;
+                replica_type = r.replica_type;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start_fetch(const boost::asio::ip::tcp::endpoint& ep) {
+        NodeReply * r = find_reply(ep);
+        if (r == nullptr) {
+            return;
+        }
+        r->fetched = true;
+        m_waitcnt++;
+        m_fetching++;
+    }
+
+    bool is_fetching() const {
+        return m_fetching > 0;
+    }
+
+    // Reply of a value fetch, nullptr if the call failed
+    int add_fetch_reply(const boost::asio::ip::tcp::endpoint& ep, StoreMessage* pmsg) {
+        NodeReply * r = find_reply(ep);
+        if ((r == nullptr) || !r->fetched) {
+            return -1;
+        }
+        m_fetching--;
+        m_rplycnt++;
+
+        ReadResponseMessage * presp = dynamic_cast<ReadResponseMessage*>(pmsg);
+        if ((presp == nullptr) || (presp->get_status() != MsgStatus::OK) ||
+            presp->is_digest_only()) {
+            return -1;
+        }
+        // Replica may have been updated since the digest reply
+        const std::vector<unsigned char> & val = presp->get_value();
+        r->version   = presp->get_version();
+        r->digest    = presp->get_digest();
+        r->has_value = true;
+        r->value.assign(val.begin(), val.end());
+        return 0;
     }
 
     bool is_client_response() const {
@@ -122,16 +294,84 @@ public:
         m_rplyst = REPLY_STATE::REPLYED;
     }
 
-    void start_wait_reply(const boost::asio::ip::tcp::endpoint& ep, StoreClient * pclt) {
+    // hedged -- speculative request sent as a reply is late
+    void start_wait_reply(const boost::asio::ip::tcp::endpoint& ep, int replica_type,
+                          bool hedged = false) {
+        NodeReply * pr = find_reply(ep);
+        if (pr == nullptr) {
+            if (m_reply_cnt >= PLUTO_NODE_REPLICAS_NUM) {
+                return;
+            }
+            pr = &m_replys[m_reply_cnt++];
+            pr->ep = ep;
+        }
         m_waitcnt++;
         if (m_rplyst==REPLY_STATE::INITIAL) {
             m_rplyst = REPLY_STATE::WAITING;
         }
-        m_replys[ep] = std::make_tuple(REPLY_STATE::WAITING, pclt, -1, std::vector<unsigned char>() );
+        NodeReply & r   = *pr;
+        r.state         = REPLY_STATE::WAITING;
+        r.status        = -1;
+        r.replica_type  = replica_type;
+        r.version       = 0;
+        r.digest        = 0;
+        r.has_value     = false;
+        r.fetched       = false;
+        r.answered      = false;
+        r.hedged        = hedged;
+        r.sent          = std::chrono::steady_clock::now();
+        r.value.clear();
     }
 
-    int add_reply(StoreMessage* pmsg) {
-        if (pmsg==nullptr) return -1;
+    // Request has been sent to the node
+    bool is_node_asked(const boost::asio::ip::tcp::endpoint& ep) const {
+        return find_reply(ep) != nullptr;
+    }
+
+    // Nodes not asked yet, may be used for speculative requests
+    bool has_spare_node() const {
+        return m_node_cnt > m_reply_cnt;
+    }
+
+    bool is_hedged(const boost::asio::ip::tcp::endpoint& ep) const {
+        const NodeReply * r = find_reply(ep);
+        return (r != nullptr) && r->hedged;
+    }
+
+    std::chrono::steady_clock::time_point get_sent_time(const boost::asio::ip::tcp::endpoint& ep) const {
+        const NodeReply * r = find_reply(ep);
+        if (r == nullptr) {
+            return std::chrono::steady_clock::now();
+        }
+        return r->sent;
+    }
+
+    // Replicas answered with a value older than the one read, or without the
+    // key, as (endpoint, replica type)
+    void get_stale_nodes(std::vector<std::pair<boost::asio::ip::tcp::endpoint, int> >& v) const {
+        v.clear();
+        const NodeReply * pnewest = get_newest_reply();
+        if (pnewest == nullptr) {
+            return;
+        }
+        for (size_t i=0; i<m_reply_cnt; i++) {
+            const NodeReply & r = m_replys[i];
+            if (r.answered && !is_same_value(r, *pnewest)) {
+                v.push_back(std::make_pair(r.ep, r.replica_type));
+            }
+        }
+    }
+
+    // Reply from node 'ep', nullptr if the call to the node failed
+    int add_reply(const boost::asio::ip::tcp::endpoint& ep, StoreMessage* pmsg) {
+        if (pmsg==nullptr) {
+            int rc = add_reply(ep, static_cast<int>(MsgStatus::ERROR));
+            if (rc == 0) {
+                // Call failed, state of the replica is unknown
+                find_reply(ep)->answered = false;
+            }
+            return rc;
+        }
         int status = 0;
         switch(m_type) {
         case REQUEST_TYPE::CREAT: {
@@ -151,10 +391,10 @@ public:
             }
             status = static_cast<int>(presp->get_status());
 
-            std::vector<unsigned char> val;
-            presp->get_value(val);
-            return add_reply(pmsg->get_dest_endpoint(), status,
-                             val.data(), val.size());
+            const std::vector<unsigned char> & val = presp->get_value();
+            return add_reply(ep, status, val.data(), val.size(),
+                             presp->get_version(), presp->get_digest(),
+                             !presp->is_digest_only());
         }
         case REQUEST_TYPE::UPDATE: {
             UpdateResponseMessage * presp = 
@@ -177,34 +417,51 @@ public:
         default: return -1;
         }
 
-        return add_reply(pmsg->get_dest_endpoint(), status);
+        return add_reply(ep, status);
     }
 
+    // has_value -- false for digest replies, only version and digest kept
     int add_reply(const boost::asio::ip::tcp::endpoint& ep, int status, 
-                  const unsigned char* data=nullptr, size_t sz=0) {
-        std::map<boost::asio::ip::tcp::endpoint, NODE_TYPE >::iterator it =
-             m_replys.find(ep);
-        if (it == m_replys.end()) {
+                  const unsigned char* data=nullptr, size_t sz=0,
+                  uint64 version=0, uint64 digest=0, bool has_value=true) {
+        NodeReply * r = find_reply(ep);
+        if (r == nullptr) {
             // Not found
             return -1;
         }
-        std::get<0>(it->second) = REPLY_STATE::REPLYED;
-        std::get<2>(it->second) = status;
-
-        if (m_type == REQUEST_TYPE::READ) {
-            std::get<3>(it->second).resize(sz);
-            memcpy(std::get<3>(it->second).data(), data, sz);
+        if (r->state == REPLY_STATE::REPLYED) {
+            // Duplicated
+            return -1;
+        }
+        r->state    = REPLY_STATE::REPLYED;
+        r->status   = status;
+        r->answered = true;
+
+        if ((m_type == REQUEST_TYPE::READ) && (status == 0)) {
+            r->version   = version;
+            r->digest    = digest;
+            r->has_value = has_value;
+            if (has_value) {
+                r->value.assign(data, data + sz);
+            }
         }
 
         if (status == 0) {
             // success
             m_succcnt++;
         }
+        else if (status == static_cast<int>(MsgStatus::CONFLICT)) {
+            m_conflictcnt++;
+        }
         m_rplycnt++;
         return 0;
     }
 
-    const std::vector<struct MemberEntry >& get_nodes() const {
+    size_t get_node_count() const {
+        return m_node_cnt;
+    }
+
+    const struct MemberEntry* get_nodes() const {
         return m_nodes;
     }
 
@@ -215,20 +472,163 @@ private:
         REPLYED = 2,
     };
 
-    typedef std::vector<unsigned char> RD_REPLAY;
-    typedef std::tuple<REPLY_STATE, StoreClient*, int, RD_REPLAY > NODE_TYPE;
+    struct NodeReply {
+        boost::asio::ip::tcp::endpoint ep;
+        REPLY_STATE                state;
+        int                        status;
+        int                        replica_type;
+        uint64                     version;
+        uint64                     digest;
+        bool                       has_value;
+        bool                       fetched;     // value fetched after mismatch
+        bool                       answered;    // replied by the replica
+        bool                       hedged;      // speculative request
+        std::chrono::steady_clock::time_point sent;
+        std::vector<unsigned char> value;
+    };
+
+    NodeReply * find_reply(const boost::asio::ip::tcp::endpoint& ep) {
+        for (size_t i=0; i<m_reply_cnt; i++) {
+            if (m_replys[i].ep == ep) {
+                return &m_replys[i];
+            }
+        }
+        return nullptr;
+    }
+
+    const NodeReply * find_reply(const boost::asio::ip::tcp::endpoint& ep) const {
+        return const_cast<ClientTransaction*>(this)->find_reply(ep);
+    }
+
+    static bool is_same_value(const NodeReply& a, const NodeReply& b) {
+        return (a.state == REPLY_STATE::REPLYED) && (a.status == 0) &&
+               (a.version == b.version) && (a.digest == b.digest);
+    }
+
+    // Successful reply with the highest version, digest breaks the tie
+    const NodeReply * get_newest_reply() const {
+        const NodeReply * pnewest = nullptr;
+        for (size_t i=0; i<m_reply_cnt; i++) {
+            const NodeReply & r = m_replys[i];
+            if ((r.state != REPLY_STATE::REPLYED) || (r.status != 0)) {
+                continue;
+            }
+            if ((pnewest == nullptr) ||
+                (std::make_pair(r.version, r.digest) >
+                 std::make_pair(pnewest->version, pnewest->digest))) {
+                pnewest = &r;
+            }
+        }
+        return pnewest;
+    }
+
+    // Reply carrying the value of the newest version
+    const NodeReply * get_newest_value_reply() const {
+        const NodeReply * pnewest = get_newest_reply();
+        if (pnewest == nullptr) {
+            return nullptr;
+        }
+        for (size_t i=0; i<m_reply_cnt; i++) {
+            const NodeReply & r = m_replys[i];
+            if (is_same_value(r, *pnewest) && r.has_value) {
+                return &r;
+            }
+        }
+        return nullptr;
+    }
 
 private:
     StoreMessage* m_pmsg;
     long long    m_txid;
     REQUEST_TYPE m_type;
-    std::chrono::system_clock::time_point m_crttm;
+    std::chrono::steady_clock::time_point m_crttm;
+    std::chrono::steady_clock::time_point m_deadline;
+    int          m_required;
+    int          m_timeout;
     int          m_waitcnt;
     int          m_rplycnt;
     int          m_succcnt;
+    int          m_conflictcnt;
     REPLY_STATE  m_rplyst;
-    std::vector<struct MemberEntry > m_nodes;
-    std::map<boost::asio::ip::tcp::endpoint, NODE_TYPE > m_replys;
+
+    struct MemberEntry m_nodes[PLUTO_NODE_REPLICAS_NUM];
+    size_t       m_node_cnt;
+    NodeReply    m_replys[PLUTO_NODE_REPLICAS_NUM];
+    size_t       m_reply_cnt;
+
+    boost::asio::ip::tcp::endpoint m_data_ep;
+    bool         m_has_data_ep;
+    int          m_fetching;
+
+    uint64       m_version;
+};
+
+/**
+ * Free list of transactions, the transactions released are reused by
+ * following requests. Thread safe.
+ */
+class ClientTransactionPool {
+public:
+    // max_free -- transactions kept in the free list at most
+    explicit ClientTransactionPool(size_t max_free = KV_TRAN_POOL_DEF_SIZE) :
+       m_mtx(),
+       m_free(),
+       m_max_free(max_free) {
+    }
+
+    ~ClientTransactionPool() {
+        for (auto&& p : m_free) {
+            delete p;
+        }
+        m_free.clear();
+    }
+
+    ClientTransactionPool(const ClientTransactionPool& other) = delete;
+    ClientTransactionPool& operator=(const ClientTransactionPool& other) = delete;
+
+    ClientTransaction* acquire(StoreMessage * pmsg,
+                               ClientTransaction::REQUEST_TYPE tp,
+                               const std::vector<struct MemberEntry > & nodes,
+                               int required,
+                               int timeout_ms) {
+        ClientTransaction * p = nullptr;
+        {
+            std::lock_guard<std::mutex > lock(m_mtx);
+            if (!m_free.empty()) {
+                p = m_free.back();
+                m_free.pop_back();
+            }
+        }
+        if (p == nullptr) {
+            p = new ClientTransaction();
+        }
+        p->init(pmsg, tp, nodes, required, timeout_ms);
+        return p;
+    }
+
+    void release(ClientTransaction* p) {
+        if (p == nullptr) {
+            return;
+        }
+        p->clear();
+        {
+            std::lock_guard<std::mutex > lock(m_mtx);
+            if (m_free.size() < m_max_free) {
+                m_free.push_back(p);
+                return;
+            }
+        }
+        delete p;
+    }
+
+    size_t get_free_count() const {
+        std::lock_guard<std::mutex > lock(m_mtx);
+        return m_free.size();
+    }
+private:
+    mutable std::mutex               m_mtx;
+    std::vector<ClientTransaction* > m_free;
+    size_t                           m_max_free;
 };
 
 /*
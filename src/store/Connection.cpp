@@ -23,6 +23,8 @@
 #include <boost/asio.hpp>
 #include "Connection.h"
 #include "ConnectionManager.h"
+#include "StoreStats.h"
+#include "AdmissionController.h"
 
 using namespace boost::asio;
 using namespace std;
@@ -45,14 +47,18 @@ Connection::Connection(ip::tcp::socket sock,
                        StoreMessageHandler& handler,
                        StoreMessageFactory & fact) :
    m_strand(io),
-   m_socket(io),
+   m_socket(std::move(sock)),
+   m_remote(),
    m_conn_mgr(conn_mgr),
    m_handler(handler),
    m_fact(fact),
    m_buffer(),
-   m_rcv_buf()
+   m_rcv_buf(),
+   m_write_queue(),
+   m_stopped(false)
 {
-
+    boost::system::error_code ec;
+    m_remote = m_socket.remote_endpoint(ec);
 }
  
 void Connection::start()
@@ -62,8 +68,20 @@ void Connection::start()
 
 void Connection::stop()
 {
-    // TODO: close is not dispatched by strand, is it valid???
-    m_socket.close();
+    auto self(shared_from_this());
+    m_strand.dispatch([this, self]() {
+        if (m_stopped) {
+            return;
+        }
+        m_stopped = true;
+
+        // Pending read/write complete with error, the write handler releases
+        // the messages queued
+        boost::system::error_code ec;
+        m_socket.close(ec);
+
+        m_handler.handle_connection_close(this);
+    });
 }
 
 void Connection::do_read()
@@ -76,15 +94,28 @@ void Connection::do_read()
     m_socket.async_read_some(buffer(m_buffer), m_strand.wrap(
         [this, self](boost::system::error_code ec, size_t bytes_read) 
         {
-            if (!ec && bytes_read > 0) {
+            if (ec || bytes_read == 0) {
+                // Peer closed or read failed
+                if (!m_stopped) {
+                    m_conn_mgr.stop(self);
+                }
+                return;
+            }
+
+            copy(m_buffer.data(), m_buffer.data()+bytes_read, back_inserter(m_rcv_buf)); 
+
+            // One read may carry several messages, extract all of them
+            size_t consumed = 0;
+            while (consumed < m_rcv_buf.size()) {
                 boost::tribool result;
                 StoreMessage * pmsg;
-               
-                copy(m_buffer.data(), m_buffer.data()+bytes_read, back_inserter(m_rcv_buf)); 
-                tie(result, pmsg) = m_fact.extract(m_rcv_buf.data(), m_rcv_buf.size());
+
+                tie(result, pmsg) = m_fact.extract(m_rcv_buf.data() + consumed,
+                                                   m_rcv_buf.size() - consumed);
                 if (result) {
-                    pmsg->set_source(m_socket.remote_endpoint().address(),
-                                     m_socket.remote_endpoint().port());
+                    consumed += pmsg->get_size();
+
+                    pmsg->set_source(m_remote.address(), m_remote.port());
                     // TODO: pmsg holds pointer to connection, be carefully for error handling
                     pmsg->set_connection(self);
 
@@ -94,18 +125,37 @@ void Connection::do_read()
                     }
                     getlog()->sendlog(LogLevel::DEBUG, "Store recevied message end\n");
 
+                    if (pmsg->is_expired()) {
+                        // Sender has given up, don't spend capacity on it
+                        GetStoreStats()->incr(StatCounter::EXPIRED);
+                        delete pmsg;
+                        continue;
+                    }
+                    if (!GetAdmission()->admit(pmsg)) {
+                        // Reject fast, requests admitted are still served
+                        StoreMessage * presp = AdmissionController::construct_busy_resp(pmsg);
+                        if (presp != nullptr) {
+                            do_write(presp);
+                        }
+                        delete pmsg;
+                        continue;
+                    }
                     m_handler.handle_message(pmsg);
                 }
                 else if (!result) {
                     // here we got error, stop myself, connection manager will erase the pointer to myself
                     // after that, no pointer pointed to this, it will be deleted
                     m_conn_mgr.stop(self);
+                    return;
                 }
                 else {
-                    // indeterminate state
-                    do_read();
+                    // indeterminate state, wait for more bytes
+                    break;
                 }
             }
+            m_rcv_buf.erase(m_rcv_buf.begin(), m_rcv_buf.begin() + consumed);
+
+            do_read();
         }));
 }
 
@@ -113,20 +163,56 @@ void Connection::do_write(StoreMessage * pmsg, bool del_msg)
 {
     if (pmsg == nullptr) return;
 
+    // Writers run in different threads, queue the message so that only one
+    // async_write is outstanding on the socket
     auto self(shared_from_this());
-    boost::asio::async_write(m_socket, buffer(pmsg->get_raw(), pmsg->get_size()), m_strand.wrap(
-        [this, self, pmsg, del_msg](boost::system::error_code ec, size_t bytes_write) 
-        {
+    m_strand.post([this, self, pmsg, del_msg]() {
+        if (m_stopped) {
             if (del_msg) {
                 delete pmsg;
             }
+            return;
+        }
+
+        m_write_queue.push_back(make_pair(pmsg, del_msg));
+        if (m_write_queue.size() == 1) {
+            write_next();
+        }
+    });
+}
+
+void Connection::write_next()
+{
+    StoreMessage * pmsg = m_write_queue.front().first;
+
+    auto self(shared_from_this());
+    boost::asio::async_write(m_socket, buffer(pmsg->get_raw(), pmsg->get_size()), m_strand.wrap(
+        [this, self](boost::system::error_code ec, size_t bytes_write) 
+        {
+            if (m_write_queue.front().second) {
+                delete m_write_queue.front().first;
+            }
+            m_write_queue.pop_front();
+
             if (ec) {
-                getlog()->sendlog(LogLevel::ERROR, "Connection '%s:%d' send failed, error=%s\n", 
-                                  m_socket.remote_endpoint().address().to_string().c_str(),
-                                  m_socket.remote_endpoint().port(),
-                                  
-                                  ec.message().c_str());
+                if (!m_stopped) {
+                    getlog()->sendlog(LogLevel::ERROR, "Connection '%s:%d' send failed, error=%s\n", 
+                                      m_remote.address().to_string().c_str(),
+                                      m_remote.port(),
+                                      ec.message().c_str());
+                }
+                for (auto&& w : m_write_queue) {
+                    if (w.second) {
+                        delete w.first;
+                    }
+                }
+                m_write_queue.clear();
                 m_conn_mgr.stop(self);
+                return;
+            }
+
+            if (!m_write_queue.empty()) {
+                write_next();
             }
         }));
 }
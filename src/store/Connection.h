@@ -17,6 +17,8 @@
  */
 
 #include <memory>
+#include <deque>
+#include <utility>
 
 #include <boost/asio.hpp>
 
@@ -59,16 +61,30 @@ public:
         return m_socket;
     }
 
+    bool is_open() const {
+        return m_socket.is_open();
+    }
+
+    // Remote endpoint cached at creation, still valid after socket closed
+    const boost::asio::ip::tcp::endpoint& remote_endpoint() const {
+        return m_remote;
+    }
+
     void do_write(StoreMessage * pmsg, bool del_msg=true);
 
 protected:
     void do_read();
 
+    // Called by strand, write the message on the head of write queue
+    void write_next();
+
 private:
     boost::asio::io_service::strand m_strand;
 
     boost::asio::ip::tcp::socket    m_socket;
 
+    boost::asio::ip::tcp::endpoint  m_remote;
+
     ConnectionManager &             m_conn_mgr;
 
     StoreMessageHandler &           m_handler;
@@ -78,6 +94,11 @@ private:
     std::array<unsigned char, MAX_RCV_BUF_LEN > m_buffer;
 
     std::vector<unsigned char>      m_rcv_buf;
+
+    // Messages waiting for write, only one async_write is outstanding
+    std::deque<std::pair<StoreMessage*, bool> > m_write_queue;
+
+    bool                            m_stopped;
 };
 
 typedef std::shared_ptr< Connection > Connection_ptr;
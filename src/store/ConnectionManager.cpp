@@ -38,17 +38,29 @@ using namespace std;
  *******************************************************************************
  */
 
-ConnectionManager::ConnectionManager(io_service& io) :
+ConnectionManager::ConnectionManager(io_service& io,
+                                     ConfigPortal * pcfg) :
+   m_io(io),
+   m_pconfig(pcfg),
    m_strand(io),
-   m_conn_map()
+   m_conn_map(),
+   m_chn_mtx(),
+   m_channels(),
+   m_push_handler()
 {
 
 }
 
+ConnectionManager::~ConnectionManager()
+{
+    std::lock_guard<std::mutex > lock(m_chn_mtx);
+    m_channels.clear();
+}
+
 void ConnectionManager::start(Connection_ptr conn)
 {
     m_strand.post([this, conn](){
-                     m_conn_map.insert(make_pair(conn->socket().remote_endpoint(), conn));
+                     m_conn_map.insert(make_pair(conn->remote_endpoint(), conn));
                      // conn->start() suppose to start an asynchronous operation
                      // so that other threads has a chance to run concurrently
                      conn->start();
@@ -59,7 +71,7 @@ void ConnectionManager::stop(Connection_ptr conn)
 {
     m_strand.post([this, conn](){
                      conn->stop();
-                     m_conn_map.erase(conn->socket().remote_endpoint());
+                     m_conn_map.erase(conn->remote_endpoint());
                   });
 }
 
@@ -93,6 +105,51 @@ void ConnectionManager::send_message(const boost::asio::ip::tcp::endpoint& endpo
                   });
 }
 
+PeerChannel_ptr ConnectionManager::get_channel(const ip::tcp::endpoint& ep)
+{
+    std::lock_guard<std::mutex > lock(m_chn_mtx);
+    PeerChannel_ptr & pchn = m_channels[ep];
+    if (pchn.get() == nullptr) {
+        pchn = make_shared<PeerChannel >(m_io, ep, m_pconfig, m_push_handler);
+    }
+    return pchn;
+}
+
+void ConnectionManager::warmup_channels(const vector<ip::tcp::endpoint >& peers)
+{
+    vector<PeerChannel_ptr > gone;
+    vector<PeerChannel_ptr > open;
+    {
+        std::lock_guard<std::mutex > lock(m_chn_mtx);
+        // Nodes left the ring
+        for (CHANNEL_MAP::iterator it = m_channels.begin(); it != m_channels.end(); ) {
+            if (find(peers.begin(), peers.end(), it->first) == peers.end()) {
+                gone.push_back(it->second);
+                it = m_channels.erase(it);
+            }
+            else {
+                it++;
+            }
+        }
+
+        for (auto&& ep : peers) {
+            PeerChannel_ptr & pchn = m_channels[ep];
+            if (pchn.get() == nullptr) {
+                pchn = make_shared<PeerChannel >(m_io, ep, m_pconfig, m_push_handler);
+            }
+            open.push_back(pchn);
+        }
+    }
+
+    for (auto&& c : gone) {
+        c->close();
+    }
+    // No-op for channels already open
+    for (auto&& c : open) {
+        c->connect();
+    }
+}
+
 /*
  *******************************************************************************
  *  Inline functions                                                           *
@@ -18,6 +18,8 @@
 
 #include <memory>
 #include <map>
+#include <vector>
+#include <mutex>
 
 #include <boost/asio.hpp>
 
@@ -25,6 +27,7 @@
 #include "StoreMessage.h"
 
 #include "Connection.h"
+#include "PeerChannel.h"
 
 /*
  *******************************************************************************
@@ -40,7 +43,9 @@
 
 class ConnectionManager {
 public:
-    explicit ConnectionManager(boost::asio::io_service & io);
+    ConnectionManager(boost::asio::io_service & io,
+                      ConfigPortal * pcfg = nullptr);
+    ~ConnectionManager();
 
     void start(Connection_ptr conn);
 
@@ -51,14 +56,39 @@ public:
     void send_message(const boost::asio::ip::tcp::endpoint& endpoint, 
                       StoreMessage * pmsg,
                       bool del_msg=true);
+
+    // Outgoing channels to peer nodes, one per peer shared by all requests.
+    // Following functions are thread safe.
+
+    // Channel to the peer, created if not exist
+    PeerChannel_ptr get_channel(const boost::asio::ip::tcp::endpoint& ep);
+    // Must be called before server runs, messages pushed by peers over the
+    // channels go to 'handler'
+    void set_push_handler(PeerChannel::PUSH_HANDLER handler) {
+        m_push_handler = handler;
+    }
+    // Open channels in advance to peers of the ring, channels of nodes not
+    // in 'peers' are closed
+    void warmup_channels(const std::vector<boost::asio::ip::tcp::endpoint >& peers);
 private:
     typedef std::map< boost::asio::ip::tcp::endpoint, Connection_ptr > 
             CM_MAP;
+
+    typedef std::map< boost::asio::ip::tcp::endpoint, PeerChannel_ptr >
+            CHANNEL_MAP;
 private:
+    boost::asio::io_service &       m_io;
+    ConfigPortal *                  m_pconfig;
+
     // User strand to protect m_conn_map
     boost::asio::io_service::strand m_strand;
 
     CM_MAP                          m_conn_map;
+
+    // Channels are accessed by handlers in different strands
+    std::mutex                      m_chn_mtx;
+    CHANNEL_MAP                     m_channels;
+    PeerChannel::PUSH_HANDLER       m_push_handler;
 };
 
 
@@ -0,0 +1,152 @@
+/**
+ *******************************************************************************
+ * FairScheduler.cpp                                                           *
+ *                                                                             *
+ * Fair scheduler:                                                             *
+ *   - Weighted fair queuing (deficit round robin) of client requests between  *
+ *     tenants, with per tenant in-flight caps                                 *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "FairScheduler.h"
+#include "StoreMessage.h"
+#include "config.h"
+
+using namespace std;
+using namespace boost::asio;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+FairScheduler::FairScheduler(io_service& io,
+                             ConfigPortal * pcfg,
+                             DISPATCHER dispatcher) :
+   m_strand(io),
+   m_pconfig(pcfg),
+   m_dispatcher(dispatcher),
+   m_max_inflight(max(pcfg->get_sched_inflight(), 0)),
+   m_inflight(0),
+   m_tenants(),
+   m_active()
+{
+}
+
+FairScheduler::~FairScheduler()
+{
+    for (auto&& t : m_tenants) {
+        for (auto&& p : t.second.requests) {
+            delete p;
+        }
+    }
+}
+
+void FairScheduler::submit(StoreMessage * pmsg)
+{
+    if (m_max_inflight == 0) {
+        m_dispatcher(pmsg);
+        return;
+    }
+
+    m_strand.post([this, pmsg]() {
+        int32 tenant = pmsg->get_tenant();
+        TenantQueue & q = get_tenant(tenant);
+        q.requests.push_back(pmsg);
+        activate(tenant, q);
+        dispatch();
+    });
+}
+
+void FairScheduler::complete(int32 tenant)
+{
+    if (m_max_inflight == 0) {
+        return;
+    }
+
+    m_strand.post([this, tenant]() {
+        TenantQueue & q = get_tenant(tenant);
+        if (q.inflight > 0) {
+            q.inflight--;
+            m_inflight--;
+        }
+        activate(tenant, q);
+        dispatch();
+    });
+}
+
+FairScheduler::TenantQueue& FairScheduler::get_tenant(int32 tenant)
+{
+    map<int32, TenantQueue >::iterator it = m_tenants.find(tenant);
+    if (it == m_tenants.end()) {
+        it = m_tenants.insert(make_pair(tenant, TenantQueue())).first;
+        it->second.weight       = max(m_pconfig->get_tenant_weight(tenant), 1);
+        it->second.max_inflight = max(m_pconfig->get_tenant_inflight(tenant), 0);
+    }
+    return it->second;
+}
+
+bool FairScheduler::is_capped(const TenantQueue& q) const
+{
+    return (q.max_inflight > 0) && (q.inflight >= q.max_inflight);
+}
+
+void FairScheduler::activate(int32 tenant, TenantQueue& q)
+{
+    if (!q.active && !q.requests.empty() && !is_capped(q)) {
+        q.active = true;
+        m_active.push_back(tenant);
+    }
+}
+
+void FairScheduler::dispatch()
+{
+    while ((m_inflight < m_max_inflight) && !m_active.empty()) {
+        int32 tenant = m_active.front();
+        TenantQueue & q = m_tenants[tenant];
+
+        if (q.requests.empty() || is_capped(q)) {
+            // Idle tenant doesn't save credit for later
+            q.deficit  = 0;
+            q.visiting = false;
+            q.active   = false;
+            m_active.pop_front();
+            continue;
+        }
+
+        if (!q.visiting) {
+            q.visiting = true;
+            q.deficit += q.weight;
+        }
+        if (q.deficit <= 0) {
+            // Quantum used up, next tenant
+            q.visiting = false;
+            m_active.splice(m_active.end(), m_active, m_active.begin());
+            continue;
+        }
+
+        StoreMessage * pmsg = q.requests.front();
+        q.requests.pop_front();
+        q.deficit--;
+        q.inflight++;
+        m_inflight++;
+        m_dispatcher(pmsg);
+    }
+}
+
+/* eof */
@@ -0,0 +1,101 @@
+/**
+ *******************************************************************************
+ * FairScheduler.h                                                             *
+ *                                                                             *
+ * Fair scheduler:                                                             *
+ *   - Weighted fair queuing (deficit round robin) of client requests between  *
+ *     tenants, with per tenant in-flight caps                                 *
+ *******************************************************************************
+ */
+
+#ifndef _FAIR_SCHEDULER_H_
+#define _FAIR_SCHEDULER_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <map>
+#include <list>
+#include <deque>
+#include <functional>
+
+#include <boost/asio.hpp>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+class StoreMessage;
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * Requests are dispatched while the requests in flight are below the limit
+ * of the node, the others wait in the queue of their tenant. Each round a
+ * tenant may dispatch as many requests as its weight; a tenant reaching its
+ * own in-flight cap sits out until one of its requests completes.
+ */
+class FairScheduler {
+public:
+    // Called by scheduler strand to run the request
+    typedef std::function<void(StoreMessage*)> DISPATCHER;
+
+    FairScheduler(boost::asio::io_service& io,
+                  ConfigPortal * pcfg,
+                  DISPATCHER dispatcher);
+    ~FairScheduler();
+
+    // Scheduler takes ownership of 'pmsg' and hands it to the dispatcher
+    void submit(StoreMessage * pmsg);
+    // A request of 'tenant' dispatched is complete
+    void complete(int32 tenant);
+private:
+    struct TenantQueue {
+        TenantQueue() : requests(), weight(1), max_inflight(0),
+                        inflight(0), deficit(0), visiting(false),
+                        active(false) {
+        }
+
+        std::deque<StoreMessage* > requests;
+        int      weight;
+        size_t   max_inflight;   // 0 is no cap
+        size_t   inflight;
+        int64    deficit;
+        bool     visiting;       // quantum of this round added
+        bool     active;         // in round robin list
+    };
+private:
+    // Following functions are called by scheduler strand!!!
+    TenantQueue& get_tenant(int32 tenant);
+    bool is_capped(const TenantQueue& q) const;
+    void activate(int32 tenant, TenantQueue& q);
+    void dispatch();
+private:
+    boost::asio::io_service::strand m_strand;
+    ConfigPortal *                  m_pconfig;
+    DISPATCHER                      m_dispatcher;
+
+    size_t                          m_max_inflight;   // 0 disables queuing
+    size_t                          m_inflight;
+
+    std::map<int32, TenantQueue >   m_tenants;
+    std::list<int32 >               m_active;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _FAIR_SCHEDULER_H_
+
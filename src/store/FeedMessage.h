@@ -0,0 +1,386 @@
+/**
+ *******************************************************************************
+ * FeedMessage.h                                                               *
+ *                                                                             *
+ * Change feed subscription request/response message                           *
+ *******************************************************************************
+ */
+
+#ifndef _FEED_MSG_COMMON_H_
+#define _FEED_MSG_COMMON_H_
+
+/**
+ *******************************************************************************
+ * Headers                                                                     *
+ *******************************************************************************
+ */
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "stdinclude.h"
+#include "StoreMessage.h"
+#include "ChangeFeed.h"
+#include "plexcept.h"
+
+/**
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/**
+ *******************************************************************************
+ * Class declaraction                                                          *
+ *******************************************************************************
+ */
+
+/**
+ * Subscribe to the change feed of the node, records are streamed back over the
+ * connection by FeedResponseMessage until the connection is closed.
+ * A new subscription on the same connection replaces the previous one.
+ */
+class FeedRequestMessage : public StoreMessage {
+public:
+    FeedRequestMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       StoreMessage(buf, sz, managebuf),
+       m_start_seq(0),
+       m_max_batch(0) {
+    };
+
+    FeedRequestMessage(MessageOriginator originator,
+                       int64 txid) :
+       StoreMessage(MsgType::FEEDREQ, originator, txid),
+       m_start_seq(0),
+       m_max_batch(0) {
+    }
+
+    ~FeedRequestMessage() {
+    }
+
+    // 0 - start from the oldest record retained
+    void set_start_seq(uint64 seq) {
+        m_start_seq = seq;
+    }
+
+    uint64 get_start_seq() const {
+        return m_start_seq;
+    }
+
+    // 0 - use server default
+    void set_max_batch(uint32 max) {
+        m_max_batch = max;
+    }
+
+    uint32 get_max_batch() const {
+        return m_max_batch;
+    }
+
+    int build_storemsg_body(unsigned char* buf, size_t sz) {
+        /**
+         * Format:
+         *  int64 -- start sequence
+         *  int32 -- maximum records per response
+         *  int32 -- reserved
+         */
+        if (buf == nullptr) {
+            getlog()->sendlog(LogLevel::ERROR, "Feed request message, build body nullptr received\n");
+            return -1;
+        }
+
+        if (sz < get_storemsg_bodysize()) {
+            getlog()->sendlog(LogLevel::ERROR, "Feed request message, build body no enough buffer, size=%d, required %d\n",
+                                                sz, get_storemsg_bodysize());
+            return -1;
+        }
+
+        network_write_int64(buf, m_start_seq);
+        buf += sizeof(int64);
+
+        int32 ival = htonl(m_max_batch);
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = 0;
+        memcpy(buf, &ival, sizeof(int32));
+
+        return 0;
+    }
+
+    void parse_storemsg_body(const unsigned char* buf, const size_t sz)
+       throw (parse_error) {
+        if (buf == nullptr) {
+            throw parse_error("FeedRequestMessage: parse got null ptr!");
+        }
+
+        if (sz < get_storemsg_bodysize()) {
+            throw parse_error("FeedRequestMessage: invalid length expected: " + std::to_string(get_storemsg_bodysize()));
+        }
+
+        m_start_seq = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        int32 ival;
+        memcpy(&ival, buf, sizeof(int32));
+        m_max_batch = ntohl(ival);
+
+        // No need to read reserved
+    }
+
+    size_t get_storemsg_bodysize() const {
+        return sizeof(int64) + 2*sizeof(int32);
+    }
+
+    void dump_storemsg_body(int (*output)(const char*, ...)=printf,
+                            bool verbose=false) const {
+        output("Start sequence: '%llu'\n", m_start_seq);
+        output("Max batch     : '%u'\n", m_max_batch);
+    }
+private:
+    uint64 m_start_seq;
+    uint32 m_max_batch;
+};
+
+class FeedResponseMessage : public StoreMessage {
+public:
+    FeedResponseMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       StoreMessage(buf, sz, managebuf),
+       m_status(MsgStatus::OK),
+       m_next_seq(0),
+       m_records() {
+    }
+
+    FeedResponseMessage(MessageOriginator originator,
+                        int64 txid,
+                        MsgStatus status) :
+       StoreMessage(MsgType::FEEDRESP, originator, txid),
+       m_status(status),
+       m_next_seq(0),
+       m_records() {
+    }
+
+    ~FeedResponseMessage() {
+    }
+
+    void set_status(MsgStatus status) {
+        m_status = status;
+    }
+
+    MsgStatus get_status() const {
+        return m_status;
+    }
+
+    // Sequence to resume from, if status is ERROR the records requested were
+    // overwritten and it is the oldest sequence retained
+    void set_next_seq(uint64 seq) {
+        m_next_seq = seq;
+    }
+
+    uint64 get_next_seq() const {
+        return m_next_seq;
+    }
+
+    void set_records(std::vector<ChangeRecord>& v) {
+        m_records.swap(v);
+    }
+
+    const std::vector<ChangeRecord>& get_records() const {
+        return m_records;
+    }
+
+    int build_storemsg_body(unsigned char* buf, size_t sz) {
+        /**
+         * Format:
+         *  int32 -- status
+         *  int32 -- number of records
+         *  int64 -- next sequence
+         *  records:
+         *    int64 -- sequence
+         *    int32 -- operation
+         *    int32 -- replica type
+         *    int64 -- key size
+         *    int64 -- value size
+         *    unsigned char array -- key
+         *    unsigned char array -- value
+         *    pad to 4 bytes
+         */
+        if (buf == nullptr) {
+            getlog()->sendlog(LogLevel::ERROR, "Feed response message, build body nullptr received\n");
+            return -1;
+        }
+
+        if (sz < get_storemsg_bodysize()) {
+            getlog()->sendlog(LogLevel::ERROR, "Feed response message, build body no enough buffer, size=%d, required %d\n",
+                                                sz, get_storemsg_bodysize());
+            return -1;
+        }
+
+        int32 ival = htonl(static_cast<int32>(m_status));
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = htonl(static_cast<int32>(m_records.size()));
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        network_write_int64(buf, m_next_seq);
+        buf += sizeof(int64);
+
+        for (auto&& r : m_records) {
+            network_write_int64(buf, r.seq);
+            buf += sizeof(int64);
+
+            ival = htonl(static_cast<int32>(r.op));
+            memcpy(buf, &ival, sizeof(int32));
+            buf += sizeof(int32);
+
+            ival = htonl(r.replica_type);
+            memcpy(buf, &ival, sizeof(int32));
+            buf += sizeof(int32);
+
+            network_write_int64(buf, r.key.size());
+            buf += sizeof(int64);
+
+            network_write_int64(buf, r.value.size());
+            buf += sizeof(int64);
+
+            memcpy(buf, r.key.c_str(), r.key.size());
+            buf += r.key.size();
+
+            memcpy(buf, r.value.data(), r.value.size());
+            buf += r.value.size();
+
+            size_t padlen = get_record_size(r) - get_record_hdrsize() - r.key.size() - r.value.size();
+            memset(buf, 0, padlen);
+            buf += padlen;
+        }
+
+        return 0;
+    }
+
+    void parse_storemsg_body(const unsigned char* buf, const size_t sz)
+       throw (parse_error) {
+        if (buf == nullptr) {
+            throw parse_error("FeedResponseMessage: parse got null ptr!");
+        }
+
+        size_t hdrsz = 2*sizeof(int32) + sizeof(int64);
+        if (sz < hdrsz) {
+            throw parse_error("FeedResponseMessage: invalid length expected: " + std::to_string(hdrsz));
+        }
+
+        int32 ival;
+        memcpy(&ival, buf, sizeof(int32));
+        ival = ntohl(ival);
+        buf += sizeof(int32);
+
+        int hi, low;
+        low = static_cast<int>(MsgStatus::PLUTO_FIRST);
+        hi  = static_cast<int>(MsgStatus::PLUTO_LAST);
+        if (ival<low || ival>=hi) {
+            throw parse_error("FeedResponseMessage: invalid status message");
+        }
+        m_status = static_cast<MsgStatus>(ival);
+
+        memcpy(&ival, buf, sizeof(int32));
+        int32 count = ntohl(ival);
+        buf += sizeof(int32);
+
+        m_next_seq = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        size_t left = sz - hdrsz;
+        m_records.clear();
+        for (int32 i=0; i<count; i++) {
+            if (left < get_record_hdrsize()) {
+                throw parse_error("FeedResponseMessage: in-complete record header");
+            }
+
+            ChangeRecord r;
+            r.moved = false;
+            r.seq = network_read_int64(buf);
+            buf += sizeof(int64);
+
+            memcpy(&ival, buf, sizeof(int32));
+            ival = ntohl(ival);
+            buf += sizeof(int32);
+
+            low = static_cast<int>(ChangeOperation::PLUTO_FIRST);
+            hi  = static_cast<int>(ChangeOperation::PLUTO_LAST);
+            if (ival<low || ival>=hi) {
+                throw parse_error("FeedResponseMessage: invalid operation " + std::to_string(ival));
+            }
+            r.op = static_cast<ChangeOperation>(ival);
+
+            memcpy(&ival, buf, sizeof(int32));
+            r.replica_type = ntohl(ival);
+            buf += sizeof(int32);
+
+            int64 keylen = network_read_int64(buf);
+            buf += sizeof(int64);
+
+            int64 vallen = network_read_int64(buf);
+            buf += sizeof(int64);
+
+            size_t recsz = (get_record_hdrsize() + keylen + vallen + 3) / 4 * 4;
+            if (left < recsz) {
+                throw parse_error("FeedResponseMessage: in-complete record, received length: " + std::to_string(sz));
+            }
+
+            r.key.assign((const char*)buf, keylen);
+            buf += keylen;
+
+            r.value.resize(vallen);
+            memcpy(r.value.data(), buf, vallen);
+            buf += vallen;
+
+            // skip padding
+            buf  += recsz - get_record_hdrsize() - keylen - vallen;
+            left -= recsz;
+
+            m_records.push_back(std::move(r));
+        }
+    }
+
+    size_t get_storemsg_bodysize() const {
+        size_t sz = 2*sizeof(int32) + sizeof(int64);
+        for (auto&& r : m_records) {
+            sz += get_record_size(r);
+        }
+        return sz;
+    }
+
+    void dump_storemsg_body(int (*output)(const char*, ...)=printf,
+                            bool verbose=false) const {
+        output("Status       : '%d'\n", m_status);
+        output("Next sequence: '%llu'\n", m_next_seq);
+        output("Records      : '%d'\n", m_records.size());
+        if (verbose) {
+            for (auto&& r : m_records) {
+                output("  %llu %s[%d] '%s'\n", r.seq, get_change_op_desc(r.op).c_str(),
+                                               r.replica_type, r.key.c_str());
+            }
+        }
+    }
+private:
+    static size_t get_record_hdrsize() {
+        return 3*sizeof(int64) + 2*sizeof(int32);
+    }
+
+    static size_t get_record_size(const ChangeRecord& r) {
+        return (get_record_hdrsize() + r.key.size() + r.value.size() + 3) / 4 * 4;
+    }
+private:
+    MsgStatus                  m_status;
+    uint64                     m_next_seq;
+    std::vector<ChangeRecord > m_records;
+};
+
+/**
+ *******************************************************************************
+ * Function declaractions                                                      *
+ *******************************************************************************
+ */
+
+#endif // _FEED_MSG_COMMON_H_
+
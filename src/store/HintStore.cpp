@@ -0,0 +1,275 @@
+/**
+ *******************************************************************************
+ * HintStore.cpp                                                               *
+ *                                                                             *
+ * Hint store:                                                                 *
+ *   - Keeps writes failed to unavailable replicas (hinted handoff)            *
+ *   - Replays them in batches when the membership shows the node is back      *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "HintStore.h"
+#include "ConnectionManager.h"
+#include "RepairMessage.h"
+#include "DeleteMessage.h"
+#include "StoreStats.h"
+#include "util.h"
+
+#include <boost/asio.hpp>
+
+using namespace std;
+using namespace boost::asio;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+HintStore::HintStore(io_service& io,
+                     ConnectionManager& mgr,
+                     ConfigPortal * pcfg) :
+   m_strand(io),
+   m_conn_mgr(mgr),
+   m_pconfig(pcfg),
+   m_nodes(),
+   m_next_seq(0),
+   m_hint_cnt(0)
+{
+}
+
+HintStore::~HintStore()
+{
+}
+
+void HintStore::add_hint(const ip::tcp::endpoint& ep, MsgType op,
+                         const string& key, int replica_type,
+                         const vector<unsigned char>& value, uint64 version,
+                         uint64 expected)
+{
+    if (m_pconfig->get_hint_max() <= 0) {
+        return;
+    }
+
+    m_strand.post([this, ep, op, key, replica_type, value, version, expected]() {
+        NodeHints & node = m_nodes[ep];
+        pair<string, int> k = make_pair(key, replica_type);
+        HINT_MAP::iterator it = node.hints.find(k);
+        if (it == node.hints.end()) {
+            if (m_hint_cnt >= static_cast<size_t>(m_pconfig->get_hint_max())) {
+                GetStoreStats()->incr(StatCounter::HINT_DROP);
+                getlog()->sendlog(LogLevel::WARNING, "Hint of '%s' to '%s:%d' dropped, store full\n",
+                                 key.c_str(), ep.address().to_string().c_str(), ep.port());
+                return;
+            }
+            it = node.hints.insert(make_pair(k, Hint())).first;
+            m_hint_cnt++;
+        }
+        else if (it->second.version > version) {
+            // Failure of an older write reported late
+            return;
+        }
+        // Older write of the key is overwritten, no need to replay it
+        Hint & h   = it->second;
+        h.seq      = ++m_next_seq;
+        h.op       = op;
+        h.value    = value;
+        h.version  = version;
+        h.expected = expected;
+        h.expire   = std::chrono::steady_clock::now() + std::chrono::seconds(m_pconfig->get_hint_ttl());
+        GetStoreStats()->incr(StatCounter::HINT);
+    });
+}
+
+void HintStore::clear_hint(const ip::tcp::endpoint& ep,
+                           const string& key, int replica_type, uint64 version)
+{
+    if (m_hint_cnt == 0) {
+        return;
+    }
+
+    m_strand.post([this, ep, key, replica_type, version]() {
+        auto nit = m_nodes.find(ep);
+        if (nit == m_nodes.end()) {
+            return;
+        }
+        NodeHints & node = nit->second;
+        HINT_MAP::iterator it = node.hints.find(make_pair(key, replica_type));
+        if ((it == node.hints.end()) || (it->second.op != MsgType::DELETEREQ) ||
+            (it->second.version >= version)) {
+            return;
+        }
+        // A replay in flight finds the hint gone and leaves the count alone
+        node.hints.erase(it);
+        m_hint_cnt--;
+    });
+}
+
+void HintStore::handle_members(const vector<struct MemberEntry >& members)
+{
+    if (m_hint_cnt == 0) {
+        return;
+    }
+
+    m_strand.post([this, members]() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (auto it = m_nodes.begin(); it != m_nodes.end(); ) {
+            NodeHints & node = it->second;
+            expire_hints(node, now);
+            if (node.hints.empty() && (node.inflight == 0)) {
+                it = m_nodes.erase(it);
+                continue;
+            }
+
+            const struct MemberEntry * pm = nullptr;
+            for (auto&& m : members) {
+                if (ip::tcp::endpoint(rawip2address(m.af, m.address), m.portnumber) == it->first) {
+                    pm = &m;
+                    break;
+                }
+            }
+
+            if (pm == nullptr) {
+                // Left the ring, wait for it to join again
+                node.hb_known = false;
+            }
+            else if (!node.hb_known) {
+                node.hb_known  = true;
+                node.heartbeat = pm->heartbeat;
+            }
+            else if ((pm->heartbeat != node.heartbeat) && (node.inflight == 0)) {
+                node.heartbeat = pm->heartbeat;
+                node.failed    = false;
+                replay(it->first, node);
+            }
+            it++;
+        }
+    });
+}
+
+void HintStore::expire_hints(NodeHints& node, std::chrono::steady_clock::time_point now)
+{
+    for (auto it = node.hints.begin(); it != node.hints.end(); ) {
+        if (it->second.expire < now) {
+            GetStoreStats()->incr(StatCounter::HINT_DROP);
+            it = node.hints.erase(it);
+            m_hint_cnt--;
+        }
+        else {
+            it++;
+        }
+    }
+}
+
+void HintStore::replay(const ip::tcp::endpoint& ep, NodeHints& node)
+{
+    if (node.hints.empty()) {
+        return;
+    }
+
+    PeerChannel_ptr pchn = m_conn_mgr.get_channel(ep);
+    if (pchn.get() == nullptr) {
+        return;
+    }
+
+    getlog()->sendlog(LogLevel::DEBUG, "Replay hints to '%s:%d', %zu left\n",
+                     ep.address().to_string().c_str(), ep.port(), node.hints.size());
+
+    size_t batch = max(m_pconfig->get_hint_batch(), 1);
+    for (auto&& h : node.hints) {
+        if (node.inflight >= batch) {
+            break;
+        }
+
+        StoreMessage * preq = nullptr;
+        if (h.second.op == MsgType::DELETEREQ) {
+            DeleteRequestMessage * pdel = new DeleteRequestMessage(MessageOriginator::Server, 0);
+            pdel->set_key(h.first.first);
+            pdel->set_expected_version(h.second.expected);
+            preq = pdel;
+        }
+        else {
+            // Repair keeps the version on the replica if it is newer
+            RepairRequestMessage * prep = new RepairRequestMessage(MessageOriginator::Server, 0);
+            prep->set_key(h.first.first);
+            prep->set_value(h.second.value.data(), h.second.value.size());
+            prep->set_version(h.second.version);
+            preq = prep;
+        }
+        preq->set_replica_type(h.first.second);
+        preq->set_dest_endpoint(ep);
+
+        node.inflight++;
+        GetStoreStats()->incr(StatCounter::HINT_REPLAY);
+
+        pair<string, int> key = h.first;
+        uint64 seq = h.second.seq;
+        pchn->async_call(preq, m_pconfig->get_message_timeout(),
+                         [this, ep, key, seq](const ClientErrorCode& e, StoreMessage* presp) {
+                             // Any response means the node got the write, even
+                             // it is an error
+                             bool delivered = (presp != nullptr);
+                             if (presp != nullptr) {
+                                 delete presp;
+                             }
+                             m_strand.post([this, ep, key, seq, delivered]() {
+                                 handle_replay_complete(ep, key, seq, delivered);
+                             });
+                         });
+    }
+}
+
+void HintStore::handle_replay_complete(const ip::tcp::endpoint& ep,
+                                       const pair<string, int>& key,
+                                       uint64 seq, bool delivered)
+{
+    auto nit = m_nodes.find(ep);
+    if (nit == m_nodes.end()) {
+        return;
+    }
+    NodeHints & node = nit->second;
+    node.inflight--;
+
+    if (delivered) {
+        HINT_MAP::iterator it = node.hints.find(key);
+        if ((it != node.hints.end()) && (it->second.seq == seq)) {
+            node.hints.erase(it);
+            m_hint_cnt--;
+        }
+    }
+    else if (!node.failed) {
+        // Down again, wait for the heartbeat to move on
+        node.failed   = true;
+        node.hb_known = false;
+        getlog()->sendlog(LogLevel::WARNING, "Replay hints to '%s:%d' failed, %zu left\n",
+                         ep.address().to_string().c_str(), ep.port(), node.hints.size());
+    }
+
+    if (node.inflight > 0) {
+        return;
+    }
+    if (node.hints.empty()) {
+        m_nodes.erase(nit);
+        return;
+    }
+    if (!node.failed) {
+        replay(ep, node);
+    }
+}
+
+/* eof */
+
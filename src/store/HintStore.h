@@ -0,0 +1,127 @@
+/**
+ *******************************************************************************
+ * HintStore.h                                                                 *
+ *                                                                             *
+ * Hint store:                                                                 *
+ *   - Keeps writes failed to unavailable replicas (hinted handoff)            *
+ *   - Replays them in batches when the membership shows the node is back      *
+ *******************************************************************************
+ */
+
+#ifndef _HINT_STORE_H_
+#define _HINT_STORE_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+#include "messages.h"
+#include "entrytable.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+class ConnectionManager;
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * Hints live in memory of the coordinator, bounded by count and time to live.
+ * Only the latest write of a key is kept for a replica; creates and updates
+ * are replayed as repairs, which keep the newer version on the replica.
+ * Deletes carry no value to compare, a delete hint is dropped once a newer
+ * write of the key reaches the replica.
+ */
+class HintStore {
+public:
+    HintStore(boost::asio::io_service& io,
+              ConnectionManager& mgr,
+              ConfigPortal * pcfg);
+    ~HintStore();
+
+    // Write 'op' to replica 'replica_type' on node 'ep' failed. 'value' is
+    // not used by delete, 'version' of a delete is the time it was issued.
+    // 'expected' is the expected version of a conditional delete
+    void add_hint(const boost::asio::ip::tcp::endpoint& ep, MsgType op,
+                  const std::string& key, int replica_type,
+                  const std::vector<unsigned char>& value, uint64 version,
+                  uint64 expected = 0);
+
+    // Write of 'version' to replica 'replica_type' on node 'ep' succeeded,
+    // an older delete hint of the key would remove the newer value
+    void clear_hint(const boost::asio::ip::tcp::endpoint& ep,
+                    const std::string& key, int replica_type, uint64 version);
+
+    // Called with the member list of every membership period. Hints of a node
+    // are replayed once its heartbeat moves on from the one seen after it
+    // failed; expired hints are dropped
+    void handle_members(const std::vector<struct MemberEntry >& members);
+
+    size_t get_hint_count() const {
+        return m_hint_cnt;
+    }
+private:
+    struct Hint {
+        uint64                     seq;     // to tell a rewritten hint
+        MsgType                    op;
+        std::vector<unsigned char> value;
+        uint64                     version;
+        uint64                     expected; // conditional delete only
+        std::chrono::steady_clock::time_point expire;
+    };
+    // Keyed by key and replica type
+    typedef std::map<std::pair<std::string, int>, Hint > HINT_MAP;
+
+    struct NodeHints {
+        NodeHints() : hints(), hb_known(false), heartbeat(0),
+                      inflight(0), failed(false) {
+        }
+
+        HINT_MAP hints;
+        bool     hb_known;   // heartbeat seen since the node failed
+        int64    heartbeat;
+        size_t   inflight;   // hints of the batch being replayed
+        bool     failed;     // a hint of the batch failed
+    };
+private:
+    // Following functions are called by hint strand!!!
+    void expire_hints(NodeHints& node, std::chrono::steady_clock::time_point now);
+    void replay(const boost::asio::ip::tcp::endpoint& ep, NodeHints& node);
+    void handle_replay_complete(const boost::asio::ip::tcp::endpoint& ep,
+                                const std::pair<std::string, int>& key,
+                                uint64 seq, bool delivered);
+private:
+    boost::asio::io_service::strand m_strand;
+    ConnectionManager &             m_conn_mgr;
+    ConfigPortal *                  m_pconfig;
+
+    std::map<boost::asio::ip::tcp::endpoint, NodeHints > m_nodes;
+    uint64                          m_next_seq;
+    std::atomic<size_t>             m_hint_cnt;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _HINT_STORE_H_
+
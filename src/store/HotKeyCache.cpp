@@ -0,0 +1,205 @@
+/**
+ *******************************************************************************
+ * HotKeyCache.cpp                                                             *
+ *                                                                             *
+ * Hot key cache:                                                              *
+ *   - Detects heavy hitters of the read stream with a Count-Min sketch        *
+ *   - Caches values of hot keys at the coordinator for a short time to live   *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "HotKeyCache.h"
+#include "config.h"
+
+#include <algorithm>
+
+using namespace std;
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+HotKeyCache::HotKeyCache(ConfigPortal * pcfg) :
+   m_threshold(max(pcfg->get_hot_key_threshold(), 0)),
+   m_ttl(max(pcfg->get_hot_key_ttl(), 1)),
+   m_window(max(pcfg->get_hot_key_window(), 1)),
+   m_capacity(max(pcfg->get_hot_key_capacity(), 1)),
+   m_mtx(),
+   m_sketch(KV_HOT_KEY_SKETCH_DEPTH * KV_HOT_KEY_SKETCH_WIDTH, 0),
+   m_decay_tm(steady_clock::now()),
+   m_entries()
+{
+}
+
+HotKeyCache::~HotKeyCache()
+{
+}
+
+size_t HotKeyCache::get_slot(uint64 h, size_t row) const
+{
+    // Rows are indexed by h1 + row * h2 of one hash
+    uint64 h2 = ((h * 0x9E3779B97F4A7C15ULL) >> 32) | 1;
+    return row * KV_HOT_KEY_SKETCH_WIDTH + (h + row * h2) % KV_HOT_KEY_SKETCH_WIDTH;
+}
+
+uint32 HotKeyCache::estimate(uint64 h) const
+{
+    uint32 cnt = m_sketch[get_slot(h, 0)];
+    for (size_t i=1; i<KV_HOT_KEY_SKETCH_DEPTH; i++) {
+        cnt = min(cnt, m_sketch[get_slot(h, i)]);
+    }
+    return cnt;
+}
+
+bool HotKeyCache::is_hot(uint64 h) const
+{
+    return estimate(h) >= m_threshold;
+}
+
+void HotKeyCache::record(uint64 h)
+{
+    if (!is_enabled()) {
+        return;
+    }
+
+    steady_clock::time_point now = steady_clock::now();
+    std::lock_guard<std::mutex > lock(m_mtx);
+    if (now - m_decay_tm >= m_window) {
+        for (auto&& c : m_sketch) {
+            c >>= 1;
+        }
+        m_decay_tm = now;
+    }
+
+    // Conservative update: only the smallest counters grow
+    uint32 cnt = estimate(h);
+    for (size_t i=0; i<KV_HOT_KEY_SKETCH_DEPTH; i++) {
+        uint32 & c = m_sketch[get_slot(h, i)];
+        if (c == cnt) {
+            c++;
+        }
+    }
+}
+
+bool HotKeyCache::lookup(const string& key, int required,
+                         vector<unsigned char>& value, uint64& version)
+{
+    if (!is_enabled()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex > lock(m_mtx);
+    auto it = m_entries.find(key);
+    if ((it == m_entries.end()) || !it->second.valid ||
+        (it->second.required < required)) {
+        return false;
+    }
+    if (it->second.expire <= steady_clock::now()) {
+        m_entries.erase(it);
+        return false;
+    }
+    value   = it->second.value;
+    version = it->second.version;
+    return true;
+}
+
+void HotKeyCache::fill(const string& key, uint64 key_hash, int required,
+                       const unsigned char* value, size_t sz, uint64 version,
+                       TIME_POINT since)
+{
+    if (!is_enabled()) {
+        return;
+    }
+
+    steady_clock::time_point now = steady_clock::now();
+    if (since + m_ttl <= now) {
+        // Marks of writes this read may have missed are gone
+        return;
+    }
+
+    std::lock_guard<std::mutex > lock(m_mtx);
+    if (!is_hot(key_hash)) {
+        return;
+    }
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        if (m_entries.size() >= m_capacity) {
+            purge(now);
+            if (m_entries.size() >= m_capacity) {
+                return;
+            }
+        }
+        it = m_entries.insert(make_pair(key, Entry())).first;
+        it->second.written = TIME_POINT();
+    }
+    else if ((it->second.written > since) ||
+             (it->second.valid && (it->second.version > version))) {
+        return;
+    }
+
+    Entry & e = it->second;
+    e.value.assign(value, value + sz);
+    e.version  = version;
+    e.required = required;
+    e.valid    = true;
+    e.expire   = now + m_ttl;
+}
+
+void HotKeyCache::invalidate(const string& key, uint64 key_hash)
+{
+    if (!is_enabled()) {
+        return;
+    }
+
+    steady_clock::time_point now = steady_clock::now();
+    std::lock_guard<std::mutex > lock(m_mtx);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        if (!is_hot(key_hash)) {
+            // Cold key is never filled, no mark needed
+            return;
+        }
+        if (m_entries.size() >= m_capacity) {
+            purge(now);
+        }
+        it = m_entries.insert(make_pair(key, Entry())).first;
+    }
+
+    Entry & e = it->second;
+    e.value.clear();
+    e.valid   = false;
+    e.written = now;
+    e.expire  = now + m_ttl;
+}
+
+void HotKeyCache::purge(TIME_POINT now)
+{
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        if (it->second.expire <= now) {
+            it = m_entries.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+/* eof */
@@ -0,0 +1,107 @@
+/**
+ *******************************************************************************
+ * HotKeyCache.h                                                               *
+ *                                                                             *
+ * Hot key cache:                                                              *
+ *   - Detects heavy hitters of the read stream with a Count-Min sketch        *
+ *   - Caches values of hot keys at the coordinator for a short time to live   *
+ *******************************************************************************
+ */
+
+#ifndef _HOT_KEY_CACHE_H_
+#define _HOT_KEY_CACHE_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+class ConfigPortal;
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * A key is hot once its estimated reads in the sketch reach the threshold;
+ * counters are halved every window so keys cool down. Only hot keys are
+ * cached. A write of a key drops its value and keeps a mark of the write, so
+ * that a read started before the write can't put the old value back.
+ */
+class HotKeyCache {
+public:
+    typedef std::chrono::steady_clock::time_point TIME_POINT;
+
+    explicit HotKeyCache(ConfigPortal * pcfg);
+    ~HotKeyCache();
+
+    bool is_enabled() const {
+        return m_threshold > 0;
+    }
+
+    // Counts a read of the key, 'key_hash' is get_key_hash() of it
+    void record(uint64 key_hash);
+
+    // Value of 'key' cached by a read of 'required' replies at least.
+    // Returns false if there is none
+    bool lookup(const std::string& key, int required,
+                std::vector<unsigned char>& value, uint64& version);
+
+    // Value of 'key' read by a read of 'required' replies started at
+    // 'since'. Ignored if the key isn't hot or is written since
+    void fill(const std::string& key, uint64 key_hash, int required,
+              const unsigned char* value, size_t sz, uint64 version,
+              TIME_POINT since);
+
+    // 'key' is written through the coordinator
+    void invalidate(const std::string& key, uint64 key_hash);
+private:
+    struct Entry {
+        std::vector<unsigned char> value;
+        uint64                     version;
+        int                        required;
+        bool                       valid;     // false is a mark of write
+        TIME_POINT                 written;
+        TIME_POINT                 expire;
+    };
+private:
+    // Following functions are called with m_mtx locked!!!
+    size_t get_slot(uint64 h, size_t row) const;
+    uint32 estimate(uint64 h) const;
+    bool is_hot(uint64 h) const;
+    void purge(TIME_POINT now);
+private:
+    uint32                     m_threshold;   // 0 disables the cache
+    std::chrono::milliseconds  m_ttl;
+    std::chrono::milliseconds  m_window;
+    size_t                     m_capacity;
+
+    std::mutex                 m_mtx;
+    std::vector<uint32 >       m_sketch;      // depth rows of width counters
+    TIME_POINT                 m_decay_tm;
+    std::unordered_map<std::string, Entry > m_entries;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _HOT_KEY_CACHE_H_
+
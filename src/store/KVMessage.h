@@ -27,6 +27,47 @@
  *******************************************************************************
  */
 
+// Key request/response carries the digest and version of the value only
+#define PLUTO_KEY_FLAG_DIGEST   0x01
+
+/**
+ * Number of successful replica replies required before the client is
+ * answered, DEFAULT uses the configured quorum.
+ */
+enum class ConsistencyLevel : int {
+    PLUTO_FIRST = 0,
+    DEFAULT = PLUTO_FIRST,
+    ONE,
+    QUORUM,
+    ALL,
+    PLUTO_LAST
+};
+
+inline std::string get_consistency_desc(ConsistencyLevel level) {
+    switch(level) {
+    case ConsistencyLevel::DEFAULT: return "DEFAULT";
+    case ConsistencyLevel::ONE:     return "ONE";
+    case ConsistencyLevel::QUORUM:  return "QUORUM";
+    case ConsistencyLevel::ALL:     return "ALL";
+    default: return "Unknown: " + std::to_string(static_cast<int>(level));
+    }
+    return "Bad";
+}
+
+inline ConsistencyLevel parse_consistency(const unsigned char* buf) throw (parse_error) {
+    int32 ival;
+    memcpy(&ival, buf, sizeof(int32));
+    ival = ntohl(ival);
+
+    int hi, low;
+    low = static_cast<int>(ConsistencyLevel::PLUTO_FIRST);
+    hi  = static_cast<int>(ConsistencyLevel::PLUTO_LAST);
+    if (ival<low || ival>=hi) {
+        throw parse_error("Invalid consistency level " + std::to_string(ival));
+    }
+    return static_cast<ConsistencyLevel>(ival);
+}
+
 /**
  *******************************************************************************
  * Class declaraction                                                          *
@@ -37,7 +78,12 @@ class KVReqMessage : public StoreMessage {
 public:
     KVReqMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
        StoreMessage(buf, sz, managebuf),
+       m_consistency(ConsistencyLevel::DEFAULT),
+       m_timeout(0),
+       m_version(0),
+       m_expected(0),
        m_key(),
+       m_key_hash(::get_key_hash("")),
        m_value() {
     };
   
@@ -45,21 +91,68 @@ public:
                  MessageOriginator originator,
                  int64 txid) :
        StoreMessage(type, originator, txid),
+       m_consistency(ConsistencyLevel::DEFAULT),
+       m_timeout(0),
+       m_version(0),
+       m_expected(0),
        m_key(),
+       m_key_hash(::get_key_hash("")),
        m_value() {
     }
 
     virtual ~KVReqMessage() {
     }
 
+    void set_consistency(ConsistencyLevel level) {
+        m_consistency = level;
+    }
+
+    ConsistencyLevel get_consistency() const {
+        return m_consistency;
+    }
+
+    // Milliseconds, 0 - use server default
+    void set_timeout(int32 timeout) {
+        m_timeout = timeout;
+    }
+
+    int32 get_timeout() const {
+        return m_timeout;
+    }
+
+    // Version of the value assigned by the coordinator, 0 from clients
+    void set_version(uint64 version) {
+        m_version = version;
+    }
+
+    uint64 get_version() const {
+        return m_version;
+    }
+
+    // Conditional write: applied only if the replica holds this version,
+    // 0 writes unconditionally
+    void set_expected_version(uint64 version) {
+        m_expected = version;
+    }
+
+    uint64 get_expected_version() const {
+        return m_expected;
+    }
+
     void set_key(const std::string& key) {
         m_key = key;
+        m_key_hash = ::get_key_hash(m_key);
     }
 
     const std::string& get_key() const {
         return m_key;
     }
 
+    // Hash of the key, computed once when the key is set or parsed
+    uint64 get_key_hash() const {
+        return m_key_hash;
+    }
+
     void set_value(const unsigned char* val, size_t sz) {
         m_value.clear();
         if (val && sz>0) {
@@ -88,6 +181,10 @@ public:
     int build_storemsg_body(unsigned char* buf, size_t sz) {
         /**
          * Format:
+         *   int32  -- consistency level
+         *   int32  -- timeout in milliseconds
+         *   uint64 -- version
+         *   uint64 -- expected version
          *   uint64 -- key size
          *   uint64 -- value size
          *   unsigned char array -- key
@@ -105,6 +202,20 @@ public:
             return -1;
         }
 
+        int32 ival = htonl(static_cast<int32>(m_consistency));
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = htonl(m_timeout);
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        network_write_int64(buf, m_version);
+        buf += sizeof(int64);
+
+        network_write_int64(buf, m_expected);
+        buf += sizeof(int64);
+
         network_write_int64(buf, m_key.size());
         buf += sizeof(int64);
 
@@ -117,7 +228,7 @@ public:
         memcpy(buf, m_value.data(), m_value.size());
         buf += m_value.size();
 
-        size_t wrtlen = 2*sizeof(int64) + m_key.size() + m_value.size();
+        size_t wrtlen = get_hdrsize() + m_key.size() + m_value.size();
         if (get_storemsg_bodysize() > wrtlen) {
             memset(buf, 0, (get_storemsg_bodysize() - wrtlen) * sizeof(char));
         }
@@ -131,10 +242,24 @@ public:
             throw parse_error("KVReqMessage: parse got null ptr!");
         }
 
-        if (sz < 2*sizeof(int64)) {
-            throw parse_error("KVReqMessage: invalid length expected: " + std::to_string(2*sizeof(int64)));
+        if (sz < get_hdrsize()) {
+            throw parse_error("KVReqMessage: invalid length expected: " + std::to_string(get_hdrsize()));
         }
 
+        m_consistency = parse_consistency(buf);
+        buf += sizeof(int32);
+
+        int32 ival;
+        memcpy(&ival, buf, sizeof(int32));
+        m_timeout = ntohl(ival);
+        buf += sizeof(int32);
+
+        m_version = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        m_expected = network_read_int64(buf);
+        buf += sizeof(int64);
+
         int64 keylen, vallen;
         keylen = network_read_int64(buf);
         buf += sizeof(int64);
@@ -142,7 +267,7 @@ public:
         vallen = network_read_int64(buf);
         buf += sizeof(int64);
 
-        if (sz < keylen + vallen + 2*sizeof(int64)) {
+        if (sz < keylen + vallen + get_hdrsize()) {
             throw parse_error("KVReqMessage: in-complete message, received length: " + std::to_string(sz));
         }
 
@@ -150,6 +275,7 @@ public:
         buf += keylen;
 
         m_key = std::move(mstr);
+        m_key_hash = ::get_key_hash(m_key);
 
         m_value.clear();
         m_value.resize(vallen);
@@ -163,11 +289,15 @@ public:
     size_t get_storemsg_bodysize() const {
         size_t sz = m_key.size() + m_value.size();
         sz = (sz + 3) / 4 * 4;
-        return sz + 2 * sizeof(uint64);
+        return sz + get_hdrsize();
     }
 
     void dump_storemsg_body(int (*output)(const char*, ...)=printf,
                             bool verbose=false) const {
+        output("Consistency: '%s'\n", get_consistency_desc(m_consistency).c_str());
+        output("Timeout    : '%d'\n", m_timeout);
+        output("Version    : '%llu'\n", m_version);
+        output("Expected   : '%llu'\n", m_expected);
         output("Key  : '%s'\n", m_key.c_str());
         output("Value:\n");
         for (auto v : m_value) {
@@ -178,7 +308,16 @@ public:
         }
     }
 private:
+    static size_t get_hdrsize() {
+        return 2*sizeof(int32) + 4*sizeof(int64);
+    }
+private:
+    ConsistencyLevel           m_consistency;
+    int32                      m_timeout;
+    uint64                     m_version;
+    uint64                     m_expected;
     std::string                m_key;
+    uint64                     m_key_hash;
     std::vector<unsigned char> m_value;
 };
 
@@ -248,7 +387,7 @@ public:
         int hi, low;
         low = static_cast<int>(MsgStatus::PLUTO_FIRST);
         hi  = static_cast<int>(MsgStatus::PLUTO_LAST);
-        if (ival<=low || ival>hi) {
+        if (ival<low || ival>=hi) {
             throw parse_error("KVRespMessage: invalid status message");
         }
 
@@ -272,30 +411,86 @@ class KeyReqMessage : public StoreMessage {
 public:
     KeyReqMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
        StoreMessage(buf, sz, managebuf),
-       m_key() {
+       m_consistency(ConsistencyLevel::DEFAULT),
+       m_timeout(0),
+       m_flags(0),
+       m_expected(0),
+       m_key(),
+       m_key_hash(::get_key_hash("")) {
     };
   
     KeyReqMessage(MsgType type,
                   MessageOriginator originator,
                   int64 txid) :
        StoreMessage(type, originator, txid),
-       m_key() {
+       m_consistency(ConsistencyLevel::DEFAULT),
+       m_timeout(0),
+       m_flags(0),
+       m_expected(0),
+       m_key(),
+       m_key_hash(::get_key_hash("")) {
     }
 
     virtual ~KeyReqMessage() {
     }
 
+    void set_consistency(ConsistencyLevel level) {
+        m_consistency = level;
+    }
+
+    ConsistencyLevel get_consistency() const {
+        return m_consistency;
+    }
+
+    // Milliseconds, 0 - use server default
+    void set_timeout(int32 timeout) {
+        m_timeout = timeout;
+    }
+
+    int32 get_timeout() const {
+        return m_timeout;
+    }
+
+    void set_flags(int32 flags) {
+        m_flags = flags;
+    }
+
+    int32 get_flags() const {
+        return m_flags;
+    }
+
+    // Conditional delete: applied only if the replica holds this version,
+    // 0 deletes unconditionally
+    void set_expected_version(uint64 version) {
+        m_expected = version;
+    }
+
+    uint64 get_expected_version() const {
+        return m_expected;
+    }
+
     void set_key(const std::string& key) {
         m_key = key;
+        m_key_hash = ::get_key_hash(m_key);
     }
 
     const std::string& get_key() const {
         return m_key;
     }
 
+    // Hash of the key, computed once when the key is set or parsed
+    uint64 get_key_hash() const {
+        return m_key_hash;
+    }
+
     int build_storemsg_body(unsigned char* buf, size_t sz) {
         /**
          * Format:
+         *  int32 -- consistency level
+         *  int32 -- timeout in milliseconds
+         *  int32 -- flags
+         *  int32 -- reserved
+         *  int64 -- expected version
          *  int64 -- key length
          *  char array -- keys
          *  pad -- to 4 bytes
@@ -311,14 +506,34 @@ public:
             return -1;
         }
 
+        int32 ival = htonl(static_cast<int32>(m_consistency));
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = htonl(m_timeout);
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = htonl(m_flags);
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = 0;
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        network_write_int64(buf, m_expected);
+        buf += sizeof(int64);
+
         network_write_int64(buf, m_key.size());
         buf += sizeof(int64);
 
         memcpy(buf, m_key.c_str(), m_key.size());
         buf += m_key.size();
 
-        if (get_storemsg_bodysize() > sizeof(int64) + m_key.size()) {
-            memset(buf, 0, get_storemsg_bodysize() - sizeof(int64) - m_key.size());
+        size_t wrtlen = get_hdrsize() + m_key.size();
+        if (get_storemsg_bodysize() > wrtlen) {
+            memset(buf, 0, get_storemsg_bodysize() - wrtlen);
         }
         return 0;
     }
@@ -329,32 +544,64 @@ public:
             throw parse_error("KeyReqMessage: parse got null ptr!");
         }
 
-        if (sz < sizeof(int64)) {
-            throw parse_error("KeyReqMessage: invalid length expected: " + std::to_string(sizeof(int64)));
+        if (sz < get_hdrsize()) {
+            throw parse_error("KeyReqMessage: invalid length expected: " + std::to_string(get_hdrsize()));
         }
 
+        m_consistency = parse_consistency(buf);
+        buf += sizeof(int32);
+
+        int32 ival;
+        memcpy(&ival, buf, sizeof(int32));
+        m_timeout = ntohl(ival);
+        buf += sizeof(int32);
+
+        memcpy(&ival, buf, sizeof(int32));
+        m_flags = ntohl(ival);
+        buf += sizeof(int32);
+
+        // The reserved field
+        buf += sizeof(int32);
+
+        m_expected = network_read_int64(buf);
+        buf += sizeof(int64);
+
         int64 lval = network_read_int64(buf);
         buf += sizeof(int64);
 
-        if (sz < lval + sizeof(int64)) {
+        if (sz < lval + get_hdrsize()) {
             throw parse_error("KeyReqMessage: in-complete message, recevied size: " + std::to_string(sz));
         }
         std::string mstr((const char*)buf, lval);
         m_key = mstr;
+        m_key_hash = ::get_key_hash(m_key);
 
         // No need to read paddings
     }
 
     size_t get_storemsg_bodysize() const {
-        return sizeof(int64) + (m_key.size()+3)/4*4;
+        return get_hdrsize() + (m_key.size()+3)/4*4;
     }
 
     void dump_storemsg_body(int (*output)(const char*, ...)=printf,
                             bool verbose=false) const {
+        output("Consistency: '%s'\n", get_consistency_desc(m_consistency).c_str());
+        output("Timeout    : '%d'\n", m_timeout);
+        output("Flags      : '0x%x'\n", m_flags);
+        output("Expected   : '%llu'\n", m_expected);
         output("Key  : '%s'\n", m_key.c_str());
     }
 private:
-    std::string m_key;
+    static size_t get_hdrsize() {
+        return 4*sizeof(int32) + 2*sizeof(int64);
+    }
+private:
+    ConsistencyLevel m_consistency;
+    int32            m_timeout;
+    int32            m_flags;
+    uint64           m_expected;
+    std::string      m_key;
+    uint64           m_key_hash;
 };
 
 class KeyRespMessage : public StoreMessage {
@@ -362,7 +609,10 @@ public:
     KeyRespMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
        StoreMessage(buf, sz, managebuf),
        m_value(),
-       m_status(MsgStatus::OK) {
+       m_status(MsgStatus::OK),
+       m_flags(0),
+       m_version(0),
+       m_digest(0) {
     };
   
     KeyRespMessage(MsgType type,
@@ -371,7 +621,10 @@ public:
                    MsgStatus status) :
        StoreMessage(type, originator, txid),
        m_value(),
-       m_status(status) {
+       m_status(status),
+       m_flags(0),
+       m_version(0),
+       m_digest(0) {
     }
 
     virtual ~KeyRespMessage() {
@@ -402,6 +655,11 @@ public:
         val = m_value;
     }
 
+    // Value kept by the message, valid while the message lives
+    const std::vector<unsigned char>& get_value() const {
+        return m_value;
+    }
+
     void set_status(MsgStatus status) {
         m_status = status;
     }
@@ -410,11 +668,37 @@ public:
         return m_status;
     }
 
+    void set_flags(int32 flags) {
+        m_flags = flags;
+    }
+
+    int32 get_flags() const {
+        return m_flags;
+    }
+
+    void set_version(uint64 version) {
+        m_version = version;
+    }
+
+    uint64 get_version() const {
+        return m_version;
+    }
+
+    void set_digest(uint64 digest) {
+        m_digest = digest;
+    }
+
+    uint64 get_digest() const {
+        return m_digest;
+    }
+
     int build_storemsg_body(unsigned char* buf, size_t sz) {
         /**
          * Format:
          *  int32 -- status
-         *  int32 -- reserved
+         *  int32 -- flags
+         *  int64 -- version
+         *  int64 -- digest of value
          *  int64 -- value length
          *  char array -- keys
          *  pad -- to 4 bytes
@@ -434,18 +718,25 @@ public:
         memcpy(buf, &ival, sizeof(int32));
         buf += sizeof(int32);
 
-        ival = 0; 
+        ival = htonl(m_flags);
         memcpy(buf, &ival, sizeof(int32));
         buf += sizeof(int32);
 
+        network_write_int64(buf, m_version);
+        buf += sizeof(int64);
+
+        network_write_int64(buf, m_digest);
+        buf += sizeof(int64);
+
         network_write_int64(buf, m_value.size());
         buf += sizeof(int64);
 
         memcpy(buf, m_value.data(), m_value.size());
         buf += m_value.size();
 
-        if (get_storemsg_bodysize() > sizeof(int64) + m_value.size()) {
-            memset(buf, 0, get_storemsg_bodysize() - sizeof(int64) - m_value.size());
+        size_t wrtlen = get_hdrsize() + m_value.size();
+        if (get_storemsg_bodysize() > wrtlen) {
+            memset(buf, 0, get_storemsg_bodysize() - wrtlen);
         }
         return 0;
     }
@@ -456,8 +747,8 @@ public:
             throw parse_error("KeyRespMessage: parse got null ptr!");
         }
 
-        if (sz < sizeof(int64)) {
-            throw parse_error("KeyRespMessage: invalid length expected: " + std::to_string(sizeof(int64)));
+        if (sz < get_hdrsize()) {
+            throw parse_error("KeyRespMessage: invalid length expected: " + std::to_string(get_hdrsize()));
         }
 
         int32 ival;
@@ -468,19 +759,25 @@ public:
         int hi, low;
         low = static_cast<int>(MsgStatus::PLUTO_FIRST);
         hi  = static_cast<int>(MsgStatus::PLUTO_LAST);
-        if (ival<=low || ival>hi) {
+        if (ival<low || ival>=hi) {
             throw parse_error("KVRespMessage: invalid status message");
         }
         m_status = static_cast<MsgStatus>(ival);
        
-        // The reserved field 
         memcpy(&ival, buf, sizeof(int32));
+        m_flags = ntohl(ival);
         buf += sizeof(int32);
 
+        m_version = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        m_digest = network_read_int64(buf);
+        buf += sizeof(int64);
+
         int64 lval = network_read_int64(buf);
         buf += sizeof(int64);
 
-        if (sz < lval + sizeof(int64)) {
+        if (sz < lval + get_hdrsize()) {
             throw parse_error("KeyRespMessage: in-complete message, recevied size: " + std::to_string(sz));
         }
 
@@ -493,11 +790,14 @@ public:
     }
 
     size_t get_storemsg_bodysize() const {
-        return 2*sizeof(int32) + sizeof(int64) + (m_value.size()+3)/4*4;
+        return get_hdrsize() + (m_value.size()+3)/4*4;
     }
 
     void dump_storemsg_body(int (*output)(const char*, ...)=printf,
                             bool verbose=false) const {
+        output("Flags  : '0x%x'\n", m_flags);
+        output("Version: '%llu'\n", m_version);
+        output("Digest : '%016llx'\n", m_digest);
         output("Value:");
         for (auto v : m_value) {
             output("%02X", v);
@@ -506,9 +806,16 @@ public:
             dump_memory("VALUE", (const char*)m_value.data(), m_value.size(), output);
         }
     }
+private:
+    static size_t get_hdrsize() {
+        return 2*sizeof(int32) + 3*sizeof(int64);
+    }
 private:
     std::vector<unsigned char> m_value;
     MsgStatus                  m_status;
+    int32                      m_flags;
+    uint64                     m_version;
+    uint64                     m_digest;
 };
 
 /**
@@ -517,5 +824,13 @@ private:
  *******************************************************************************
  */
 
+/**
+ * Digest of the value, replicas holding the same value return the same
+ * digest whatever they are built with.
+ */
+inline uint64 get_value_digest(const unsigned char* data, size_t sz) {
+    return get_hash64(data, sz);
+}
+
 #endif // _KEY_VALUE_MSG_H_
 
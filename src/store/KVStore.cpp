@@ -30,7 +30,10 @@ using namespace std;
  *******************************************************************************
  */
 
-KVStore::KVStore() : m_storage()
+KVStore::KVStore(size_t feed_size) : 
+   m_storage(),
+   m_feed(feed_size),
+   m_listeners()
 {
     for (int i=0; i<PLUTO_NODE_REPLICAS_NUM; i++) {
         STORAGE_MAP m;
@@ -45,99 +48,245 @@ KVStore::~KVStore()
 int KVStore::do_read(const string& key, int replica_type, 
                      vector<unsigned char> & v)
 {
-    if (replica_type<0 || replica_type>PLUTO_NODE_REPLICAS_NUM) {
+    uint64 version;
+    return do_read(key, replica_type, v, version);
+}
+
+int KVStore::do_read(const string& key, int replica_type, 
+                     vector<unsigned char> & v, uint64 & version)
+{
+    if (replica_type<0 || replica_type>=PLUTO_NODE_REPLICAS_NUM) {
         getlog()->sendlog(LogLevel::ERROR, "Store: invalid replica type '%d'\n", replica_type);
         return -1;
     }
 
-    STORAGE_MAP m = m_storage[replica_type];
-    if (m.find(key) != m.end()) {
-        v = m[key];
+    STORAGE_MAP & m = m_storage[replica_type];
+    STORAGE_MAP::const_iterator it = m.find(key);
+    if (it != m.end()) {
+        v       = it->second.value;
+        version = it->second.version;
         return 0;
     }
     return -1;
 }
 
 int KVStore::do_write(const string& key, int replica_type,
-                      const vector<unsigned char> & v)
+                      const vector<unsigned char> & v,
+                      uint64 version)
 {
-    if (replica_type<0 || replica_type>PLUTO_NODE_REPLICAS_NUM) {
+    if (replica_type<0 || replica_type>=PLUTO_NODE_REPLICAS_NUM) {
         getlog()->sendlog(LogLevel::ERROR, "Store: invalid replica type '%d'\n", replica_type);
         return -1;
     }
 
-    STORAGE_MAP m = m_storage[replica_type];
+    STORAGE_MAP & m = m_storage[replica_type];
     if (m.find(key) != m.end()) {
         // duplicate
         return -1;
     }
 
-    m.insert(make_pair(key, v));
+    StoreEntry & e = m[key];
+    e.value   = v;
+    e.version = (version == 0) ? 1 : version;
+    record_change(ChangeOperation::CREAT, replica_type, key, v);
 
     return 0;
 }
 
 int KVStore::do_update(const string& key, int replica_type,
-                       const vector<unsigned char> & v)
+                       const vector<unsigned char> & v,
+                       uint64 version, uint64 expected)
 {
-    if (replica_type<0 || replica_type>PLUTO_NODE_REPLICAS_NUM) {
+    if (replica_type<0 || replica_type>=PLUTO_NODE_REPLICAS_NUM) {
         getlog()->sendlog(LogLevel::ERROR, "Store: invalid replica type '%d'\n", replica_type);
         return -1;
     }
 
-    STORAGE_MAP m = m_storage[replica_type];
-    if (m.find(key) == m.end()) {
+    STORAGE_MAP & m = m_storage[replica_type];
+    STORAGE_MAP::iterator it = m.find(key);
+    if (it == m.end()) {
+        return (expected != 0) ? PLCONFLICT : -1;
+    }
+    if ((expected != 0) && (it->second.version != expected)) {
+        return PLCONFLICT;
+    }
+
+    it->second.value   = v;
+    it->second.version = (version == 0) ? it->second.version + 1 : version;
+    record_change(ChangeOperation::UPDATE, replica_type, key, v);
+
+    return 0;
+}
+
+int KVStore::do_delete(const string& key, int replica_type, uint64 expected)
+{
+    if (replica_type<0 || replica_type>=PLUTO_NODE_REPLICAS_NUM) {
+        getlog()->sendlog(LogLevel::ERROR, "Store: invalid replica type '%d'\n", replica_type);
         return -1;
     }
 
-    m[key] = v;
+    STORAGE_MAP & m = m_storage[replica_type];
+    if (expected != 0) {
+        STORAGE_MAP::iterator it = m.find(key);
+        if ((it == m.end()) || (it->second.version != expected)) {
+            return PLCONFLICT;
+        }
+    }
+    if (m.erase(key) > 0) {
+        record_change(ChangeOperation::DELETE, replica_type, key, 
+                      vector<unsigned char>());
+    }
 
     return 0;
 }
 
-int KVStore::do_delete(const string& key, int replica_type)
+int KVStore::do_repair(const string& key, int replica_type,
+                       const vector<unsigned char> & v,
+                       uint64 version)
 {
-    if (replica_type<0 || replica_type>PLUTO_NODE_REPLICAS_NUM) {
+    if (replica_type<0 || replica_type>=PLUTO_NODE_REPLICAS_NUM) {
         getlog()->sendlog(LogLevel::ERROR, "Store: invalid replica type '%d'\n", replica_type);
         return -1;
     }
 
-    STORAGE_MAP m = m_storage[replica_type];
-    m.erase(key);
+    STORAGE_MAP & m = m_storage[replica_type];
+    STORAGE_MAP::iterator it = m.find(key);
+    if (it == m.end()) {
+        StoreEntry & e = m[key];
+        e.value   = v;
+        e.version = version;
+        record_change(ChangeOperation::CREAT, replica_type, key, v);
+    }
+    else if (it->second.version < version) {
+        it->second.value   = v;
+        it->second.version = version;
+        record_change(ChangeOperation::UPDATE, replica_type, key, v);
+    }
+    // else replica has been updated since, nothing to repair
 
     return 0;
 }
 
 int KVStore::do_delete(int replica_type)
 {
-    if (replica_type<0 || replica_type>PLUTO_NODE_REPLICAS_NUM) {
+    if (replica_type<0 || replica_type>=PLUTO_NODE_REPLICAS_NUM) {
         getlog()->sendlog(LogLevel::ERROR, "Store: invalid replica type '%d'\n", replica_type);
         return -1;
     }
 
-    STORAGE_MAP m = m_storage[replica_type];
+    STORAGE_MAP & m = m_storage[replica_type];
+    for (auto&& e : m) {
+        record_change(ChangeOperation::DELETE, replica_type, e.first,
+                      vector<unsigned char>());
+    }
     m.clear();
 
     return 0;
 }
 
+int KVStore::do_rebalance(PLACEMENT placement, size_t& moved, size_t& unowned)
+{
+    moved   = 0;
+    unowned = 0;
+
+    // Decide every key by the maps before the move, a key moved to a later
+    // map mustn't be looked at again
+    vector<pair<string, pair<int, int > > > moves;
+    for (int i=0; i<PLUTO_NODE_REPLICAS_NUM; i++) {
+        for (auto&& e : m_storage[i]) {
+            int to = placement(e.first);
+            if (to < 0 || to >= PLUTO_NODE_REPLICAS_NUM) {
+                unowned++;
+            }
+            else if (to != i) {
+                moves.push_back(make_pair(e.first, make_pair(i, to)));
+            }
+        }
+    }
+
+    for (auto&& mv : moves) {
+        int from = mv.second.first;
+        int to   = mv.second.second;
+        STORAGE_MAP::iterator it = m_storage[from].find(mv.first);
+        StoreEntry e = it->second;
+        m_storage[from].erase(it);
+        record_change(ChangeOperation::DELETE, from, mv.first, vector<unsigned char>(), true);
+
+        // Both maps may hold the key while the ring settles, newer wins
+        STORAGE_MAP::iterator dst = m_storage[to].find(mv.first);
+        if (dst == m_storage[to].end()) {
+            m_storage[to][mv.first] = e;
+            record_change(ChangeOperation::CREAT, to, mv.first, e.value, true);
+        }
+        else if (dst->second.version < e.version) {
+            dst->second = e;
+            record_change(ChangeOperation::UPDATE, to, mv.first, e.value, true);
+        }
+        moved++;
+    }
+
+    return 0;
+}
+
 int KVStore::do_get(int replica_type,
                     std::map<std::string, std::vector<unsigned char> > & v,
                     bool remove)
 {
-    if (replica_type<0 || replica_type>PLUTO_NODE_REPLICAS_NUM) {
+    if (replica_type<0 || replica_type>=PLUTO_NODE_REPLICAS_NUM) {
         getlog()->sendlog(LogLevel::ERROR, "Store: invalid replica type '%d'\n", replica_type);
         return -1;
     }
 
-    STORAGE_MAP m = m_storage[replica_type];
-    v = m;
+    STORAGE_MAP & m = m_storage[replica_type];
+    v.clear();
+    for (auto&& e : m) {
+        v.insert(make_pair(e.first, e.second.value));
+    }
     if (remove) {
+        for (auto&& e : m) {
+            record_change(ChangeOperation::DELETE, replica_type, e.first,
+                          vector<unsigned char>());
+        }
         m.clear();
     }
 
     return 0;
 }
 
+int KVStore::do_read_changes(uint64 from_seq, size_t max,
+                             vector<ChangeRecord>& v,
+                             uint64& next_seq)
+{
+    return m_feed.read(from_seq, max, v, next_seq);
+}
+
+void KVStore::add_change_listener(CHANGE_LISTENER listener)
+{
+    m_listeners.push_back(listener);
+}
+
+void KVStore::record_change(ChangeOperation op, int replica_type,
+                            const string& key,
+                            const vector<unsigned char> &v,
+                            bool moved)
+{
+    uint64 seq = m_feed.append(op, replica_type, key, v, moved);
+
+    if (m_listeners.empty()) {
+        return;
+    }
+
+    ChangeRecord rec;
+    rec.seq          = seq;
+    rec.op           = op;
+    rec.replica_type = replica_type;
+    rec.key          = key;
+    rec.value        = v;
+    rec.moved        = moved;
+    for (auto&& l : m_listeners) {
+        l(rec);
+    }
+}
+
 /* eof */
 
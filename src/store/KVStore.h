@@ -16,11 +16,13 @@
  *******************************************************************************
  */
 #include "stdinclude.h"
+#include "ChangeFeed.h"
 
 #include <string>
 
 #include <map>
 #include <vector>
+#include <functional>
 
 /*
  *******************************************************************************
@@ -35,29 +37,75 @@
  */
 
 /**
- * NO lock for the store!!!
+ * NO lock for the store, KVStoreAsyncAccessor's lock guards the store and
+ * its change feed!!!
  */
 class KVStore {
 public:
-    KVStore();
+    // Called for every mutation applied, with the store lock held, by store
+    // strand or by the thread of a synchronous access
+    typedef std::function<void (const ChangeRecord&)> CHANGE_LISTENER;
+
+    explicit KVStore(size_t feed_size = KV_CHANGE_FEED_DEF_SIZE);
     ~KVStore();
 
     int do_read(const std::string& key, int replica_type, 
                 std::vector<unsigned char> & v);
+    // Also returns the version of the value
+    int do_read(const std::string& key, int replica_type, 
+                std::vector<unsigned char> & v, uint64 & version);
+    // Version is assigned by the coordinator, 0 lets the store bump the
+    // version of the replica
     int do_write(const std::string& key, int replica_type, 
-                 const std::vector<unsigned char> &v);
+                 const std::vector<unsigned char> &v,
+                 uint64 version = 0);
+    // Conditional update and delete: 'expected' not 0 must be the version
+    // of the replica, otherwise nothing is changed and PLCONFLICT returned
     int do_update(const std::string& key, int replica_type, 
-                  const std::vector<unsigned char> &v);
-    int do_delete(const std::string& key, int replica_type);
+                  const std::vector<unsigned char> &v,
+                  uint64 version = 0, uint64 expected = 0);
+    int do_delete(const std::string& key, int replica_type, uint64 expected = 0);
+    // Read repair, written only if the key is missing or holds an older
+    // version
+    int do_repair(const std::string& key, int replica_type, 
+                  const std::vector<unsigned char> &v,
+                  uint64 version);
+
+    // Replica type of the key on this node after a ring change, -1 if the
+    // node holds no replica of it any more
+    typedef std::function<int (const std::string&)> PLACEMENT;
 
     int do_delete(int replica_type);
+    // Moves keys to the replica type placement gives. Keys no longer placed
+    // on this node are kept, 'unowned' counts them
+    int do_rebalance(PLACEMENT placement, size_t& moved, size_t& unowned);
     // Get all key values for specific replcias
     int do_get(int replica_type, 
                std::map<std::string, std::vector<unsigned char> >& v,
                bool remove = false);
+
+    // Change feed, see ChangeFeed::read
+    int do_read_changes(uint64 from_seq, size_t max,
+                        std::vector<ChangeRecord>& v,
+                        uint64& next_seq);
+
+    void add_change_listener(CHANGE_LISTENER listener);
+private:
+    // 'moved' marks the records of a key moved to another replica type
+    void record_change(ChangeOperation op, int replica_type,
+                       const std::string& key,
+                       const std::vector<unsigned char> &v,
+                       bool moved = false);
 private:
-    typedef std::map<std::string, std::vector<unsigned char> > STORAGE_MAP;
+    struct StoreEntry {
+        std::vector<unsigned char> value;
+        uint64                     version;
+    };
+    typedef std::map<std::string, StoreEntry > STORAGE_MAP;
     std::vector< STORAGE_MAP >  m_storage; 
+
+    ChangeFeed                      m_feed;
+    std::vector<CHANGE_LISTENER >   m_listeners;
 };
 
 /*
@@ -4,6 +4,7 @@
  *                                                                             *
  * Key value store accessor:                                                   *
  *   - Access to KV store                                                      *
+ *   - Asynchronous by store strand, or synchronous by the caller's thread     *
  *******************************************************************************
  */
 
@@ -18,8 +19,14 @@
 #include "stdinclude.h"
 
 #include "KVStore.h"
+#include "messages.h"
+#include "StoreStats.h"
+#include "AdmissionController.h"
+#include "util.h"
 
 #include <map>
+#include <mutex>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -37,6 +44,27 @@
  *******************************************************************************
  */
 
+// One write of a batch. 'op' is CREATREQ, UPDATEREQ, REPAIRREQ or DELETEREQ,
+// 'value' and 'version' are not used by delete
+struct StoreOp {
+    MsgType                    op;
+    std::string                key;
+    int                        replica_type;
+    std::vector<unsigned char> value;
+    uint64                     version;
+    uint64                     expected;  // update and delete only
+    int64                      deadline;
+};
+
+/**
+ * Store strand serializes asynchronous accesses, the store lock is also taken
+ * so that synchronous accesses can run on any thread. Change listeners are
+ * called with the lock held, handlers are called without it.
+ * Operations given a deadline (see get_deadline_now) are dropped if it has
+ * passed when the strand runs them, handler is called with PLEXPIRED.
+ * Operations waiting for the strand are counted for admission control.
+ * Update and delete given an expected version are conditional, see KVStore.
+ */
 class KVStoreAsyncAccessor {
 public:
     KVStoreAsyncAccessor(boost::asio::io_service& io,
@@ -47,27 +75,50 @@ public:
     virtual ~KVStoreAsyncAccessor() {
     }
 
+    /* HANDLER signature:
+       void (int rc, const unsigned char* data, size_t sz, uint64 version);
+     */
     template<typename RD_HANDLER > 
     void async_read(const std::string& key, int replica_type,
-                    RD_HANDLER handler) {
+                    RD_HANDLER handler, int64 deadline = 0) {
+        GetAdmission()->add_store_queue(1);
         m_strand.post([=](){
+                          GetAdmission()->add_store_queue(-1);
+                          if (is_expired(deadline)) {
+                              handler(PLEXPIRED, nullptr, 0, 0);
+                              return;
+                          }
                           std::vector<unsigned char> v;
-                          int rc = m_store.do_read(key, replica_type, v);
-                          handler(rc, v.data(), v.size());
+                          uint64 version = 0;
+                          int rc = 0;
+                          {
+                              std::lock_guard<std::mutex> lock(m_mtx);
+                              rc = m_store.do_read(key, replica_type, v, version);
+                          }
+                          handler(rc, v.data(), v.size(), version);
                       });
     }
 
     template<typename WR_HANDLER > 
     void async_write(const std::string& key, int replica_type,
                      const unsigned char* value, const size_t sz,
-                     WR_HANDLER handler)
+                     uint64 version,
+                     WR_HANDLER handler, int64 deadline = 0)
     {
-        // TODO: memory pointed by value must be exist when handler called
+        // Value is copied, caller's buffer may be gone when strand runs
+        std::vector<unsigned char> v(value, value + sz);
+        GetAdmission()->add_store_queue(1);
         m_strand.post([=](){
-                          std::vector<unsigned char> v;
-                          v.resize(sz);
-                          memcpy(v.data(), value, sz);
-                          int rc = m_store.do_write(key, replica_type, v);
+                          GetAdmission()->add_store_queue(-1);
+                          if (is_expired(deadline)) {
+                              handler(PLEXPIRED);
+                              return;
+                          }
+                          int rc = 0;
+                          {
+                              std::lock_guard<std::mutex> lock(m_mtx);
+                              rc = m_store.do_write(key, replica_type, v, version);
+                          }
                           handler(rc);
                       });
     }
@@ -75,44 +126,217 @@ public:
     template<typename UP_HANDLER > 
     void async_update(const std::string& key, int replica_type,
                       const unsigned char* value, const size_t sz,
-                      UP_HANDLER handler) {
+                      uint64 version,
+                      UP_HANDLER handler, int64 deadline = 0,
+                      uint64 expected = 0) {
+        std::vector<unsigned char> v(value, value + sz);
+        GetAdmission()->add_store_queue(1);
         m_strand.post([=](){
-                          std::vector<unsigned char> v;
-                          v.resize(sz);
-                          memcpy(v.data(), value, sz);
-                          int rc = m_store.do_update(key, replica_type, v);
+                          GetAdmission()->add_store_queue(-1);
+                          if (is_expired(deadline)) {
+                              handler(PLEXPIRED);
+                              return;
+                          }
+                          int rc = 0;
+                          {
+                              std::lock_guard<std::mutex> lock(m_mtx);
+                              rc = m_store.do_update(key, replica_type, v, version, expected);
+                          }
+                          handler(rc);
+                      });
+    }
+
+    template<typename RP_HANDLER > 
+    void async_repair(const std::string& key, int replica_type,
+                      const unsigned char* value, const size_t sz,
+                      uint64 version,
+                      RP_HANDLER handler, int64 deadline = 0) {
+        std::vector<unsigned char> v(value, value + sz);
+        GetAdmission()->add_store_queue(1);
+        m_strand.post([=](){
+                          GetAdmission()->add_store_queue(-1);
+                          if (is_expired(deadline)) {
+                              handler(PLEXPIRED);
+                              return;
+                          }
+                          int rc = 0;
+                          {
+                              std::lock_guard<std::mutex> lock(m_mtx);
+                              rc = m_store.do_repair(key, replica_type, v, version);
+                          }
                           handler(rc);
                       });
     }
 
     template<typename DEL_HANDLER > 
     void async_delete(const std::string& key, int replica_type,
-                      DEL_HANDLER handler) {
+                      DEL_HANDLER handler, int64 deadline = 0,
+                      uint64 expected = 0) {
+        GetAdmission()->add_store_queue(1);
         m_strand.post([=](){
-                          int rc = m_store.do_delete(key, replica_type);
+                          GetAdmission()->add_store_queue(-1);
+                          if (is_expired(deadline)) {
+                              handler(PLEXPIRED);
+                              return;
+                          }
+                          int rc = 0;
+                          {
+                              std::lock_guard<std::mutex> lock(m_mtx);
+                              rc = m_store.do_delete(key, replica_type, expected);
+                          }
                           handler(rc);
                       });
     }
 
+    /* HANDLER signature:
+       void (const std::vector<int>& rcs);
+       Operations are applied in order under one lock, rcs[i] is the result
+       of ops[i]
+     */
+    template<typename BT_HANDLER >
+    void async_batch(std::vector<StoreOp> ops, BT_HANDLER handler) {
+        std::shared_ptr<std::vector<StoreOp> > pops = std::make_shared<std::vector<StoreOp> >();
+        pops->swap(ops);
+        GetAdmission()->add_store_queue(pops->size());
+        m_strand.post([=]() {
+            GetAdmission()->add_store_queue(-static_cast<int64>(pops->size()));
+            std::vector<int> rcs(pops->size(), PLERROR);
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                for (size_t i=0; i<pops->size(); i++) {
+                    const StoreOp & o = (*pops)[i];
+                    if (is_expired(o.deadline)) {
+                        rcs[i] = PLEXPIRED;
+                        continue;
+                    }
+                    switch(o.op) {
+                    case MsgType::CREATREQ:
+                        rcs[i] = m_store.do_write(o.key, o.replica_type, o.value, o.version);
+                        break;
+                    case MsgType::UPDATEREQ:
+                        rcs[i] = m_store.do_update(o.key, o.replica_type, o.value, o.version, o.expected);
+                        break;
+                    case MsgType::REPAIRREQ:
+                        rcs[i] = m_store.do_repair(o.key, o.replica_type, o.value, o.version);
+                        break;
+                    case MsgType::DELETEREQ:
+                        rcs[i] = m_store.do_delete(o.key, o.replica_type, o.expected);
+                        break;
+                    default:
+                        break;
+                    }
+                }
+            }
+            handler(rcs);
+        });
+    }
+
     template<typename GET_HANDLER >
     void async_get(int replica_type, bool remove, GET_HANDLER handler) {
+        GetAdmission()->add_store_queue(1);
         m_strand.post([=]() {
+            GetAdmission()->add_store_queue(-1);
             std::map<std::string, std::vector<unsigned char> > v;
-            int rc = m_store.do_get(replica_type, v, remove);
+            int rc = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                rc = m_store.do_get(replica_type, v, remove);
+            }
             handler(rc, v);
         });
     }
 
     template<typename DEL_HANDLER >
     void async_delete(int replica_type, DEL_HANDLER handler ) {
+        GetAdmission()->add_store_queue(1);
         m_strand.post([=]() {
-            int rc = m_store.do_delete(replica_type);
+            GetAdmission()->add_store_queue(-1);
+            int rc = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                rc = m_store.do_delete(replica_type);
+            }
             handler(rc);
         });
     }
+
+    /* HANDLER signature:
+       void (int rc, size_t moved, size_t unowned);
+     */
+    template<typename RB_HANDLER >
+    void async_rebalance(KVStore::PLACEMENT placement, RB_HANDLER handler) {
+        GetAdmission()->add_store_queue(1);
+        m_strand.post([=]() {
+            GetAdmission()->add_store_queue(-1);
+            size_t moved   = 0;
+            size_t unowned = 0;
+            int rc = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                rc = m_store.do_rebalance(placement, moved, unowned);
+            }
+            handler(rc, moved, unowned);
+        });
+    }
+
+    /* HANDLER signature:
+       void (int rc, std::vector<ChangeRecord>&, uint64 next_seq);
+     */
+    template<typename FEED_HANDLER >
+    void async_read_changes(uint64 from_seq, size_t max, FEED_HANDLER handler) {
+        GetAdmission()->add_store_queue(1);
+        m_strand.post([=]() {
+            GetAdmission()->add_store_queue(-1);
+            std::vector<ChangeRecord > v;
+            uint64 next_seq = 0;
+            int rc = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                rc = m_store.do_read_changes(from_seq, max, v, next_seq);
+            }
+            handler(rc, v, next_seq);
+        });
+    }
+
+    // Synchronous accesses, called by any thread
+    int sync_read(const std::string& key, int replica_type,
+                  std::vector<unsigned char>& value, uint64& version) {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_store.do_read(key, replica_type, value, version);
+    }
+
+    int sync_write(const std::string& key, int replica_type,
+                   const unsigned char* value, const size_t sz,
+                   uint64 version) {
+        std::vector<unsigned char> v(value, value + sz);
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_store.do_write(key, replica_type, v, version);
+    }
+
+    int sync_update(const std::string& key, int replica_type,
+                    const unsigned char* value, const size_t sz,
+                    uint64 version, uint64 expected = 0) {
+        std::vector<unsigned char> v(value, value + sz);
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_store.do_update(key, replica_type, v, version, expected);
+    }
+
+    int sync_delete(const std::string& key, int replica_type, uint64 expected = 0) {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_store.do_delete(key, replica_type, expected);
+    }
+private:
+    static bool is_expired(int64 deadline) {
+        if (!is_deadline_passed(deadline)) {
+            return false;
+        }
+        GetStoreStats()->incr(StatCounter::EXPIRED);
+        return true;
+    }
 private:
     boost::asio::io_service::strand m_strand;
     KVStore&                        m_store;
+    std::mutex                      m_mtx;
 };
 
 /*
@@ -0,0 +1,108 @@
+/**
+ *******************************************************************************
+ * LatencyTracker.cpp                                                          *
+ *                                                                             *
+ * Latency tracker:                                                            *
+ *   - Log-scale histogram of recent latencies, answers percentiles            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "LatencyTracker.h"
+
+using namespace std;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+// 2^40 us is about 12 days, larger latencies share the last bucket
+#define LATENCY_MAX_EXP      40
+#define LATENCY_SUB_BUCKETS  4
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+LatencyTracker::LatencyTracker(size_t window) :
+   m_buckets(LATENCY_MAX_EXP * LATENCY_SUB_BUCKETS, 0),
+   m_count(0),
+   m_window(window)
+{
+    if (m_window == 0) {
+        m_window = 1;
+    }
+}
+
+LatencyTracker::~LatencyTracker()
+{
+}
+
+void LatencyTracker::add(int64 us)
+{
+    if (m_count >= m_window) {
+        m_count = 0;
+        for (auto&& b : m_buckets) {
+            b /= 2;
+            m_count += b;
+        }
+    }
+    m_buckets[get_bucket(us)]++;
+    m_count++;
+}
+
+int64 LatencyTracker::get_percentile(double percent, size_t min_samples) const
+{
+    if ((m_count == 0) || (m_count < min_samples)) {
+        return -1;
+    }
+
+    size_t target = static_cast<size_t>(m_count * percent / 100.0);
+    if (target >= m_count) {
+        target = m_count - 1;
+    }
+
+    size_t seen = 0;
+    for (size_t i=0; i<m_buckets.size(); i++) {
+        seen += m_buckets[i];
+        if (seen > target) {
+            return get_bucket_upper(i);
+        }
+    }
+    return get_bucket_upper(m_buckets.size() - 1);
+}
+
+size_t LatencyTracker::get_bucket(int64 us)
+{
+    if (us < 1) {
+        return 0;
+    }
+
+    int exp = 63 - __builtin_clzll(static_cast<unsigned long long>(us));
+    if (exp >= LATENCY_MAX_EXP) {
+        return LATENCY_MAX_EXP * LATENCY_SUB_BUCKETS - 1;
+    }
+    // Two bits following the leading one
+    size_t sub = ((static_cast<uint64>(us) << 2) >> exp) & (LATENCY_SUB_BUCKETS - 1);
+    return exp * LATENCY_SUB_BUCKETS + sub;
+}
+
+int64 LatencyTracker::get_bucket_upper(size_t idx)
+{
+    int    exp = idx / LATENCY_SUB_BUCKETS;
+    uint64 sub = idx % LATENCY_SUB_BUCKETS;
+    return static_cast<int64>(((LATENCY_SUB_BUCKETS + sub + 1) << exp) / LATENCY_SUB_BUCKETS);
+}
+
+/* eof */
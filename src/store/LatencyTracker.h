@@ -0,0 +1,69 @@
+/**
+ *******************************************************************************
+ * LatencyTracker.h                                                            *
+ *                                                                             *
+ * Latency tracker:                                                            *
+ *   - Log-scale histogram of recent latencies, answers percentiles            *
+ *******************************************************************************
+ */
+
+#ifndef _LATENCY_TRACKER_H_
+#define _LATENCY_TRACKER_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <vector>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * Latencies are kept in microseconds, 4 buckets per power of 2, thus a
+ * percentile is accurate to 25%. When 'window' samples are collected all
+ * buckets are halved, older samples fade out.
+ * NO lock, the owner serializes the access!!!
+ */
+class LatencyTracker {
+public:
+    explicit LatencyTracker(size_t window = KV_LATENCY_DEF_WINDOW);
+    ~LatencyTracker();
+
+    void add(int64 us);
+
+    // Latency in microseconds under which 'percent' of samples fall,
+    // -1 if less than 'min_samples' collected
+    int64 get_percentile(double percent, size_t min_samples = 1) const;
+
+    size_t get_count() const {
+        return m_count;
+    }
+private:
+    static size_t get_bucket(int64 us);
+    static int64 get_bucket_upper(size_t idx);
+private:
+    std::vector<uint32 > m_buckets;
+    size_t               m_count;
+    size_t               m_window;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _LATENCY_TRACKER_H_
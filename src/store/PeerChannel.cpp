@@ -0,0 +1,459 @@
+/**
+ *******************************************************************************
+ * PeerChannel.cpp                                                             *
+ *                                                                             *
+ * Peer channel:                                                               *
+ *   - One TCP connection to a peer node carrying many in-flight requests      *
+ *   - Responses are matched by transaction id, in any order                   *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <boost/asio.hpp>
+#include "PeerChannel.h"
+#include "StoreStats.h"
+#include "BatchMessage.h"
+#include "config.h"
+
+using namespace std;
+using namespace boost::asio;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+PeerChannel::PeerChannel(io_service& io,
+                         const ip::tcp::endpoint& ep,
+                         ConfigPortal * pcfg,
+                         PUSH_HANDLER push) :
+   m_io(io),
+   m_strand(io),
+   m_sock(io),
+   m_ep(ep),
+   m_state(State::CLOSED),
+   m_conn_gen(0),
+   m_next_txid(1),
+   m_calls(),
+   m_inflight(0),
+   m_write_queue(),
+   m_writing(false),
+   m_batch_max(1),
+   m_batch_bytes(0),
+   m_batch_delay(0),
+   m_linger_timer(io),
+   m_lingering(false),
+   m_lingered(false),
+   m_push(push),
+   m_buf(),
+   m_rcv_buf(),
+   m_msgfact()
+{
+    if (pcfg != nullptr) {
+        m_batch_max   = max(pcfg->get_batch_max(), 1);
+        m_batch_bytes = max(pcfg->get_batch_bytes(), 0);
+        m_batch_delay = max(pcfg->get_batch_delay(), 0);
+    }
+}
+
+PeerChannel::~PeerChannel()
+{
+    // Pending operations hold a reference to the channel, nothing in flight
+    boost::system::error_code ec;
+    m_sock.close(ec);
+}
+
+int64 PeerChannel::async_call(StoreMessage* preq, int timeout_ms, CALL_HANDLER handler)
+{
+    if (preq == nullptr) {
+        getlog()->sendlog(LogLevel::ERROR, "Peer channel aysnc_call got nullptr\n");
+        handler(ClientErrorCode::ERROR_INVALID_PARAM, nullptr);
+        return -1;
+    }
+
+    int64 txid = m_next_txid++;
+
+    auto self(shared_from_this());
+    m_strand.post([this, self, txid, preq, timeout_ms, handler]() {
+        Call call;
+        call.preq.reset(preq);
+        call.handler = handler;
+
+        if (preq->is_expired()) {
+            GetStoreStats()->incr(StatCounter::EXPIRED);
+            handler(ClientErrorCode::ERROR_TIMEOUT, nullptr);
+            return;
+        }
+
+        preq->set_txid(txid);
+        if (preq->build_msg() != 0) {
+            getlog()->sendlog(LogLevel::ERROR, "Peer channel build request failed\n");
+            handler(ClientErrorCode::ERROR_MSG, nullptr);
+            return;
+        }
+
+        if (timeout_ms > 0) {
+            call.timer = make_shared<deadline_timer>(m_io);
+            call.timer->expires_from_now(boost::posix_time::milliseconds(timeout_ms));
+            call.timer->async_wait(m_strand.wrap([this, self, txid](const boost::system::error_code& ec) {
+                                                     if (ec != boost::asio::error::operation_aborted) {
+                                                         complete(txid, ClientErrorCode::ERROR_TIMEOUT, nullptr);
+                                                     }
+                                                 }));
+        }
+
+        m_calls.insert(make_pair(txid, call));
+        m_inflight++;
+        m_write_queue.push_back(txid);
+
+        if (m_state == State::CLOSED) {
+            do_connect();
+        }
+        else if (m_state == State::OPEN) {
+            write_next();
+        }
+    });
+
+    return txid;
+}
+
+void PeerChannel::cancel(int64 txid)
+{
+    auto self(shared_from_this());
+    m_strand.post([this, self, txid]() {
+        complete(txid, ClientErrorCode::ERROR_CANCELLED, nullptr);
+    });
+}
+
+void PeerChannel::connect()
+{
+    auto self(shared_from_this());
+    m_strand.post([this, self]() {
+        if (m_state == State::CLOSED) {
+            do_connect();
+        }
+    });
+}
+
+void PeerChannel::close()
+{
+    auto self(shared_from_this());
+    m_strand.post([this, self]() {
+        do_close();
+    });
+}
+
+void PeerChannel::do_connect()
+{
+    m_state = State::CONNECTING;
+
+    uint32 gen = m_conn_gen;
+    auto self(shared_from_this());
+    m_sock.async_connect(m_ep, m_strand.wrap([this, self, gen](const boost::system::error_code& ec) {
+        if (gen != m_conn_gen) {
+            // Closed while connecting
+            return;
+        }
+        if (ec) {
+            getlog()->sendlog(LogLevel::ERROR, "Peer channel connect to '%s:%d' failed, error=%s\n",
+                              m_ep.address().to_string().c_str(), m_ep.port(),
+                              ec.message().c_str());
+            do_close();
+            return;
+        }
+
+        boost::system::error_code ignore;
+        m_sock.set_option(ip::tcp::no_delay(true), ignore);
+        m_state = State::OPEN;
+
+        do_read();
+        write_next();
+    }));
+}
+
+void PeerChannel::do_read()
+{
+    uint32 gen = m_conn_gen;
+    auto self(shared_from_this());
+    m_sock.async_read_some(buffer(m_buf), m_strand.wrap(
+        [this, self, gen](const boost::system::error_code& ec, size_t bytes_read) {
+            if (gen != m_conn_gen) {
+                return;
+            }
+            if (ec) {
+                do_close();
+                return;
+            }
+
+            copy(m_buf.data(), m_buf.data()+bytes_read, back_inserter(m_rcv_buf));
+
+            size_t consumed = 0;
+            while (consumed < m_rcv_buf.size()) {
+                boost::tribool result;
+                StoreMessage * presp = nullptr;
+                tie(result, presp) = m_msgfact.extract(m_rcv_buf.data() + consumed,
+                                                       m_rcv_buf.size() - consumed);
+                if (result) {
+                    consumed += presp->get_size();
+                    if (presp->get_msgtype() == MsgType::BATCHRESP) {
+                        complete_batch(dynamic_cast<BatchResponseMessage*>(presp));
+                    }
+                    else if (presp->get_msgtype() == MsgType::WATCHNOTIFY) {
+                        if (m_push) {
+                            m_push(presp);
+                        }
+                        else {
+                            delete presp;
+                        }
+                    }
+                    else {
+                        complete(presp->get_txid(), ClientErrorCode::SUCCESS, presp);
+                    }
+                }
+                else if (!result) {
+                    getlog()->sendlog(LogLevel::ERROR, "Peer channel '%s:%d' got invalid message\n",
+                                      m_ep.address().to_string().c_str(), m_ep.port());
+                    do_close();
+                    return;
+                }
+                else {
+                    break;
+                }
+            }
+            m_rcv_buf.erase(m_rcv_buf.begin(), m_rcv_buf.begin() + consumed);
+
+            do_read();
+        }));
+}
+
+void PeerChannel::write_next()
+{
+    if (m_writing || m_lingering || (m_state != State::OPEN)) {
+        return;
+    }
+
+    // Skip requests completed before sent, such as cancelled or timeout,
+    // and the ones expired while waiting
+    while (!m_write_queue.empty()) {
+        map<int64, Call >::iterator it = m_calls.find(m_write_queue.front());
+        if (it == m_calls.end()) {
+            m_write_queue.pop_front();
+            continue;
+        }
+        if (!it->second.preq->is_expired()) {
+            break;
+        }
+        m_write_queue.pop_front();
+        GetStoreStats()->incr(StatCounter::EXPIRED);
+        complete(it->first, ClientErrorCode::ERROR_TIMEOUT, nullptr);
+    }
+    if (m_write_queue.empty()) {
+        return;
+    }
+
+    shared_ptr<StoreMessage > preq = m_calls[m_write_queue.front()].preq;
+    if (is_batchable(*preq) && (m_batch_delay > 0) && !m_lingered &&
+        (m_write_queue.size() < m_batch_max)) {
+        // Give other writes a moment to join the batch
+        m_lingering = true;
+        uint32 gen = m_conn_gen;
+        auto self(shared_from_this());
+        m_linger_timer.expires_from_now(boost::posix_time::microseconds(m_batch_delay));
+        m_linger_timer.async_wait(m_strand.wrap([this, self, gen](const boost::system::error_code& ec) {
+                                                    if (gen != m_conn_gen) {
+                                                        return;
+                                                    }
+                                                    m_lingering = false;
+                                                    m_lingered  = true;
+                                                    write_next();
+                                                }));
+        return;
+    }
+    m_lingered = false;
+    m_write_queue.pop_front();
+
+    if (is_batchable(*preq)) {
+        // Following live writes join the batch until a cap is reached
+        shared_ptr<BatchRequestMessage > pbatch;
+        vector<int64> txids;
+        size_t bytes = preq->get_size();
+        while (!m_write_queue.empty() && (m_batch_max > 1)) {
+            map<int64, Call >::iterator it = m_calls.find(m_write_queue.front());
+            if ((it != m_calls.end()) && it->second.preq->is_expired()) {
+                m_write_queue.pop_front();
+                GetStoreStats()->incr(StatCounter::EXPIRED);
+                complete(it->first, ClientErrorCode::ERROR_TIMEOUT, nullptr);
+                continue;
+            }
+            if (it == m_calls.end()) {
+                m_write_queue.pop_front();
+                continue;
+            }
+            StoreMessage & next = *it->second.preq;
+            if (!is_batchable(next) ||
+                ((pbatch.get() != nullptr) && (pbatch->get_count() >= m_batch_max)) ||
+                ((m_batch_bytes > 0) && (bytes + next.get_size() > m_batch_bytes))) {
+                break;
+            }
+            if (pbatch.get() == nullptr) {
+                pbatch = make_shared<BatchRequestMessage >(MessageOriginator::Server, 0);
+                pbatch->add_message(preq.get());
+                txids.push_back(preq->get_txid());
+            }
+            pbatch->add_message(&next);
+            txids.push_back(next.get_txid());
+            bytes += next.get_size();
+            m_write_queue.pop_front();
+        }
+        if (pbatch.get() != nullptr) {
+            if (pbatch->build_msg() != 0) {
+                // Requests of the batch fail now, the queue moves on
+                getlog()->sendlog(LogLevel::ERROR, "Peer channel build batch of %zu failed\n",
+                                  txids.size());
+                for (auto&& txid : txids) {
+                    complete(txid, ClientErrorCode::GENERIC_ERROR, nullptr);
+                }
+                write_next();
+                return;
+            }
+            GetStoreStats()->incr(StatCounter::BATCHED, pbatch->get_count());
+            preq = pbatch;
+        }
+    }
+
+    m_writing = true;
+    // The request is kept alive by the handler even if the call completes
+    // during the write
+    uint32 gen = m_conn_gen;
+    auto self(shared_from_this());
+    async_write(m_sock, buffer(preq->get_raw(), preq->get_size()), m_strand.wrap(
+        [this, self, preq, gen](const boost::system::error_code& ec, size_t bytes_write) {
+            if (gen != m_conn_gen) {
+                return;
+            }
+            m_writing = false;
+            if (ec) {
+                getlog()->sendlog(LogLevel::ERROR, "Peer channel '%s:%d' send failed, error=%s\n",
+                                  m_ep.address().to_string().c_str(), m_ep.port(),
+                                  ec.message().c_str());
+                do_close();
+                return;
+            }
+            write_next();
+        }));
+}
+
+bool PeerChannel::is_batchable(const StoreMessage& req) const
+{
+    if ((m_batch_max <= 1) || (req.get_originator() != MessageOriginator::Server)) {
+        return false;
+    }
+    switch(req.get_msgtype()) {
+    case MsgType::CREATREQ:
+    case MsgType::UPDATEREQ:
+    case MsgType::REPAIRREQ:
+    case MsgType::DELETEREQ:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void PeerChannel::complete(int64 txid, ClientErrorCode e, StoreMessage* presp)
+{
+    map<int64, Call >::iterator it = m_calls.find(txid);
+    if (it == m_calls.end()) {
+        // Late response of a call cancelled or timeout
+        if (presp != nullptr) {
+            delete presp;
+        }
+        return;
+    }
+
+    Call call = it->second;
+    m_calls.erase(it);
+    m_inflight--;
+
+    if (call.timer.get() != nullptr) {
+        call.timer->cancel();
+    }
+    call.handler(e, presp);
+}
+
+void PeerChannel::complete_batch(BatchResponseMessage* presp)
+{
+    for (size_t i=0; i<presp->get_count(); i++) {
+        size_t sz = 0;
+        unsigned char * raw = presp->get_message(i, sz);
+
+        boost::tribool result;
+        StoreMessage * p = nullptr;
+        tie(result, p) = m_msgfact.extract(raw, sz);
+        if (!result || (p == nullptr)) {
+            // Request fails by timeout
+            getlog()->sendlog(LogLevel::ERROR, "Peer channel '%s:%d' got invalid batch response %zu\n",
+                              m_ep.address().to_string().c_str(), m_ep.port(), i);
+            continue;
+        }
+        complete(p->get_txid(), ClientErrorCode::SUCCESS, p);
+    }
+    delete presp;
+}
+
+void PeerChannel::fail_all(ClientErrorCode e)
+{
+    map<int64, Call > calls;
+    calls.swap(m_calls);
+    m_write_queue.clear();
+    m_inflight = 0;
+
+    for (auto&& c : calls) {
+        if (c.second.timer.get() != nullptr) {
+            c.second.timer->cancel();
+        }
+        c.second.handler(e, nullptr);
+    }
+}
+
+void PeerChannel::do_close()
+{
+    m_state     = State::CLOSED;
+    m_writing   = false;
+    m_lingering = false;
+    m_lingered  = false;
+    m_conn_gen++;
+
+    boost::system::error_code ignore;
+    m_linger_timer.cancel(ignore);
+
+    boost::system::error_code ec;
+    m_sock.close(ec);
+    m_rcv_buf.clear();
+
+    fail_all(ClientErrorCode::ERROR_IO);
+}
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+/* eof */
@@ -0,0 +1,159 @@
+/**
+ *******************************************************************************
+ * PeerChannel.h                                                               *
+ *                                                                             *
+ * Peer channel:                                                               *
+ *   - One TCP connection to a peer node carrying many in-flight requests      *
+ *   - Responses are matched by transaction id, in any order                   *
+ *******************************************************************************
+ */
+
+#ifndef _PEER_CHANNEL_H_
+#define _PEER_CHANNEL_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+#include "StoreMessage.h"
+#include "StoreMsgFact.h"
+#include "StoreClient.h"
+
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include <boost/asio.hpp>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * Requests are written back to back on the connection without waiting for
+ * responses. The channel assigns each request a transaction id unique on the
+ * channel, the peer echoes it in the response.
+ * The connection is (re)opened on demand, all in-flight requests fail with
+ * ERROR_IO if it breaks.
+ * Replica writes queued together are sent in one batch frame, up to a count
+ * and size cap; the first one may linger a few microseconds for others.
+ * Messages the peer pushes without a request, such as WATCHNOTIFY, go to the
+ * push handler.
+ */
+class PeerChannel : public std::enable_shared_from_this<PeerChannel> {
+public:
+    // Called by channel strand, the handler owns the response message
+    typedef std::function<void(const ClientErrorCode&, StoreMessage*)> CALL_HANDLER;
+    // Called by channel strand, the handler owns the message
+    typedef std::function<void(StoreMessage*)> PUSH_HANDLER;
+
+    PeerChannel(const PeerChannel& ) = delete;
+    PeerChannel& operator=(const PeerChannel& ) = delete;
+
+    // Without 'pcfg' requests are never batched
+    PeerChannel(boost::asio::io_service& io,
+                const boost::asio::ip::tcp::endpoint& ep,
+                ConfigPortal * pcfg = nullptr,
+                PUSH_HANDLER push = PUSH_HANDLER());
+    ~PeerChannel();
+
+    // Channel takes ownership of 'preq', and builds it after setting the
+    // transaction id. timeout_ms <= 0 means no timeout.
+    // Returns the transaction id, to be used for cancel.
+    int64 async_call(StoreMessage* preq, int timeout_ms, CALL_HANDLER handler);
+
+    // Handler of the request is called with ERROR_CANCELLED, response
+    // arriving later is dropped
+    void cancel(int64 txid);
+
+    // Open the connection in advance
+    void connect();
+
+    // Close the connection, in-flight requests fail with ERROR_IO
+    void close();
+
+    const boost::asio::ip::tcp::endpoint& get_endpoint() const {
+        return m_ep;
+    }
+
+    size_t get_inflight() const {
+        return m_inflight;
+    }
+private:
+    struct Call {
+        std::shared_ptr<StoreMessage >               preq;
+        CALL_HANDLER                                 handler;
+        std::shared_ptr<boost::asio::deadline_timer > timer;
+    };
+
+    enum class State : int {
+        CLOSED = 0,
+        CONNECTING,
+        OPEN
+    };
+private:
+    // Following functions are called by channel strand!!!
+    void do_connect();
+    void do_read();
+    void write_next();
+    bool is_batchable(const StoreMessage& req) const;
+    void complete(int64 txid, ClientErrorCode e, StoreMessage* presp);
+    void complete_batch(BatchResponseMessage* presp);
+    void fail_all(ClientErrorCode e);
+    void do_close();
+private:
+    boost::asio::io_service &       m_io;
+    boost::asio::io_service::strand m_strand;
+    boost::asio::ip::tcp::socket    m_sock;
+    boost::asio::ip::tcp::endpoint  m_ep;
+    State                           m_state;
+    // Bumped when the connection closes, handlers of the previous
+    // connection are ignored
+    uint32                          m_conn_gen;
+
+    std::atomic<int64>              m_next_txid;
+    std::map<int64, Call >          m_calls;
+    std::atomic<size_t>             m_inflight;
+
+    // Transaction id of requests waiting for write
+    std::deque<int64 >              m_write_queue;
+    bool                            m_writing;
+
+    // Batching of replica writes, max of 1 disables it
+    size_t                          m_batch_max;
+    size_t                          m_batch_bytes;
+    int                             m_batch_delay;    // us
+    boost::asio::deadline_timer     m_linger_timer;
+    bool                            m_lingering;
+    bool                            m_lingered;       // write without delay
+
+    PUSH_HANDLER                    m_push;
+
+    std::array<unsigned char, 4096> m_buf;
+    std::vector<unsigned char>      m_rcv_buf;
+    StoreMessageFactory             m_msgfact;
+};
+
+typedef std::shared_ptr<PeerChannel > PeerChannel_ptr;
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _PEER_CHANNEL_H_
@@ -33,6 +33,11 @@
  *******************************************************************************
  */
 
+/**
+ * Digest read asks the replica for the version and digest of the value only,
+ * the coordinator gets the value from one replica and compares the digests
+ * of the others.
+ */
 class ReadRequestMessage : public KeyReqMessage {
 public:
     ReadRequestMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
@@ -46,6 +51,19 @@ public:
 
     ~ReadRequestMessage() {
     }
+
+    void set_digest_only(bool digest) {
+        if (digest) {
+            set_flags(get_flags() | PLUTO_KEY_FLAG_DIGEST);
+        }
+        else {
+            set_flags(get_flags() & ~PLUTO_KEY_FLAG_DIGEST);
+        }
+    }
+
+    bool is_digest_only() const {
+        return (get_flags() & PLUTO_KEY_FLAG_DIGEST) != 0;
+    }
 private:
 };
 
@@ -62,6 +80,20 @@ public:
     }
     ~ReadResponseMessage() {
     }
+
+    void set_digest_only(bool digest) {
+        if (digest) {
+            set_flags(get_flags() | PLUTO_KEY_FLAG_DIGEST);
+        }
+        else {
+            set_flags(get_flags() & ~PLUTO_KEY_FLAG_DIGEST);
+        }
+    }
+
+    // No value carried
+    bool is_digest_only() const {
+        return (get_flags() & PLUTO_KEY_FLAG_DIGEST) != 0;
+    }
 };
 
 /**
@@ -0,0 +1,76 @@
+/**
+ *******************************************************************************
+ * RepairMessage.h                                                             *
+ *                                                                             *
+ * Server read repair request/response message                                 *
+ *******************************************************************************
+ */
+
+#ifndef _REPAIR_MSG_COMMON_H_
+#define _REPAIR_MSG_COMMON_H_
+
+/**
+ *******************************************************************************
+ * Headers                                                                     *
+ *******************************************************************************
+ */
+#include <string>
+#include <stdexcept>
+
+#include "stdinclude.h"
+#include "KVMessage.h"
+#include "plexcept.h"
+
+/**
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/**
+ *******************************************************************************
+ * Class declaraction                                                          *
+ *******************************************************************************
+ */
+
+/**
+ * Sent by coordinator to replicas found stale by a read, the value is written
+ * only if the replica misses the key or holds an older version.
+ */
+class RepairRequestMessage : public KVReqMessage {
+public:
+    RepairRequestMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       KVReqMessage(buf, sz, managebuf) {
+    };
+  
+    RepairRequestMessage(MessageOriginator originator,
+                         int64 txid) :
+        KVReqMessage(MsgType::REPAIRREQ, originator, txid) {
+    }
+
+    ~RepairRequestMessage() {
+    }
+private:
+};
+
+class RepairResponseMessage : public KVRespMessage {
+public:
+    RepairResponseMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       KVRespMessage(buf, sz, managebuf) {
+    }
+    RepairResponseMessage(MessageOriginator originator,
+                          int64 txid,
+                          MsgStatus status) :
+       KVRespMessage(MsgType::REPAIRRESP, originator, txid, status) {
+    }
+    ~RepairResponseMessage() {
+    }
+};
+
+/**
+ *******************************************************************************
+ * Function declaractions                                                      *
+ *******************************************************************************
+ */
+
+#endif // _REPAIR_MSG_COMMON_H_
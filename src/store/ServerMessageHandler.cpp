@@ -19,6 +19,9 @@
 #include "ReadMessage.h"
 #include "UpdateMessage.h"
 #include "DeleteMessage.h"
+#include "RepairMessage.h"
+#include "BatchMessage.h"
+#include "WatchMessage.h"
 
 #include "ServerMessageHandler.h"
 #include "ConnectionManager.h"
@@ -45,8 +48,13 @@ ServerMessageHandler::ServerMessageHandler(io_service & io,
                                            ConnectionManager& conn_mgr,
                                            StoreManager& store,
                                            ConfigPortal * pcfg) :
-   StoreMessageHandler(io, conn_mgr, store, pcfg)
+   StoreMessageHandler(io, conn_mgr, store, pcfg),
+   m_msgfact(),
+   m_watch(io, pcfg, MessageOriginator::Server)
 {
+    m_store.add_change_listener([this](const ChangeRecord& rec) {
+                                    m_watch.handle_change(rec);
+                                });
 }
 
 ServerMessageHandler::~ServerMessageHandler()
@@ -65,8 +73,12 @@ int ServerMessageHandler::handle_create_request(CreatRequestMessage* pmsg)
     pmsg->get_value(value.data(), sz);
 
     m_store.async_creat(key, pmsg->get_replica_type(), 
-                        value.data(), sz, 
+                        value.data(), sz, pmsg->get_version(),
                         [this, pmsg](int rc){
+                            if (rc == PLEXPIRED) {
+                                // Coordinator has given up, no response
+                                return;
+                            }
                             CreatResponseMessage * presp = nullptr;
                             if (rc) {
                                 presp = new CreatResponseMessage(MessageOriginator::Server,
@@ -81,7 +93,7 @@ int ServerMessageHandler::handle_create_request(CreatRequestMessage* pmsg)
                             set_resp_info_from_req(presp, pmsg);
                             presp->build_msg();
                             send_message(presp);
-                        });
+                        }, pmsg->get_deadline());
     return 0;
 }
 
@@ -98,7 +110,12 @@ int ServerMessageHandler::handle_read_request(ReadRequestMessage* pmsg)
     std::string key = pmsg->get_key();
 
     m_store.async_read(key, pmsg->get_replica_type(),
-                       [this, pmsg](int rc, const unsigned char* data, const size_t sz) {
+                       [this, pmsg](int rc, const unsigned char* data, const size_t sz,
+                                    uint64 version) {
+                           if (rc == PLEXPIRED) {
+                               // Coordinator has given up, no response
+                               return;
+                           }
                            ReadResponseMessage * presp = nullptr;
                            if (rc) {
                                presp = new ReadResponseMessage(MessageOriginator::Server,
@@ -110,12 +127,20 @@ int ServerMessageHandler::handle_read_request(ReadRequestMessage* pmsg)
                                presp = new ReadResponseMessage(MessageOriginator::Server,
                                                                pmsg->get_txid(),
                                                                MsgStatus::OK);
-                               presp->set_value(data, sz);
+                               presp->set_version(version);
+                               presp->set_digest(get_value_digest(data, sz));
+                               if (pmsg->is_digest_only()) {
+                                   // Coordinator gets the value from another replica
+                                   presp->set_digest_only(true);
+                               }
+                               else {
+                                   presp->set_value(data, sz);
+                               }
                            }
                            set_resp_info_from_req(presp, pmsg);
                            presp->build_msg();
                            send_message(presp);
-                       });
+                       }, pmsg->get_deadline());
     return 0;
 }
 
@@ -135,10 +160,19 @@ int ServerMessageHandler::handle_update_request(UpdateRequestMessage* pmsg)
     pmsg->get_value(value.data(), sz);
 
     m_store.async_update(key, pmsg->get_replica_type(), 
-                         value.data(), sz, 
+                         value.data(), sz, pmsg->get_version(),
                          [this, pmsg](int rc) {
+                            if (rc == PLEXPIRED) {
+                                // Coordinator has given up, no response
+                                return;
+                            }
                             UpdateResponseMessage * presp = nullptr;
-                            if (rc) {
+                            if (rc == PLCONFLICT) {
+                                presp = new UpdateResponseMessage(MessageOriginator::Server,
+                                                                 pmsg->get_txid(),
+                                                                 MsgStatus::CONFLICT);
+                            }
+                            else if (rc) {
                                 presp = new UpdateResponseMessage(MessageOriginator::Server,
                                                                  pmsg->get_txid(),
                                                                  MsgStatus::ERROR);
@@ -151,7 +185,7 @@ int ServerMessageHandler::handle_update_request(UpdateRequestMessage* pmsg)
                             set_resp_info_from_req(presp, pmsg);
                             presp->build_msg();
                             send_message(presp);
-                        });
+                        }, pmsg->get_deadline(), pmsg->get_expected_version());
     return 0;
 }
 
@@ -168,8 +202,17 @@ int ServerMessageHandler::handle_delete_request(DeleteRequestMessage* pmsg)
 
     m_store.async_delete(key, pmsg->get_replica_type(),
                          [this, pmsg](int rc) {
+                             if (rc == PLEXPIRED) {
+                                 // Coordinator has given up, no response
+                                 return;
+                             }
                              DeleteResponseMessage * presp = nullptr;
-                             if (rc) {
+                             if (rc == PLCONFLICT) {
+                                 presp = new DeleteResponseMessage(MessageOriginator::Server,
+                                                                   pmsg->get_txid(),
+                                                                   MsgStatus::CONFLICT);
+                             }
+                             else if (rc) {
                                  presp = new DeleteResponseMessage(MessageOriginator::Server,
                                                                    pmsg->get_txid(),
                                                                    MsgStatus::ERROR);
@@ -182,7 +225,7 @@ int ServerMessageHandler::handle_delete_request(DeleteRequestMessage* pmsg)
                              set_resp_info_from_req(presp, pmsg);
                              presp->build_msg();
                              send_message(presp);
-                         });
+                         }, pmsg->get_deadline(), pmsg->get_expected_version());
     return 0;
 }
 
@@ -191,3 +234,203 @@ int ServerMessageHandler::handle_delete_response(DeleteResponseMessage* pmsg)
     return 0;
 }
 
+int ServerMessageHandler::handle_repair_request(RepairRequestMessage* pmsg)
+{
+    if (pmsg == nullptr) return -1;
+
+    std::string key = pmsg->get_key();
+    size_t       sz = pmsg->get_value_length();
+    std::vector<unsigned char> value(sz);
+
+    pmsg->get_value(value.data(), sz);
+
+    m_store.async_repair(key, pmsg->get_replica_type(), 
+                         value.data(), sz, pmsg->get_version(),
+                         [this, pmsg](int rc) {
+                            if (rc == PLEXPIRED) {
+                                // Coordinator has given up, no response
+                                return;
+                            }
+                            RepairResponseMessage * presp = nullptr;
+                            if (rc) {
+                                presp = new RepairResponseMessage(MessageOriginator::Server,
+                                                                  pmsg->get_txid(),
+                                                                  MsgStatus::ERROR);
+                            }
+                            else {
+                                presp = new RepairResponseMessage(MessageOriginator::Server,
+                                                                  pmsg->get_txid(),
+                                                                  MsgStatus::OK);
+                            }
+                            set_resp_info_from_req(presp, pmsg);
+                            presp->build_msg();
+                            send_message(presp);
+                        }, pmsg->get_deadline());
+    return 0;
+}
+
+int ServerMessageHandler::handle_batch_request(BatchRequestMessage* pmsg)
+{
+    if (pmsg == nullptr) return -1;
+
+    std::vector<StoreMessage* > reqs;
+    std::vector<StoreOp > ops;
+    for (size_t i=0; i<pmsg->get_count(); i++) {
+        size_t sz = 0;
+        unsigned char * raw = pmsg->get_message(i, sz);
+
+        boost::tribool result;
+        StoreMessage * preq = nullptr;
+        tie(result, preq) = m_msgfact.extract(raw, sz);
+        if (!result || (preq == nullptr)) {
+            getlog()->sendlog(LogLevel::ERROR, "Batch request, invalid message %zu\n", i);
+            continue;
+        }
+
+        StoreOp o;
+        o.op           = preq->get_msgtype();
+        o.replica_type = preq->get_replica_type();
+        o.version      = 0;
+        o.expected     = 0;
+        o.deadline     = preq->get_deadline();
+        if (o.op == MsgType::DELETEREQ) {
+            KeyReqMessage * pkey = dynamic_cast<KeyReqMessage*>(preq);
+            o.key      = pkey->get_key();
+            o.expected = pkey->get_expected_version();
+        }
+        else if ((o.op == MsgType::CREATREQ) || (o.op == MsgType::UPDATEREQ) ||
+                 (o.op == MsgType::REPAIRREQ)) {
+            KVReqMessage * pkv = dynamic_cast<KVReqMessage*>(preq);
+            o.key      = pkv->get_key();
+            o.version  = pkv->get_version();
+            o.expected = pkv->get_expected_version();
+            pkv->get_value(o.value);
+        }
+        else {
+            getlog()->sendlog(LogLevel::ERROR, "Batch request, message type not support '%s'\n",
+                              get_desc_msgtype(o.op).c_str());
+            delete preq;
+            continue;
+        }
+        reqs.push_back(preq);
+        ops.push_back(o);
+    }
+
+    m_store.async_batch(std::move(ops), [this, pmsg, reqs](const std::vector<int>& rcs) {
+                            BatchResponseMessage * presp = new BatchResponseMessage(MessageOriginator::Server,
+                                                                                    pmsg->get_txid());
+                            for (size_t i=0; i<reqs.size(); i++) {
+                                // Coordinator has given up the expired ones, no response
+                                StoreMessage * p = (rcs[i] == PLEXPIRED) ? nullptr :
+                                                   construct_batch_resp(reqs[i], rcs[i]);
+                                if (p != nullptr) {
+                                    presp->add_message(p);
+                                    delete p;
+                                }
+                                delete reqs[i];
+                            }
+
+                            if (presp->get_count() == 0) {
+                                delete presp;
+                            }
+                            else {
+                                set_resp_info_from_req(presp, pmsg);
+                                presp->build_msg();
+                                send_message(presp);
+                            }
+                            delete pmsg;
+                        });
+    return 0;
+}
+
+StoreMessage * ServerMessageHandler::construct_batch_resp(const StoreMessage* preq, int rc)
+{
+    MsgStatus status = (rc == 0) ? MsgStatus::OK :
+                       (rc == PLCONFLICT) ? MsgStatus::CONFLICT : MsgStatus::ERROR;
+    StoreMessage * presp = nullptr;
+    switch(preq->get_msgtype()) {
+    case MsgType::CREATREQ:
+        presp = new CreatResponseMessage(MessageOriginator::Server, preq->get_txid(), status);
+        break;
+    case MsgType::UPDATEREQ:
+        presp = new UpdateResponseMessage(MessageOriginator::Server, preq->get_txid(), status);
+        break;
+    case MsgType::REPAIRREQ:
+        presp = new RepairResponseMessage(MessageOriginator::Server, preq->get_txid(), status);
+        break;
+    case MsgType::DELETEREQ:
+        presp = new DeleteResponseMessage(MessageOriginator::Server, preq->get_txid(), status);
+        break;
+    default:
+        return nullptr;
+    }
+
+    presp->set_replica_type(preq->get_replica_type());
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Build batch response failed\n");
+        delete presp;
+        return nullptr;
+    }
+    return presp;
+}
+
+void ServerMessageHandler::handle_connection_close(Connection* pconn)
+{
+    m_watch.remove_watch(pconn);
+}
+
+int ServerMessageHandler::handle_watch_request(WatchRequestMessage* pmsg)
+{
+    if (pmsg == nullptr) return -1;
+
+    Connection_ptr pconn = pmsg->get_connection();
+    if (pconn.get() == nullptr) {
+        getlog()->sendlog(LogLevel::ERROR, "Watch request without connection\n");
+        delete pmsg;
+        return -1;
+    }
+
+    // Coordinator refreshes its watches every membership period, a watch
+    // added again is kept as is
+    m_watch.add_watch(pconn, pmsg->get_txid(), pmsg->get_key(), pmsg->is_prefix());
+
+    WatchResponseMessage * presp = new WatchResponseMessage(MessageOriginator::Server,
+                                                            pmsg->get_txid(),
+                                                            MsgStatus::OK);
+    set_resp_info_from_req(presp, pmsg);
+    delete pmsg;
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Watch response build failed\n");
+        delete presp;
+        return -1;
+    }
+    send_message(presp);
+    return 0;
+}
+
+int ServerMessageHandler::handle_unwatch_request(UnwatchRequestMessage* pmsg)
+{
+    if (pmsg == nullptr) return -1;
+
+    Connection_ptr pconn = pmsg->get_connection();
+    if (pconn.get() == nullptr) {
+        getlog()->sendlog(LogLevel::ERROR, "Unwatch request without connection\n");
+        delete pmsg;
+        return -1;
+    }
+
+    m_watch.remove_watch(pconn.get(), pmsg->get_key(), pmsg->is_prefix());
+
+    UnwatchResponseMessage * presp = new UnwatchResponseMessage(MessageOriginator::Server,
+                                                                pmsg->get_txid(),
+                                                                MsgStatus::OK);
+    set_resp_info_from_req(presp, pmsg);
+    delete pmsg;
+    if (presp->build_msg() != 0) {
+        getlog()->sendlog(LogLevel::ERROR, "Unwatch response build failed\n");
+        delete presp;
+        return -1;
+    }
+    send_message(presp);
+    return 0;
+}
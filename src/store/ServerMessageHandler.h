@@ -18,6 +18,8 @@
 #include "stdinclude.h"
 #include "StoreMessage.h"
 #include "StoreMessageHandler.h"
+#include "StoreMsgFact.h"
+#include "WatchManager.h"
 
 #include <boost/asio.hpp>
 
@@ -41,6 +43,7 @@ public:
                          ConfigPortal * pcfg);
     ~ServerMessageHandler();
 
+    virtual void handle_connection_close(Connection* pconn);
 protected:
     virtual int handle_create_request(CreatRequestMessage* pmsg);
     virtual int handle_create_response(CreatResponseMessage* pmsg);
@@ -54,7 +57,22 @@ protected:
     virtual int handle_delete_request(DeleteRequestMessage* pmsg);
     virtual int handle_delete_response(DeleteResponseMessage* pmsg);
 
+    virtual int handle_repair_request(RepairRequestMessage* pmsg);
+
+    // Watches of coordinators on keys this node holds the primary replica of
+    virtual int handle_watch_request(WatchRequestMessage* pmsg);
+    virtual int handle_unwatch_request(UnwatchRequestMessage* pmsg);
+
+    // Requests of the batch are applied to the store in one pass, and
+    // answered by one batch response
+    virtual int handle_batch_request(BatchRequestMessage* pmsg);
+
+private:
+    // Response of request 'preq' of a batch with store result 'rc'
+    StoreMessage * construct_batch_resp(const StoreMessage* preq, int rc);
 private:
+    StoreMessageFactory   m_msgfact;
+    WatchManager          m_watch;
 };
 
 /*
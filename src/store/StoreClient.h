@@ -17,11 +17,14 @@
  */
 #include <array>
 #include <vector>
+#include <cerrno>
+#include <sys/socket.h>
 #include <boost/asio.hpp>
 
 #include "stdinclude.h"
 #include "StoreMessage.h"
 #include "StoreMsgFact.h"
+#include "StoreStats.h"
 
 /*
  *******************************************************************************
@@ -33,7 +36,9 @@ enum class ClientErrorCode : int {
     GENERIC_ERROR,
     ERROR_INVALID_PARAM,
     ERROR_IO,
-    ERROR_MSG
+    ERROR_MSG,
+    ERROR_TIMEOUT,
+    ERROR_CANCELLED
 };
 
 /*
@@ -42,6 +47,11 @@ enum class ClientErrorCode : int {
  *******************************************************************************
  */
 
+/**
+ * The socket is kept open after a call completes, so that the client can be
+ * pooled by ConnectionManager and reused for following calls to the same
+ * peer. Only one call may be outstanding at a time.
+ */
 class StoreClient {
 public:
    explicit StoreClient(ConfigPortal * pcfg, 
@@ -55,6 +65,50 @@ public:
        m_pcfg->get_message_timeout();
    }
 
+   ~StoreClient() {
+       close();
+   }
+
+   bool is_open() const {
+       return m_sock.is_open();
+   }
+
+   // Idle connection is healthy if the peer hasn't closed it and no
+   // unexpected bytes are pending
+   bool is_healthy() {
+       if (!m_sock.is_open()) {
+           return false;
+       }
+       char c;
+       ssize_t n = ::recv(m_sock.native_handle(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+       return (n < 0) && (errno == EAGAIN || errno == EWOULDBLOCK);
+   }
+
+   void close() {
+       boost::system::error_code ec;
+       m_sock.close(ec);
+       m_rcv_buf.clear();
+   }
+
+   /* HANDLER signature:
+      void (const ClientErrorCode&);
+    */ 
+   template<typename HANDLER> 
+   void async_connect(const boost::asio::ip::tcp::endpoint & ep, 
+                      HANDLER cmpl_handler) {
+       m_sock.async_connect(ep, 
+                            [this, cmpl_handler](const boost::system::error_code& ec) {
+                                if (ec) {
+                                    close();
+                                    cmpl_handler(ClientErrorCode::ERROR_IO);
+                                    return;
+                                }
+                                boost::system::error_code ignore;
+                                m_sock.set_option(boost::asio::ip::tcp::no_delay(true), ignore);
+                                cmpl_handler(ClientErrorCode::SUCCESS);
+                            });
+   }
+
    /* HANDLER signature:
       void (const ClientErrorCode&, StoreMessage*);
     */ 
@@ -68,10 +122,24 @@ public:
            return;
        }
 
-       m_sock.async_connect(ep, 
-                            boost::bind(&StoreClient::handle_connect<HANDLER>, this, 
-                                        boost::asio::placeholders::error, preq,
-                                        cmpl_handler));
+       if (preq->is_expired()) {
+           GetStoreStats()->incr(StatCounter::EXPIRED);
+           cmpl_handler(ClientErrorCode::ERROR_TIMEOUT, nullptr);
+           return;
+       }
+
+       if (m_sock.is_open()) {
+           // Pooled connection, skip connect
+           handle_connect<HANDLER>(boost::system::error_code(), preq, cmpl_handler);
+           return;
+       }
+
+       async_connect(ep, [this, preq, cmpl_handler](const ClientErrorCode& e) {
+                             handle_connect<HANDLER>(e == ClientErrorCode::SUCCESS ? 
+                                                        boost::system::error_code() :
+                                                        boost::asio::error::not_connected,
+                                                     preq, cmpl_handler);
+                         });
    }
 protected:
    template<typename HANDLER> 
@@ -86,6 +154,7 @@ protected:
                                         
         }
         else {
+            close();
             cmpl_handler(ClientErrorCode::ERROR_IO, nullptr);
         }
    }
@@ -97,6 +166,7 @@ protected:
             do_read(cmpl_handler);
         }
         else {
+            close();
             cmpl_handler(ClientErrorCode::ERROR_IO, nullptr);
         }
    }
@@ -112,9 +182,13 @@ protected:
                                       std::copy(m_buf.data(), m_buf.data()+bytes_read, back_inserter(m_rcv_buf));
                                       std::tie(result, presp) = m_msgfact.extract(m_rcv_buf.data(), m_rcv_buf.size());
                                       if (result) {
+                                          // Keep the bytes following the response for next call
+                                          m_rcv_buf.erase(m_rcv_buf.begin(), 
+                                                          m_rcv_buf.begin() + presp->get_size());
                                           cmpl_handler(ClientErrorCode::SUCCESS, presp);
                                       }
                                       else if (!result) {
+                                          close();
                                           cmpl_handler(ClientErrorCode::ERROR_MSG, nullptr);
                                       }
                                       else {
@@ -122,6 +196,7 @@ protected:
                                       }
                                   }
                                   else {
+                                      close();
                                       cmpl_handler(ClientErrorCode::ERROR_IO, nullptr);
                                   }
                               });
@@ -42,15 +42,18 @@ using namespace boost::asio;
 StoreManager::StoreManager(io_service & io,
                            MemberList * pmemlst,
                            ConfigPortal * pcfg) :
-   m_store(),
+   m_store(pcfg->get_change_feed_size()),
    m_store_acc(io, m_store),
    m_pmember(pmemlst),
    m_pconfig(pcfg),
    m_ring(),
-   m_has_my_replicas(),
-   m_has_replicas_of(),
+   m_tokens(std::make_shared<TokenRing >()),
+   m_ring_listeners(),
+   m_member_listeners(),
    m_ring_strand(io),
-   m_clnt_strand(io)
+   m_clnt_strand(io),
+   m_watcher(),
+   m_watch_stop(false)
 {
     string self_ip(m_pconfig->get_bindip());                                   
  
@@ -72,21 +75,58 @@ StoreManager::StoreManager(io_service & io,
 
 StoreManager::~StoreManager()
 {
+    m_watch_stop = true;
+    if (m_watcher.joinable()) {
+        m_watcher.join();
+    }
 }
 
-void StoreManager :: update_ring()
+void StoreManager::start_member_watch()
 {
-    // TODO: MemberList is updated by Membership protocol (another process)
-    //       so the access should be protected by a lock
-
-    std::vector< MemberEntry > cur_memlist;
+    m_watcher = std::thread([this]() { watch_members(); });
+}
 
-    // !!! TODO: LOCK member list !!! 
-    //std::copy(m_pmember->begin(), m_pmember->end(), std::back_inserter( cur_memlist));
-    for (auto&& m : *m_pmember) {
-        cur_memlist.push_back(m);
+void StoreManager::watch_members()
+{
+    uint32 seen = m_pmember->get_generation();
+    update_ring();
+    while (!m_watch_stop) {
+        // Wakes up now and then to check for stop
+        uint32 gen = m_pmember->wait_generation(seen, KV_MEMBER_WATCH_DEF_WAIT);
+        if (gen != seen) {
+            getlog()->sendlog(LogLevel::DEBUG, "Members changed, generation %u\n", gen);
+            seen = gen;
+            update_ring();
+        }
     }
-    // !!! UNLOCK here !!!
+}
+
+vector<MemberEntry > StoreManager::copy_members() const
+{
+    vector<MemberEntry > members;
+    uint32 seq;
+    do {
+        seq = m_pmember->read_seqbegin();
+        members.clear();
+        for (auto&& m : *m_pmember) {
+            members.push_back(m);
+        }
+    } while (m_pmember->read_seqretry(seq));
+    return members;
+}
+
+void StoreManager::update_members()
+{
+    vector<MemberEntry > cur_memlist = copy_members();
+    m_ring_strand.post([this, cur_memlist]() {
+        for (auto&& l : m_member_listeners) {
+            l(cur_memlist);
+        }});
+}
+
+void StoreManager :: update_ring()
+{
+    std::vector< MemberEntry > cur_memlist = copy_members();
 
     m_ring_strand.post([this, cur_memlist]() {
         bool change = false;
@@ -107,109 +147,59 @@ void StoreManager :: update_ring()
             m_ring.clear();
             std::copy(cur_memlist.begin(), cur_memlist.end(), std::back_inserter(m_ring));
             //m_ring = cur_memlist;
+            // Requests keep routing by the old ring until the new one is
+            // published
+            std::shared_ptr<TokenRing > tokens = std::make_shared<TokenRing >();
+            tokens->build(m_ring, m_pconfig->get_ring_vnodes());
+            std::atomic_store(&m_tokens, std::shared_ptr<const TokenRing >(tokens));
             // run stablization protocol
-            stabilization_protocol();
+            stabilization_protocol(tokens);
+
+            for (auto&& l : m_ring_listeners) {
+                l(m_ring);
+            }
+        }
+
+        for (auto&& l : m_member_listeners) {
+            l(cur_memlist);
         }});
 }
 
 vector<struct MemberEntry > StoreManager :: get_nodes(const string& key)
 {
-    vector<struct MemberEntry > v;
-
-    std::hash<string> hashfunc;
-    size_t hash_code = hashfunc(key);
-  
-    if (m_ring.size() == 0) return v;
- 
-    long long pos = hash_code % m_pconfig->get_ringsize();
-
-    // !!! TODO: LOCK !!!   
-    size_t node_cnt = m_ring.size();
-    if (node_cnt >= PLUTO_NODE_REPLICAS_NUM) {
-        size_t i = 0;
-        if (pos > m_ring[node_cnt-1].hashcode % m_pconfig->get_ringsize()) {
-            i = 0;
-        } else {
-            for (i=0; i<node_cnt; i++) {
-                if (pos <= m_ring[i].hashcode % m_pconfig->get_ringsize()) {
-                    // push back
-                    break;
-                }
-            }
-        }
-        for (; v.size()<PLUTO_NODE_REPLICAS_NUM; i++) {
-            v.push_back(m_ring[i%node_cnt]);
-        }
-    }
-  
-    return v;
+    return get_ring_snapshot()->get_nodes(key);
 }
 
-void StoreManager::stabilization_protocol()
+void StoreManager::stabilization_protocol(std::shared_ptr<const TokenRing > ring)
 {
-    // stabilization protocol is called by ring stand,
-    // no need to 'lock'
-    size_t i; 
-    bool change = false;
-    vector<MemberEntry > l;
-    vector<MemberEntry > r;
-
-    find_neighbors(l, r);
-
-    for (i=0; i<m_has_replicas_of.size(); i++) {
-        if (i>=PLUTO_NODE_REPLICAS_NUM) break;
-        if (!is_node_in_ring(m_has_replicas_of[i])) {
-            // Node leave 
-            handle_neighbor_leave(m_has_replicas_of[i], PLUTO_NODE_REPLICAS_NUM-i);
-        }
-    }
-
-    change = false;
-    for (i=0; i<PLUTO_NODE_REPLICAS_NUM; i++) {
-        if (i>=m_has_replicas_of.size()) { 
-            change = true;
-            break;
-        }
-        if (m_has_replicas_of[i] != l[i]) {
-            // left neighbor changes 
-            change = true;
-            remove_left_neighbor_replicas(PLUTO_NODE_REPLICAS_NUM-i);
-        }
-    }
-
-    if (change) {
-        m_has_replicas_of.swap(l);
-    }
- 
-    change = false;
-    for (i=0; i<PLUTO_NODE_REPLICAS_NUM; i++) {
-        if (i>=m_has_my_replicas.size()) { 
-            change = true;
-            break;
-        }
-        if (m_has_my_replicas[i] != r[i]) {
-            // right neighbor changes
-            change = true;
-            send_right_neighbor_replicas(r[i], 0); // 0 is PRIMARY
-        }
-    } 
-
-    if (change) {
-        m_has_my_replicas.swap(r);
-    }
+    // Ownership of every key comes from the new ring, replica type of a key
+    // is its place in the key's replica list. Keys this node no longer
+    // holds a replica of are kept, nothing hands them to the new owners yet
+    MemberEntry self = get_self();
+    m_store_acc.async_rebalance([ring, self](const string& key) {
+            vector<MemberEntry > rep = ring->get_nodes(key);
+            for (size_t i=0; i<rep.size(); i++) {
+                if (rep[i] == self) {
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        },
+        [](int rc, size_t moved, size_t unowned) {
+            if (rc != 0) {
+                getlog()->sendlog(LogLevel::ERROR, "Stabilization, rebalance failed, rc=%d\n", rc);
+                return;
+            }
+            getlog()->sendlog(LogLevel::INFO, "Stabilization, %lu keys moved, %lu keys not owned kept\n",
+                              moved, unowned);
+        });
 }
 
-void StoreManager::find_neighbors(std::vector<MemberEntry >& left,
-                                  std::vector<MemberEntry >& right)
+MemberEntry StoreManager::get_self() const
 {
-    if (m_ring.size() < PLUTO_NODE_REPLICAS_NUM) {
-        getlog()->sendlog(LogLevel::INFO, "Find neighbors, not enough nodes\n");
-        return;
-    }
-
     struct MemberEntry self;
-                                                                                                  
-    memset(&self, 0, sizeof(self));                                                               
+
+    memset(&self, 0, sizeof(self));
     self.af = m_self_af;
     if (self.af == AF_INET) {
         memcpy(self.address, m_self_rawip, PL_IPv4_ADDR_LEN);
@@ -220,72 +210,6 @@ void StoreManager::find_neighbors(std::vector<MemberEntry >& left,
     self.type       = SOCK_STREAM;
     self.portnumber = m_self_port;
 
-    int ring_sz  = m_ring.size();
-    int i=0;
-    int self_idx = -1;
-
-    for (;i<ring_sz; i++) {
-        if (self == m_ring[i]) {
-            self_idx = i;
-            break;
-        }
-    }
-
-    if (self_idx<0) {
-        getlog()->sendlog(LogLevel::FATAL, "Find neighbors, self node is not in member\n");
-        return;
-    }
-
-    for (i=1; i<PLUTO_NODE_REPLICAS_NUM; i++) {
-        int idx = (self_idx + i) % ring_sz;
-        right.push_back((*m_pmember)[idx]);
-    }
-
-    for (i=1; i<PLUTO_NODE_REPLICAS_NUM; i++) {
-        int idx = (self_idx - PLUTO_NODE_REPLICAS_NUM + i + ring_sz) % ring_sz;
-        left.push_back((*m_pmember)[idx]);
-    }
-}
-
-bool StoreManager::is_node_in_ring(const MemberEntry& node)
-{
-    for (auto& n : m_ring) {
-        if (n==node) {
-            return true;
-        }
-    }
-    return false;
-}
-
-void StoreManager::handle_neighbor_leave(const MemberEntry& node, int replica_type)
-{
-    // left neighbor remove, send data owned by that node to new members
-    // multiple nodes may detect, thus the data maybe added multiple times
-    m_store_acc.async_get(replica_type, true,
-                          [this](int rc, map<string, vector<unsigned char> >& v) {
-            // I hate use asynchronous way this much
-            for (auto& it : v) {
-                vector<MemberEntry > rep = get_nodes(it.first);
-                // send data to target replicas 
-            }
-        });
-}
-
-void StoreManager::remove_left_neighbor_replicas(int replica_type)
-{
-    m_store_acc.async_delete(replica_type, [](int rc) {
-        (void)rc;
-    });
-}
-
-void StoreManager::send_right_neighbor_replicas(const MemberEntry& node, int replica_type)
-{
-    m_store_acc.async_get(0, true,
-                          [=](int rc, map<string, vector<unsigned char> >& v) {
-            // I hate use asynchronous way this much
-            for (auto it : v) {
-                // send data to node as replica_type 
-            }
-        });
+    return self;
 }
 
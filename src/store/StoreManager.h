@@ -21,9 +21,13 @@
 #include "KVStoreAccess.h"
 #include "memberlist.h"
 #include "ClientTransaction.h"
+#include "TokenRing.h"
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
 #include <functional>
 
 #include <boost/asio.hpp>
@@ -42,98 +46,130 @@
 
 class StoreManager {
 public:
+    typedef std::function<void(const std::vector<MemberEntry >&)> RING_LISTENER;
+
     StoreManager(boost::asio::io_service & io,
                  MemberList * pmemlst,
                  ConfigPortal * pcfg);
     ~StoreManager();
 
+    // Ring is rebuilt as soon as membership process changes the members,
+    // call after the listeners are added
+    void start_member_watch();
+
     void update_ring();
+    // Member listeners only, heartbeats of members are changed without
+    // waking the watcher
+    void update_members();
+
+    // Must be called before server runs, listener is called by ring strand
+    // with the new ring when it changes
+    void add_ring_listener(RING_LISTENER listener) {
+        m_ring_listeners.push_back(listener);
+    }
 
+    // Must be called before server runs, listener is called by ring strand
+    // with the member list of every update, heartbeats included
+    void add_member_listener(RING_LISTENER listener) {
+        m_member_listeners.push_back(listener);
+    }
+
+    // 'hash_code' is get_key_hash() of the key. Ring is read from the
+    // snapshot in calling thread, handler is called before return
     template<typename H >
-    void async_get_nodes(const std::string& key, H handler ) {
-        std::hash<std::string> hashfunc;
-        size_t hash_code = hashfunc(key);
-        m_ring_strand.post([this, hash_code, handler]() {
-                              std::vector< MemberEntry > v;
-                              if (m_ring.size() == 0) {
-                                  handler(v);
-                                  return;
-                              }
-                              size_t pos = hash_code % m_pconfig->get_ringsize();
-                              size_t node_cnt = m_ring.size();
-                              if (node_cnt >= PLUTO_NODE_REPLICAS_NUM) {
-                                  int i = 0;
-                                  if (pos > m_ring[node_cnt-1].hashcode % m_pconfig->get_ringsize()) {
-                                      i=0;
-                                  } else {
-                                      for (i=0; i<node_cnt; i++) {
-                                          if (pos <= m_ring[i].hashcode % m_pconfig->get_ringsize()) {
-                                              // push back
-                                              break;
-                                          }
-                                      }
-                                  }
-                              }
-                              handler(v);
-                           });
+    void async_get_nodes(uint64 hash_code, H handler ) {
+        handler(get_ring_snapshot()->get_nodes(hash_code));
+    }
+
+    // Current ring, never changed once published; a ring change publishes
+    // a new one. Can be called from any thread
+    std::shared_ptr<const TokenRing > get_ring_snapshot() const {
+        return std::atomic_load(&m_tokens);
     }
 
     template<typename RD_HANDLER > 
     void async_read(const std::string& key, int replica_type,
-                    RD_HANDLER handler) {
-        m_store_acc.async_read(key, replica_type, handler);
+                    RD_HANDLER handler, int64 deadline = 0) {
+        m_store_acc.async_read(key, replica_type, handler, deadline);
     }
 
     template<typename WR_HANDLER > 
     void async_creat(const std::string& key, int replica_type,
                      const unsigned char* value, const size_t sz,
-                     WR_HANDLER handler) {
-        m_store_acc.async_write(key, replica_type, value, sz, handler);
+                     uint64 version,
+                     WR_HANDLER handler, int64 deadline = 0) {
+        m_store_acc.async_write(key, replica_type, value, sz, version, handler, deadline);
     }
 
     template<typename UP_HANDLER > 
     void async_update(const std::string& key, int replica_type,
                       const unsigned char* value, const size_t sz,
-                      UP_HANDLER handler) {
-        m_store_acc.async_update(key, replica_type, value, sz, handler);
+                      uint64 version,
+                      UP_HANDLER handler, int64 deadline = 0,
+                      uint64 expected = 0) {
+        m_store_acc.async_update(key, replica_type, value, sz, version, handler, deadline, expected);
+    }
+
+    template<typename RP_HANDLER > 
+    void async_repair(const std::string& key, int replica_type,
+                      const unsigned char* value, const size_t sz,
+                      uint64 version,
+                      RP_HANDLER handler, int64 deadline = 0) {
+        m_store_acc.async_repair(key, replica_type, value, sz, version, handler, deadline);
     }
 
     template<typename DEL_HANDLER > 
     void async_delete(const std::string& key, int replica_type,
-                      DEL_HANDLER handler) {
-        m_store_acc.async_delete(key, replica_type, handler);
+                      DEL_HANDLER handler, int64 deadline = 0,
+                      uint64 expected = 0) {
+        m_store_acc.async_delete(key, replica_type, handler, deadline, expected);
     }
 
-    // Synchronous operations, which is NOT supported
+    template<typename BT_HANDLER >
+    void async_batch(std::vector<StoreOp> ops, BT_HANDLER handler) {
+        m_store_acc.async_batch(std::move(ops), handler);
+    }
+
+    template<typename FEED_HANDLER >
+    void async_read_changes(uint64 from_seq, size_t max,
+                            FEED_HANDLER handler) {
+        m_store_acc.async_read_changes(from_seq, max, handler);
+    }
+
+    // Must be called before server runs, listener is called by store strand
+    void add_change_listener(KVStore::CHANGE_LISTENER listener) {
+        m_store.add_change_listener(listener);
+    }
+
+    // Synchronous operations, run by caller's thread under the store lock
     int sync_read(const std::string& key, int replica_type,
-                  unsigned char* value, size_t & sz) {
-        return PLERROR;
+                  std::vector<unsigned char>& value, uint64& version) {
+        return m_store_acc.sync_read(key, replica_type, value, version);
     }
     int sync_create(const std::string& key, int replica_type,
-                    const unsigned char* value, 
-                    const size_t & sz) {
-        return PLERROR;
+                    const unsigned char* value, const size_t sz,
+                    uint64 version) {
+        return m_store_acc.sync_write(key, replica_type, value, sz, version);
     }
     int sync_update(const std::string& key, int replica_type,
-                    const unsigned char* value, 
-                    const size_t & sz) {
-        return PLERROR;
+                    const unsigned char* value, const size_t sz,
+                    uint64 version, uint64 expected = 0) {
+        return m_store_acc.sync_update(key, replica_type, value, sz, version, expected);
     }
-    int sync_delete(const std::string& key, int replica_type) {
-        return PLERROR;
+    int sync_delete(const std::string& key, int replica_type, uint64 expected = 0) {
+        return m_store_acc.sync_delete(key, replica_type, expected);
     }
 private:
+    // Consistent copy of the member list in shared memory
+    std::vector<MemberEntry > copy_members() const;
+    // Member watcher thread
+    void watch_members();
+
     // Following functions are called by ring strand!!!
     std::vector<struct MemberEntry > get_nodes(const std::string& key );
-    void stabilization_protocol();
-
-    void find_neighbors(std::vector<MemberEntry >& left, 
-                        std::vector<MemberEntry >& right);
-    bool is_node_in_ring(const MemberEntry& node);
-
-    void handle_neighbor_leave(const MemberEntry& node, int replica_type);
-    void remove_left_neighbor_replicas(int replica_type);
-    void send_right_neighbor_replicas(const MemberEntry& node, int replica_type);
+    // Moves stored keys to the replica types the new ring gives
+    void stabilization_protocol(std::shared_ptr<const TokenRing > ring);
+    MemberEntry get_self() const;
 private:
     KVStore               m_store;
     KVStoreAsyncAccessor  m_store_acc;
@@ -141,14 +177,17 @@ private:
     ConfigPortal *        m_pconfig;
 
     std::vector<MemberEntry > m_ring;
-
-    // For stablization protocol
-    std::vector<MemberEntry > m_has_my_replicas;
-    std::vector<MemberEntry > m_has_replicas_of;
+    // Read by atomic_load, replaced by atomic_store only
+    std::shared_ptr<const TokenRing > m_tokens;
+    std::vector<RING_LISTENER > m_ring_listeners;
+    std::vector<RING_LISTENER > m_member_listeners;
 
     boost::asio::io_service::strand m_ring_strand;
     boost::asio::io_service::strand m_clnt_strand;
 
+    std::thread                     m_watcher;
+    std::atomic<bool >              m_watch_stop;
+
     // self address
     int            m_self_af;                                                            
     unsigned char  m_self_rawip[PL_IPv6_ADDR_LEN];                                       
@@ -21,6 +21,7 @@
 #include "stdinclude.h"
 #include "messages.h"
 #include "plexcept.h"
+#include "util.h"
 
 /**
  *******************************************************************************
@@ -63,6 +64,8 @@ public:
         Message(buf, sz, managebuf), 
         m_txid(-1),
         m_replica_type(-1),
+        m_deadline(0),
+        m_tenant(0),
         m_originator(MessageOriginator::Client),
         m_pconn(nullptr) {
     };
@@ -75,6 +78,8 @@ public:
        Message(type, version, magic), 
        m_txid(txid),
        m_replica_type(-1),
+       m_deadline(0),
+       m_tenant(0),
        m_originator(originator),
        m_pconn(nullptr)
     {
@@ -112,6 +117,46 @@ public:
         return m_replica_type;
     }
 
+    // Absolute deadline, see get_deadline_now(). Each stage drops the message
+    // once it passes, 0 means no deadline
+    void set_deadline(int64 deadline) {
+        m_deadline = deadline;
+    }
+
+    int64 get_deadline() const {
+        return m_deadline;
+    }
+
+    bool is_expired() const {
+        return is_deadline_passed(m_deadline);
+    }
+
+    // Tenant or keyspace the request is charged to, 0 is the default one
+    void set_tenant(int32 tenant) {
+        m_tenant = tenant;
+    }
+
+    int32 get_tenant() const {
+        return m_tenant;
+    }
+
+    // CRUD request of a client, which is subject to admission and fair
+    // scheduling
+    bool is_client_request() const {
+        if (m_originator != MessageOriginator::Client) {
+            return false;
+        }
+        switch(get_msgtype()) {
+        case MsgType::CREATREQ:
+        case MsgType::READREQ:
+        case MsgType::UPDATEREQ:
+        case MsgType::DELETEREQ:
+            return true;
+        default:
+            return false;
+        }
+    }
+
     void set_connection(std::shared_ptr<Connection > pconn) {
         m_pconn = pconn;
     }
@@ -132,7 +177,9 @@ public:
     int build_msg_body(unsigned char* buf, size_t sz) {
         // format: int64 -- txid
         //         int32 -- originator
-        //         int32 -- reserved 
+        //         int32 -- replica type
+        //         int64 -- deadline
+        //         int32 -- tenant
         if (buf == nullptr) {
             getlog()->sendlog(LogLevel::ERROR, "Store message, build body nullptr received\n");
             return -1;
@@ -156,6 +203,13 @@ public:
         memcpy(buf, &ival, sizeof(int32));
         buf += sizeof(int32);
 
+        network_write_int64(buf, m_deadline);
+        buf += sizeof(int64);
+
+        ival = htonl(m_tenant);
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
         return build_storemsg_body(buf, sz - get_storemsg_hdrsize());
     }
 
@@ -192,6 +246,13 @@ public:
 
         m_replica_type = ival;
 
+        m_deadline = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        memcpy(&ival, buf, sizeof(int32));
+        m_tenant = ntohl(ival);
+        buf += sizeof(int32);
+
         parse_storemsg_body(buf, sz - get_storemsg_hdrsize());
     }
 
@@ -203,7 +264,7 @@ public:
     }
 
     size_t get_storemsg_hdrsize() const {
-        return sizeof(int64) + sizeof(int32)*2;
+        return sizeof(int64)*2 + sizeof(int32)*3;
     }
 
     virtual size_t get_storemsg_bodysize() const = 0;
@@ -212,6 +273,8 @@ public:
                    bool verbose=false) const {
         output("Originator   : '%s'", get_originator_desc(m_originator).c_str());
         output("TransactionId: '%ld'", m_txid);
+        output("Deadline     : '%ld'", m_deadline);
+        output("Tenant       : '%d'", m_tenant);
         dump_storemsg_body(output, verbose);
     }
     virtual void dump_storemsg_body(int (*output)(const char*, ...)=printf,
@@ -240,13 +303,16 @@ protected:
         memcpy(&ival2, buf, sizeof(int32));
         ival2 = ntohl(ival2);
 
+        // Low word must not be sign extended
         int64 lval = ival1;
-        lval = lval<<32 | ival2;
+        lval = lval<<32 | static_cast<uint32>(ival2);
         return lval;
     }
 private:
     int64               m_txid;
     int32               m_replica_type;
+    int64               m_deadline;
+    int32               m_tenant;
     MessageOriginator   m_originator;
     std::shared_ptr<Connection > m_pconn;
 };
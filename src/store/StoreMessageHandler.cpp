@@ -19,11 +19,15 @@
 #include "ReadMessage.h"
 #include "UpdateMessage.h"
 #include "DeleteMessage.h"
+#include "FeedMessage.h"
+#include "WatchMessage.h"
+#include "RepairMessage.h"
 
 #include "StoreMessageHandler.h"
 #include "ClientMessageHandler.h"
 #include "ServerMessageHandler.h"
 #include "ConnectionManager.h"
+#include "FairScheduler.h"
 
 #include <cstring>
 
@@ -55,16 +59,23 @@ StoreMessageHandler::StoreMessageHandler(io_service & io,
    m_conn_mgr(conn_mgr),
    m_store(store),
    m_io(io),
-   m_pconfig(pcfg)
+   m_pconfig(pcfg),
+   m_phdler_client(nullptr),
+   m_phdler_server(nullptr),
+   m_scheduler(nullptr)
 {
     if (creat_child) {
-        m_phdler_client = new ClientMessageHandler(io, conn_mgr, store, pcfg);
+        m_scheduler = new FairScheduler(io, pcfg, [this](StoreMessage* pmsg) {
+                                                      dispatch_message(pmsg);
+                                                  });
+        m_phdler_client = new ClientMessageHandler(io, conn_mgr, store, pcfg, m_scheduler);
         m_phdler_server = new ServerMessageHandler(io, conn_mgr, store, pcfg);
     }
 
     string self_ip(m_pconfig->get_bindip());                                   
  
     m_self_port = m_pconfig->get_bindport();                                             
+    m_self_zone = m_pconfig->get_zone();
     m_self_addr = ip::address::from_string(self_ip);
 
     memset(m_self_rawip, '\0', PL_IPv6_ADDR_LEN); 
@@ -83,6 +94,9 @@ StoreMessageHandler::StoreMessageHandler(io_service & io,
 
 StoreMessageHandler::~StoreMessageHandler()
 {
+    if (m_scheduler != nullptr) {
+        delete m_scheduler;
+    }
     if (m_phdler_client != nullptr) {
         delete m_phdler_client;
     }
@@ -100,12 +114,21 @@ int StoreMessageHandler :: handle_message(StoreMessage * pmsg)
         return -1;
     }
 
+    if ((m_scheduler != nullptr) && pmsg->is_client_request()) {
+        m_scheduler->submit(pmsg);
+        return 0;
+    }
+    return dispatch_message(pmsg);
+}
+
+int StoreMessageHandler::dispatch_message(StoreMessage * pmsg)
+{
     StoreMessageHandler * phdler = nullptr;
     if (pmsg->get_originator() == MessageOriginator::Client) {
         phdler = m_phdler_client;
     }
     else if (pmsg->get_originator() == MessageOriginator::Server) {
-        phdler = m_phdler_client;
+        phdler = m_phdler_server;
     }
     else {
         getlog()->sendlog(LogLevel::ERROR, "StoreMessageHandler: invalid message originator");
@@ -145,6 +168,21 @@ int StoreMessageHandler :: handle_message(StoreMessage * pmsg)
     case MsgType::DELETERESP:
         ret = phdler->handle_delete_response(dynamic_cast<DeleteResponseMessage*>(pmsg));
         break;
+    case MsgType::FEEDREQ:
+        ret = phdler->handle_feed_request(dynamic_cast<FeedRequestMessage*>(pmsg));
+        break;
+    case MsgType::WATCHREQ:
+        ret = phdler->handle_watch_request(dynamic_cast<WatchRequestMessage*>(pmsg));
+        break;
+    case MsgType::UNWATCHREQ:
+        ret = phdler->handle_unwatch_request(dynamic_cast<UnwatchRequestMessage*>(pmsg));
+        break;
+    case MsgType::REPAIRREQ:
+        ret = phdler->handle_repair_request(dynamic_cast<RepairRequestMessage*>(pmsg));
+        break;
+    case MsgType::BATCHREQ:
+        ret = phdler->handle_batch_request(dynamic_cast<BatchRequestMessage*>(pmsg));
+        break;
     default:
         // Invalid message received
         getlog()->sendlog(LogLevel::ERROR, "Message type not support '%s'\n", get_desc_msgtype(msgtype).c_str());
@@ -156,8 +194,22 @@ int StoreMessageHandler :: handle_message(StoreMessage * pmsg)
 
 void StoreMessageHandler::handle_time_event()
 {
-    m_phdler_client->handle_time_event();
-    m_phdler_server->handle_time_event();
+    if (m_phdler_client != nullptr) {
+        m_phdler_client->handle_time_event();
+    }
+    if (m_phdler_server != nullptr) {
+        m_phdler_server->handle_time_event();
+    }
+}
+
+void StoreMessageHandler::handle_connection_close(Connection* pconn)
+{
+    if (m_phdler_client != nullptr) {
+        m_phdler_client->handle_connection_close(pconn);
+    }
+    if (m_phdler_server != nullptr) {
+        m_phdler_server->handle_connection_close(pconn);
+    }
 }
 
 bool StoreMessageHandler::is_self(const struct MemberEntry& e)
@@ -259,4 +311,34 @@ int StoreMessageHandler::handle_delete_response(DeleteResponseMessage* pmsg)
     return PLERROR;
 }
 
+int StoreMessageHandler::handle_feed_request(FeedRequestMessage* pmsg)
+{
+    getlog()->sendlog(LogLevel::FATAL, "Fatal error, store message handler got called\n");
+    return PLERROR;
+}
+
+int StoreMessageHandler::handle_watch_request(WatchRequestMessage* pmsg)
+{
+    getlog()->sendlog(LogLevel::FATAL, "Fatal error, store message handler got called\n");
+    return PLERROR;
+}
+
+int StoreMessageHandler::handle_unwatch_request(UnwatchRequestMessage* pmsg)
+{
+    getlog()->sendlog(LogLevel::FATAL, "Fatal error, store message handler got called\n");
+    return PLERROR;
+}
+
+int StoreMessageHandler::handle_repair_request(RepairRequestMessage* pmsg)
+{
+    getlog()->sendlog(LogLevel::FATAL, "Fatal error, store message handler got called\n");
+    return PLERROR;
+}
+
+int StoreMessageHandler::handle_batch_request(BatchRequestMessage* pmsg)
+{
+    getlog()->sendlog(LogLevel::FATAL, "Fatal error, store message handler got called\n");
+    return PLERROR;
+}
+
 /* eof */
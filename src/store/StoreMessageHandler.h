@@ -32,6 +32,8 @@
  */
 
 class ConnectionManager;
+class Connection;
+class FairScheduler;
 
 /*
  *******************************************************************************
@@ -48,14 +50,19 @@ public:
                         bool creat_child = false);
     virtual ~StoreMessageHandler();
 
+    // Client requests are queued by tenant before they are handled
     virtual int handle_message(StoreMessage* pmsg);
 
+    // 'key_hash' is get_key_hash() of the key, see KVReqMessage
     template<typename H>
-    void async_find_nodes(const std::string& key, H handler) {
-        m_store.async_get_nodes<H>(key, handler);
+    void async_find_nodes(uint64 key_hash, H handler) {
+        m_store.async_get_nodes<H>(key_hash, handler);
     }
 
     virtual void handle_time_event();
+
+    // Connection is going to be closed, drop state kept for it
+    virtual void handle_connection_close(Connection* pconn);
 protected:
     bool is_self(const struct MemberEntry& e);
 
@@ -78,6 +85,15 @@ protected:
 
     virtual int handle_delete_request(DeleteRequestMessage* pmsg);
     virtual int handle_delete_response(DeleteResponseMessage* pmsg);
+
+    virtual int handle_feed_request(FeedRequestMessage* pmsg);
+
+    virtual int handle_watch_request(WatchRequestMessage* pmsg);
+    virtual int handle_unwatch_request(UnwatchRequestMessage* pmsg);
+
+    virtual int handle_repair_request(RepairRequestMessage* pmsg);
+
+    virtual int handle_batch_request(BatchRequestMessage* pmsg);
 protected:
     ConnectionManager&    m_conn_mgr;
     StoreManager &        m_store;
@@ -91,10 +107,14 @@ protected:
     int            m_self_af;                                                            
     unsigned char  m_self_rawip[PL_IPv6_ADDR_LEN];                                       
     unsigned short m_self_port; 
+    uint16         m_self_zone;
 
+private:
+    int dispatch_message(StoreMessage* pmsg);
 private:
     StoreMessageHandler * m_phdler_client;
     StoreMessageHandler * m_phdler_server;
+    FairScheduler *       m_scheduler;
 
     //std::map<unsigned long long, ClientTransaction* > m_pending_tran;
 };
@@ -19,6 +19,10 @@
 #include "ReadMessage.h"
 #include "UpdateMessage.h"
 #include "DeleteMessage.h"
+#include "FeedMessage.h"
+#include "WatchMessage.h"
+#include "RepairMessage.h"
+#include "BatchMessage.h"
 
 #include "StoreMsgFact.h"
 
@@ -54,33 +58,71 @@ std::tuple<boost::tribool, StoreMessage* >
     try {
         std::tie(result, msglen, msgtype) = try_parse(buf, size);
         if (result) {
+            // The message keeps its own copy, the receive buffer is reused
+            // for following messages
+            unsigned char * pbuf = new unsigned char[msglen];
+            memcpy(pbuf, buf, msglen);
             switch(msgtype) {
             case MsgType::CREATREQ:
-                pmsg = new CreatRequestMessage(buf, msglen, false);
+                pmsg = new CreatRequestMessage(pbuf, msglen, true);
                 break;
             case MsgType::CREATRESP:
-                pmsg = new CreatResponseMessage(buf, msglen, false);
+                pmsg = new CreatResponseMessage(pbuf, msglen, true);
                 break;
             case MsgType::READREQ:
-                pmsg = new ReadRequestMessage(buf, msglen, false);
+                pmsg = new ReadRequestMessage(pbuf, msglen, true);
                 break;
             case MsgType::READRESP:
-                pmsg = new ReadResponseMessage(buf, msglen, false);
+                pmsg = new ReadResponseMessage(pbuf, msglen, true);
                 break;
             case MsgType::UPDATEREQ:
-                pmsg = new UpdateRequestMessage(buf, msglen, false);
+                pmsg = new UpdateRequestMessage(pbuf, msglen, true);
                 break;
             case MsgType::UPDATERESP:
-                pmsg = new UpdateResponseMessage(buf, msglen, false);
+                pmsg = new UpdateResponseMessage(pbuf, msglen, true);
                 break;
             case MsgType::DELETEREQ:
-                pmsg = new DeleteRequestMessage(buf, msglen, false);
+                pmsg = new DeleteRequestMessage(pbuf, msglen, true);
                 break;
             case MsgType::DELETERESP:
-                pmsg = new DeleteResponseMessage(buf, msglen, false);
+                pmsg = new DeleteResponseMessage(pbuf, msglen, true);
+                break;
+            case MsgType::FEEDREQ:
+                pmsg = new FeedRequestMessage(pbuf, msglen, true);
+                break;
+            case MsgType::FEEDRESP:
+                pmsg = new FeedResponseMessage(pbuf, msglen, true);
+                break;
+            case MsgType::WATCHREQ:
+                pmsg = new WatchRequestMessage(pbuf, msglen, true);
+                break;
+            case MsgType::WATCHRESP:
+                pmsg = new WatchResponseMessage(pbuf, msglen, true);
+                break;
+            case MsgType::UNWATCHREQ:
+                pmsg = new UnwatchRequestMessage(pbuf, msglen, true);
+                break;
+            case MsgType::UNWATCHRESP:
+                pmsg = new UnwatchResponseMessage(pbuf, msglen, true);
+                break;
+            case MsgType::WATCHNOTIFY:
+                pmsg = new WatchNotifyMessage(pbuf, msglen, true);
+                break;
+            case MsgType::REPAIRREQ:
+                pmsg = new RepairRequestMessage(pbuf, msglen, true);
+                break;
+            case MsgType::REPAIRRESP:
+                pmsg = new RepairResponseMessage(pbuf, msglen, true);
+                break;
+            case MsgType::BATCHREQ:
+                pmsg = new BatchRequestMessage(pbuf, msglen, true);
+                break;
+            case MsgType::BATCHRESP:
+                pmsg = new BatchResponseMessage(pbuf, msglen, true);
                 break;
             default:
                 // Invalid message received
+                delete [] pbuf;
                 pmsg = nullptr;
                 result = false;
                 getlog()->sendlog(LogLevel::ERROR, "Message type not support '%s'\n", get_desc_msgtype(msgtype).c_str());
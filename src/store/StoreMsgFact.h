@@ -22,6 +22,10 @@
 #include "ReadMessage.h"
 #include "UpdateMessage.h"
 #include "DeleteMessage.h"
+#include "FeedMessage.h"
+#include "WatchMessage.h"
+#include "RepairMessage.h"
+#include "BatchMessage.h"
 
 #include <tuple>
 #include <boost/logic/tribool.hpp>
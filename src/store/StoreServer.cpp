@@ -23,6 +23,8 @@
 #include <boost/asio.hpp>
 #include "StoreServer.h"
 #include "KVMessage.h"
+#include "StoreStats.h"
+#include "AdmissionController.h"
 
 using namespace boost::asio;
 using namespace std;
@@ -49,12 +51,13 @@ StoreServer::StoreServer(ConfigPortal * pcfg,
    m_signals(m_io),
    m_acceptor(m_io),
    m_new_sock(m_io),
-   m_conn_mgr(m_io),
+   m_conn_mgr(m_io, pcfg),
    m_fact(),
    m_store(m_io, pmemlist, pcfg),
    m_handler(m_io, m_conn_mgr, m_store, pcfg, true),
    m_timer(m_io)
 {
+    GetAdmission()->configure(pcfg);
 
     m_signals.add(SIGINT);
     m_signals.add(SIGTERM);
@@ -87,6 +90,19 @@ StoreServer::StoreServer(ConfigPortal * pcfg,
 
     start_accept();
 
+    // Keep channels to the other nodes of the ring open
+    m_store.add_ring_listener([this, bind_addr](const vector<MemberEntry >& ring) {
+        vector<ip::tcp::endpoint > peers;
+        for (auto&& n : ring) {
+            ip::tcp::endpoint ep(rawip2address(n.af, n.address), n.portnumber);
+            if (ep != bind_addr) {
+                peers.push_back(ep);
+            }
+        }
+        m_conn_mgr.warmup_channels(peers);
+    });
+    m_store.start_member_watch();
+
     m_timer.expires_from_now(boost::posix_time::seconds(m_pcfg->get_membership_period()));
     m_timer.async_wait(boost::bind(&StoreServer::handle_period_timer, this));
 }
@@ -127,7 +143,9 @@ void StoreServer::handle_period_timer()
     if (m_done) return;
    
     m_handler.handle_time_event();
-    m_store.update_ring();
+    m_store.update_members();
+    GetStoreStats()->log_stats();
+    GetAdmission()->sample_memory();
  
     m_timer.expires_from_now(boost::posix_time::seconds(m_pcfg->get_membership_period()));
     m_timer.async_wait(boost::bind(&StoreServer::handle_period_timer, this));
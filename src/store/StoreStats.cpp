@@ -0,0 +1,79 @@
+/**
+ *******************************************************************************
+ * StoreStats.cpp                                                              *
+ *                                                                             *
+ * Store statistics:                                                           *
+ *   - Counters of the store node, logged periodically                         *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "StoreStats.h"
+
+#include <sstream>
+
+using namespace std;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+StoreStats* StoreStats::s_inst = new StoreStats();
+
+StoreStats* StoreStats::get_stats()
+{
+    return s_inst;
+}
+
+StoreStats::StoreStats()
+{
+    for (auto&& c : m_counters) {
+        c = 0;
+    }
+}
+
+StoreStats::~StoreStats()
+{
+}
+
+void StoreStats::dump(int (*output)(const char*, ...)) const
+{
+    for (int i=static_cast<int>(StatCounter::PLUTO_FIRST);
+         i<static_cast<int>(StatCounter::PLUTO_LAST); i++) {
+        StatCounter c = static_cast<StatCounter>(i);
+        output("%-16s: %llu\n", get_stat_desc(c).c_str(), get(c));
+    }
+}
+
+void StoreStats::log_stats() const
+{
+    ostringstream oss;
+    for (int i=static_cast<int>(StatCounter::PLUTO_FIRST);
+         i<static_cast<int>(StatCounter::PLUTO_LAST); i++) {
+        StatCounter c = static_cast<StatCounter>(i);
+        oss << " " << get_stat_desc(c) << "=" << get(c);
+    }
+    getlog()->sendlog(LogLevel::INFO, "Store stats:%s\n", oss.str().c_str());
+}
+
+StoreStats* GetStoreStats()
+{
+    return StoreStats::get_stats();
+}
+
+/* eof */
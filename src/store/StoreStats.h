@@ -0,0 +1,112 @@
+/**
+ *******************************************************************************
+ * StoreStats.h                                                                *
+ *                                                                             *
+ * Store statistics:                                                           *
+ *   - Counters of the store node, logged periodically                         *
+ *******************************************************************************
+ */
+
+#ifndef _STORE_STATS_H_
+#define _STORE_STATS_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <string>
+#include <atomic>
+#include <cstdio>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+enum class StatCounter : int {
+    PLUTO_FIRST = 0,
+    READ = PLUTO_FIRST,     // Read requests coordinated
+    HEDGE,                  // Speculative replica reads sent
+    HEDGE_WIN,              // Reads answered by a speculative reply
+    READ_REPAIR,            // Read repairs sent
+    HINT,                   // Writes hinted for unavailable replicas
+    HINT_REPLAY,            // Hints replayed
+    HINT_DROP,              // Hints dropped, store full or expired
+    LOCAL,                  // Requests answered by local replica directly
+    EXPIRED,                // Requests dropped, deadline passed
+    BUSY,                   // Client requests rejected by admission control
+    COALESCED,              // Reads answered by a read of the key in flight
+    HOT_HIT,                // Reads answered by the hot key cache
+    BATCHED,                // Replica requests sent in batch frames
+    CONFLICT,               // Conditional writes rejected by version mismatch
+    PLUTO_LAST
+};
+
+inline std::string get_stat_desc(StatCounter c) {
+    switch(c) {
+    case StatCounter::READ:        return "READ";
+    case StatCounter::HEDGE:       return "HEDGE";
+    case StatCounter::HEDGE_WIN:   return "HEDGE_WIN";
+    case StatCounter::READ_REPAIR: return "READ_REPAIR";
+    case StatCounter::HINT:        return "HINT";
+    case StatCounter::HINT_REPLAY: return "HINT_REPLAY";
+    case StatCounter::HINT_DROP:   return "HINT_DROP";
+    case StatCounter::LOCAL:       return "LOCAL";
+    case StatCounter::EXPIRED:     return "EXPIRED";
+    case StatCounter::BUSY:        return "BUSY";
+    case StatCounter::COALESCED:   return "COALESCED";
+    case StatCounter::HOT_HIT:     return "HOT_HIT";
+    case StatCounter::BATCHED:     return "BATCHED";
+    case StatCounter::CONFLICT:    return "CONFLICT";
+    default: return "Unknown: " + std::to_string(static_cast<int>(c));
+    }
+    return "Bad";
+}
+
+/**
+ * Counters can be updated from any thread.
+ */
+class StoreStats {
+private:
+    StoreStats();
+public:
+    ~StoreStats();
+
+    void incr(StatCounter c, uint64 n = 1) {
+        m_counters[static_cast<int>(c)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64 get(StatCounter c) const {
+        return m_counters[static_cast<int>(c)].load(std::memory_order_relaxed);
+    }
+
+    void dump(int (*output)(const char*, ...)=std::printf) const;
+    // Log all counters at INFO level
+    void log_stats() const;
+
+    static StoreStats* get_stats();
+private:
+    static StoreStats* s_inst;
+
+    std::atomic<uint64> m_counters[static_cast<int>(StatCounter::PLUTO_LAST)];
+};
+
+StoreStats* GetStoreStats();
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _STORE_STATS_H_
@@ -0,0 +1,154 @@
+/**
+ *******************************************************************************
+ * TimingWheel.cpp                                                             *
+ *                                                                             *
+ * Timing wheel:                                                               *
+ *   - Hierarchical timer wheel, O(1) add/cancel/expire in millisecond ticks   *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "TimingWheel.h"
+
+using namespace std;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+#define TW_ROOT_BITS   8
+#define TW_LEVEL_BITS  6
+#define TW_LEVELS      4
+
+#define TW_ROOT_SIZE   (1 << TW_ROOT_BITS)
+#define TW_LEVEL_SIZE  (1 << TW_LEVEL_BITS)
+#define TW_ROOT_MASK   (TW_ROOT_SIZE - 1)
+#define TW_LEVEL_MASK  (TW_LEVEL_SIZE - 1)
+#define TW_MAX_SPAN    ((1ULL << (TW_ROOT_BITS + (TW_LEVELS-1)*TW_LEVEL_BITS)) - 1)
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+TimingWheel::TimingWheel(uint64 now) :
+   m_now(now),
+   m_wheel(TW_LEVELS),
+   m_timers()
+{
+    m_wheel[0].resize(TW_ROOT_SIZE);
+    for (int i=1; i<TW_LEVELS; i++) {
+        m_wheel[i].resize(TW_LEVEL_SIZE);
+    }
+}
+
+TimingWheel::~TimingWheel()
+{
+}
+
+void TimingWheel::add(TIMER_ID id, uint64 expire)
+{
+    cancel(id);
+
+    Timer & t = m_timers[id];
+    t.expire = expire;
+    place(id, t);
+}
+
+bool TimingWheel::cancel(TIMER_ID id)
+{
+    unordered_map<TIMER_ID, Timer >::iterator it = m_timers.find(id);
+    if (it == m_timers.end()) {
+        return false;
+    }
+    it->second.pslot->erase(it->second.pos);
+    m_timers.erase(it);
+    return true;
+}
+
+void TimingWheel::place(TIMER_ID id, Timer& t)
+{
+    // Expired already, fires on next tick
+    uint64 expire = max(t.expire, m_now);
+    uint64 delta  = expire - m_now;
+    if (delta > TW_MAX_SPAN) {
+        delta  = TW_MAX_SPAN;
+        expire = m_now + delta;
+    }
+
+    list<TIMER_ID > * pslot = nullptr;
+    if (delta < TW_ROOT_SIZE) {
+        pslot = &m_wheel[0][expire & TW_ROOT_MASK];
+    }
+    else {
+        int level = 1;
+        int shift = TW_ROOT_BITS;
+        while ((level < TW_LEVELS-1) && (delta >= (1ULL << (shift + TW_LEVEL_BITS)))) {
+            level++;
+            shift += TW_LEVEL_BITS;
+        }
+        pslot = &m_wheel[level][(expire >> shift) & TW_LEVEL_MASK];
+    }
+
+    t.pslot = pslot;
+    t.pos   = pslot->insert(pslot->end(), id);
+}
+
+void TimingWheel::cascade(int level, size_t idx)
+{
+    list<TIMER_ID > slot;
+    slot.swap(m_wheel[level][idx]);
+    for (auto&& id : slot) {
+        place(id, m_timers[id]);
+    }
+}
+
+void TimingWheel::advance(uint64 now, vector<TIMER_ID >& expired)
+{
+    if (m_timers.empty()) {
+        m_now = max(m_now, now);
+        return;
+    }
+
+    while (m_now <= now) {
+        size_t idx = m_now & TW_ROOT_MASK;
+        if (idx == 0) {
+            // Level 0 wraps, move timers of next span down
+            int shift = TW_ROOT_BITS;
+            for (int level=1; level<TW_LEVELS; level++) {
+                size_t lidx = (m_now >> shift) & TW_LEVEL_MASK;
+                cascade(level, lidx);
+                if (lidx != 0) {
+                    break;
+                }
+                shift += TW_LEVEL_BITS;
+            }
+        }
+
+        list<TIMER_ID > & slot = m_wheel[0][idx];
+        for (auto&& id : slot) {
+            m_timers.erase(id);
+            expired.push_back(id);
+        }
+        slot.clear();
+
+        if (m_timers.empty()) {
+            m_now = now + 1;
+            break;
+        }
+        m_now++;
+    }
+}
+
+/* eof */
+
@@ -0,0 +1,94 @@
+/**
+ *******************************************************************************
+ * TimingWheel.h                                                               *
+ *                                                                             *
+ * Timing wheel:                                                               *
+ *   - Hierarchical timer wheel, O(1) add/cancel/expire in millisecond ticks   *
+ *******************************************************************************
+ */
+
+#ifndef _TIMING_WHEEL_H_
+#define _TIMING_WHEEL_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * Level 0 has 256 slots of one tick, each of the 3 upper levels 64 slots of
+ * the span of the level below. Timers in an upper level slot are moved down
+ * when level 0 wraps to the slot. Timers further than 2^26 ticks (18 hours
+ * in milliseconds) expire at the end of the wheel.
+ * Timers are identified by the id given by the owner, which must be unique.
+ * NO lock, the owner serializes the access!!!
+ */
+class TimingWheel {
+public:
+    typedef unsigned long long TIMER_ID;
+
+    // now -- current tick
+    explicit TimingWheel(uint64 now = 0);
+    ~TimingWheel();
+
+    // Timer expires at tick 'expire', timer of the same id is replaced.
+    // Tick passed already expires on next advance
+    void add(TIMER_ID id, uint64 expire);
+    // Returns false if the timer is not found, expired already
+    bool cancel(TIMER_ID id);
+
+    // Move to tick 'now', the ids of timers expired are appended to 'expired'
+    void advance(uint64 now, std::vector<TIMER_ID >& expired);
+
+    size_t size() const {
+        return m_timers.size();
+    }
+
+    bool empty() const {
+        return m_timers.empty();
+    }
+
+    uint64 get_now() const {
+        return m_now;
+    }
+private:
+    struct Timer {
+        uint64                         expire;
+        std::list<TIMER_ID >*          pslot;
+        std::list<TIMER_ID >::iterator pos;
+    };
+private:
+    void place(TIMER_ID id, Timer& t);
+    void cascade(int level, size_t idx);
+private:
+    uint64                                  m_now;
+    std::vector<std::vector<std::list<TIMER_ID > > > m_wheel;
+    std::unordered_map<TIMER_ID, Timer >    m_timers;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _TIMING_WHEEL_H_
+
@@ -0,0 +1,78 @@
+/**
+ *******************************************************************************
+ * TokenBucket.h                                                               *
+ *                                                                             *
+ * Token bucket:                                                               *
+ *   - Rate limit background work                                              *
+ *******************************************************************************
+ */
+
+#ifndef _TOKEN_BUCKET_H_
+#define _TOKEN_BUCKET_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include <chrono>
+#include <algorithm>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * 'rate' tokens are added per second, at most 'burst' tokens are kept.
+ * NO lock, the owner serializes the access!!!
+ */
+class TokenBucket {
+public:
+    TokenBucket(double rate, double burst) :
+       m_rate(rate),
+       m_burst(burst),
+       m_tokens(burst),
+       m_last(std::chrono::steady_clock::now()) {
+    }
+    ~TokenBucket() {
+    }
+
+    bool try_acquire(double n = 1.0) {
+        refill();
+        if (m_tokens < n) {
+            return false;
+        }
+        m_tokens -= n;
+        return true;
+    }
+private:
+    void refill() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - m_last;
+        m_last   = now;
+        m_tokens = std::min(m_burst, m_tokens + elapsed.count() * m_rate);
+    }
+private:
+    double m_rate;
+    double m_burst;
+    double m_tokens;
+    std::chrono::steady_clock::time_point m_last;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _TOKEN_BUCKET_H_
@@ -0,0 +1,159 @@
+/**
+ *******************************************************************************
+ * TokenRing.cpp                                                               *
+ *                                                                             *
+ * Token ring:                                                                 *
+ *   - Places virtual nodes of every member on the hash ring                   *
+ *   - Finds replicas of a key by binary search of sorted tokens               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "TokenRing.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+TokenRing::TokenRing() :
+   m_members(),
+   m_tokens(),
+   m_prefs(),
+   m_replicas(0)
+{
+}
+
+TokenRing::~TokenRing()
+{
+}
+
+void TokenRing::build(const vector<MemberEntry >& members, int vnodes)
+{
+    m_members  = members;
+    m_replicas = min(m_members.size(), static_cast<size_t>(PLUTO_NODE_REPLICAS_NUM));
+    vnodes     = max(vnodes, 1);
+
+    vector<pair<uint64, uint32 > > tokens;
+    tokens.reserve(m_members.size() * vnodes);
+    for (size_t i=0; i<m_members.size(); i++) {
+        for (int v=0; v<vnodes; v++) {
+            tokens.push_back(make_pair(get_token(m_members[i], v), static_cast<uint32>(i)));
+        }
+    }
+    sort(tokens.begin(), tokens.end());
+
+    m_tokens.clear();
+    m_tokens.reserve(tokens.size());
+    for (auto&& t : tokens) {
+        m_tokens.push_back(t.first);
+    }
+
+    // Zones replicas can spread over, members of unknown zone count as
+    // zones of their own
+    vector<uint16 > zones;
+    size_t zone_cnt = 0;
+    for (auto&& m : m_members) {
+        if (m.zone == 0) {
+            zone_cnt++;
+        }
+        else if (find(zones.begin(), zones.end(), m.zone) == zones.end()) {
+            zones.push_back(m.zone);
+            zone_cnt++;
+        }
+    }
+    size_t spread = min(m_replicas, zone_cnt);
+
+    // Distinct members clockwise from each token, the first 'spread' of
+    // them in distinct zones
+    m_prefs.assign(tokens.size() * m_replicas, 0);
+    for (size_t i=0; i<tokens.size(); i++) {
+        uint32 * prefs = m_prefs.data() + i * m_replicas;
+        size_t cnt = 0;
+        for (size_t j=i; cnt<spread; j++) {
+            uint32 m = tokens[j % tokens.size()].second;
+            if (!has_zone(prefs, cnt, m)) {
+                prefs[cnt++] = m;
+            }
+        }
+        for (size_t j=i; cnt<m_replicas; j++) {
+            uint32 m = tokens[j % tokens.size()].second;
+            if (find(prefs, prefs + cnt, m) == prefs + cnt) {
+                prefs[cnt++] = m;
+            }
+        }
+    }
+}
+
+vector<MemberEntry > TokenRing::get_nodes(uint64 hash) const
+{
+    vector<MemberEntry > v;
+    if (m_tokens.empty()) {
+        return v;
+    }
+
+    const uint32 * prefs = m_prefs.data() + find_token(hash) * m_replicas;
+    v.reserve(m_replicas);
+    for (size_t i=0; i<m_replicas; i++) {
+        v.push_back(m_members[prefs[i]]);
+    }
+    return v;
+}
+
+bool TokenRing::has_zone(const uint32* prefs, size_t cnt, uint32 member) const
+{
+    uint16 zone = m_members[member].zone;
+    for (size_t i=0; i<cnt; i++) {
+        if ((prefs[i] == member) ||
+            ((zone != 0) && (m_members[prefs[i]].zone == zone))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t TokenRing::find_token(uint64 hash) const
+{
+    vector<uint64 >::const_iterator it = lower_bound(m_tokens.begin(), m_tokens.end(), hash);
+    if (it == m_tokens.end()) {
+        return 0;
+    }
+    return it - m_tokens.begin();
+}
+
+uint64 TokenRing::get_token(const MemberEntry& member, int vnode)
+{
+    // Every node must place the member's tokens at the same positions, so
+    // the bytes hashed are laid out explicitly
+    unsigned char buf[PL_IPv6_ADDR_LEN + 8];
+    size_t addrsize = (member.af == AF_INET) ? PL_IPv4_ADDR_LEN : PL_IPv6_ADDR_LEN;
+    memcpy(buf, member.address, addrsize);
+    size_t sz = addrsize;
+    buf[sz++] = member.portnumber & 0xFF;
+    buf[sz++] = (member.portnumber >> 8) & 0xFF;
+    for (int i=0; i<4; i++) {
+        buf[sz++] = (static_cast<uint32>(vnode) >> (8 * i)) & 0xFF;
+    }
+    return get_hash64(buf, sz);
+}
+
+/* eof */
@@ -0,0 +1,87 @@
+/**
+ *******************************************************************************
+ * TokenRing.h                                                                 *
+ *                                                                             *
+ * Token ring:                                                                 *
+ *   - Places virtual nodes of every member on the hash ring                   *
+ *   - Finds replicas of a key by binary search of sorted tokens               *
+ *******************************************************************************
+ */
+
+#ifndef _TOKEN_RING_H_
+#define _TOKEN_RING_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+#include "entrytable.h"
+
+#include <string>
+#include <vector>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * Every member owns 'vnodes' tokens on the ring, so a member's share of keys
+ * is the sum of many small arcs and evens out. Key is owned by the first
+ * token at or after its hash; the replicas are the distinct members met
+ * walking clockwise from there, skipping members of a zone already holding
+ * a replica while other zones are left. Replica lists are built once per ring
+ * change, a lookup is a binary search of tokens. A built ring is read only,
+ * lookups from many threads need no lock.
+ */
+class TokenRing {
+public:
+    TokenRing();
+    ~TokenRing();
+
+    void build(const std::vector<MemberEntry >& members, int vnodes);
+
+    size_t get_token_count() const {
+        return m_tokens.size();
+    }
+
+    const std::vector<MemberEntry >& get_members() const {
+        return m_members;
+    }
+
+    // Replicas of the key, primary first. Less than PLUTO_NODE_REPLICAS_NUM
+    // if the ring hasn't that many members
+    std::vector<MemberEntry > get_nodes(const std::string& key) const {
+        return get_nodes(::get_key_hash(key));
+    }
+    std::vector<MemberEntry > get_nodes(uint64 hash) const;
+private:
+    static uint64 get_token(const MemberEntry& member, int vnode);
+    // Zone of 'member' holds one of the first 'cnt' replicas of 'prefs'
+    bool has_zone(const uint32* prefs, size_t cnt, uint32 member) const;
+    // Index of the first token at or after 'hash', wraps to 0
+    size_t find_token(uint64 hash) const;
+private:
+    std::vector<MemberEntry > m_members;
+    std::vector<uint64 >      m_tokens;    // sorted
+    std::vector<uint32 >      m_prefs;     // m_replicas member indexes of each token
+    size_t                    m_replicas;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _TOKEN_RING_H_
+
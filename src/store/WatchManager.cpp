@@ -0,0 +1,239 @@
+/**
+ *******************************************************************************
+ * WatchManager.cpp                                                            *
+ *                                                                             *
+ * Watch manager:                                                              *
+ *   - Keeps key/prefix watches registered by clients                          *
+ *   - Pushes coalesced change notifications over client connections           *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+
+#include "WatchMessage.h"
+#include "WatchManager.h"
+#include "Connection.h"
+
+#include <boost/asio.hpp>
+
+using namespace std;
+using namespace boost::asio;
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+WatchManager::WatchManager(io_service& io,
+                           ConfigPortal * pcfg,
+                           MessageOriginator originator) :
+   m_strand(io),
+   m_pconfig(pcfg),
+   m_originator(originator),
+   m_unwatch_handler(),
+   m_keys(),
+   m_prefixes(),
+   m_prefix_lens(),
+   m_pending(),
+   m_flush_scheduled(false),
+   m_flush_timer(io),
+   m_watch_cnt(0)
+{
+}
+
+WatchManager::~WatchManager()
+{
+}
+
+void WatchManager::add_watch(shared_ptr<Connection > pconn, int64 txid,
+                             const string& key, bool prefix)
+{
+    if (pconn.get() == nullptr) {
+        return;
+    }
+
+    m_strand.post([this, pconn, txid, key, prefix]() {
+        WATCH_MAP & m = prefix ? m_prefixes : m_keys;
+        map<Connection*, Watch > & w = m[key];
+        if (w.find(pconn.get()) == w.end()) {
+            m_watch_cnt++;
+            if (prefix) {
+                m_prefix_lens[key.size()]++;
+            }
+        }
+        Watch & watch = w[pconn.get()];
+        watch.conn = pconn;
+        watch.txid = txid;
+    });
+}
+
+void WatchManager::remove_watch(Connection* pconn, const string& key, bool prefix)
+{
+    m_strand.post([this, pconn, key, prefix]() {
+        remove_watch(prefix ? m_prefixes : m_keys, pconn, key);
+    });
+}
+
+void WatchManager::remove_watch(Connection* pconn)
+{
+    m_strand.post([this, pconn]() {
+        vector<string > keys;
+        for (auto&& w : m_keys) {
+            if (w.second.find(pconn) != w.second.end()) {
+                keys.push_back(w.first);
+            }
+        }
+        for (auto&& k : keys) {
+            remove_watch(m_keys, pconn, k);
+        }
+
+        keys.clear();
+        for (auto&& w : m_prefixes) {
+            if (w.second.find(pconn) != w.second.end()) {
+                keys.push_back(w.first);
+            }
+        }
+        for (auto&& k : keys) {
+            remove_watch(m_prefixes, pconn, k);
+        }
+
+        m_pending.erase(pconn);
+    });
+}
+
+void WatchManager::remove_watch(WATCH_MAP& m, Connection* pconn, const string& key)
+{
+    WATCH_MAP::iterator it = m.find(key);
+    if (it == m.end()) {
+        return;
+    }
+    if (it->second.erase(pconn) == 0) {
+        return;
+    }
+
+    m_watch_cnt--;
+    if (&m == &m_prefixes) {
+        auto lit = m_prefix_lens.find(key.size());
+        if ((lit != m_prefix_lens.end()) && (--lit->second == 0)) {
+            m_prefix_lens.erase(lit);
+        }
+    }
+    if (it->second.empty()) {
+        m.erase(it);
+        if (m_unwatch_handler) {
+            m_unwatch_handler(key, &m == &m_prefixes);
+        }
+    }
+}
+
+void WatchManager::handle_change(const ChangeRecord& rec)
+{
+    // Skip the post if nobody watches. Other replicas of the key and keys
+    // moved between replica types are not notified
+    if ((m_watch_cnt == 0) || (rec.replica_type != 0) || rec.moved) {
+        return;
+    }
+
+    m_strand.post([this, rec]() {
+        WATCH_MAP::const_iterator it = m_keys.find(rec.key);
+        if (it != m_keys.end()) {
+            queue_change(it, rec);
+        }
+
+        for (auto&& l : m_prefix_lens) {
+            if (l.first > rec.key.size()) {
+                break;
+            }
+            it = m_prefixes.find(rec.key.substr(0, l.first));
+            if (it != m_prefixes.end()) {
+                queue_change(it, rec);
+            }
+        }
+
+        if (m_flush_scheduled || m_pending.empty()) {
+            return;
+        }
+
+        m_flush_scheduled = true;
+        int window = m_pconfig->get_watch_coalesce_window();
+        if (window <= 0) {
+            m_strand.post([this]() { flush(); });
+            return;
+        }
+        m_flush_timer.expires_from_now(boost::posix_time::milliseconds(window));
+        m_flush_timer.async_wait(m_strand.wrap([this](const boost::system::error_code& ec) {
+                                                   flush();
+                                               }));
+    });
+}
+
+void WatchManager::async_get_watches(WATCHES_HANDLER handler)
+{
+    m_strand.post([this, handler]() {
+        vector<pair<string, bool> > v;
+        for (auto&& w : m_keys) {
+            v.push_back(make_pair(w.first, false));
+        }
+        for (auto&& w : m_prefixes) {
+            v.push_back(make_pair(w.first, true));
+        }
+        handler(v);
+    });
+}
+
+void WatchManager::queue_change(WATCH_MAP::const_iterator it, const ChangeRecord& rec)
+{
+    for (auto&& w : it->second) {
+        Pending & p = m_pending[w.first];
+        p.conn = w.second.conn;
+        // Rapid changes to the same key overwrite each other until flushed
+        p.changes[make_pair(w.second.txid, rec.key)] = rec;
+    }
+}
+
+void WatchManager::flush()
+{
+    m_flush_scheduled = false;
+
+    vector<Connection* > gone;
+    for (auto&& p : m_pending) {
+        shared_ptr<Connection > pconn = p.second.conn.lock();
+        if ((pconn.get() == nullptr) || !pconn->is_open()) {
+            gone.push_back(p.first);
+            continue;
+        }
+
+        for (auto&& c : p.second.changes) {
+            WatchNotifyMessage * pmsg = new WatchNotifyMessage(m_originator, c.first.first);
+            pmsg->set_change(c.second);
+            pmsg->set_connection(pconn);
+            if (pmsg->build_msg() != 0) {
+                getlog()->sendlog(LogLevel::ERROR, "Watch notify build failed\n");
+                delete pmsg;
+                continue;
+            }
+            pconn->do_write(pmsg);
+        }
+    }
+    m_pending.clear();
+
+    for (auto&& c : gone) {
+        remove_watch(c);
+    }
+}
+
+/* eof */
+
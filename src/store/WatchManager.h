@@ -0,0 +1,126 @@
+/**
+ *******************************************************************************
+ * WatchManager.h                                                              *
+ *                                                                             *
+ * Watch manager:                                                              *
+ *   - Keeps key/prefix watches registered by clients                          *
+ *   - Pushes coalesced change notifications over client connections           *
+ *******************************************************************************
+ */
+
+#ifndef _WATCH_MANAGER_H_
+#define _WATCH_MANAGER_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include "stdinclude.h"
+#include "messages.h"
+#include "ChangeFeed.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <functional>
+
+#include <boost/asio.hpp>
+
+/*
+ *******************************************************************************
+ *  Forward declaraction                                                       *
+ *******************************************************************************
+ */
+class Connection;
+
+/*
+ *******************************************************************************
+ *  Class declaraction                                                         *
+ *******************************************************************************
+ */
+
+/**
+ * A change is matched only on the node holding the primary replica of the
+ * key, so every write is notified once. Keys moved by rebalance are not
+ * changes. Coordinators watch for their clients on the nodes holding the
+ * primary replicas and get the matches pushed back as WATCHNOTIFY of server
+ * originator, see ClientMessageHandler.
+ */
+class WatchManager {
+public:
+    // Called by watch strand when the last watch of a key or prefix is
+    // removed
+    typedef std::function<void (const std::string& key, bool prefix)> UNWATCH_HANDLER;
+    // Called by watch strand with the keys and prefixes watched
+    typedef std::function<void (const std::vector<std::pair<std::string, bool> >&)> WATCHES_HANDLER;
+
+    // 'originator' of the notifications, Server for watches of other nodes
+    WatchManager(boost::asio::io_service& io,
+                 ConfigPortal * pcfg,
+                 MessageOriginator originator = MessageOriginator::Client);
+    ~WatchManager();
+
+    // Must be called before server runs
+    void set_unwatch_handler(UNWATCH_HANDLER handler) {
+        m_unwatch_handler = handler;
+    }
+
+    void add_watch(std::shared_ptr<Connection > pconn, int64 txid,
+                   const std::string& key, bool prefix);
+    void remove_watch(Connection* pconn, const std::string& key, bool prefix);
+    // Remove all watches of the connection
+    void remove_watch(Connection* pconn);
+
+    // Called by store strand for every mutation, and for the changes pushed
+    // by other nodes
+    void handle_change(const ChangeRecord& rec);
+
+    void async_get_watches(WATCHES_HANDLER handler);
+private:
+    struct Watch {
+        std::weak_ptr<Connection > conn;
+        int64                      txid;
+    };
+    typedef std::map<std::string, std::map<Connection*, Watch > > WATCH_MAP;
+
+    // Changes waiting for flush, coalesced by watch and key
+    typedef std::map<std::pair<int64, std::string>, ChangeRecord > PENDING_MAP;
+    struct Pending {
+        std::weak_ptr<Connection > conn;
+        PENDING_MAP                changes;
+    };
+private:
+    // Following functions are called by watch strand!!!
+    void queue_change(WATCH_MAP::const_iterator it, const ChangeRecord& rec);
+    void flush();
+    void remove_watch(WATCH_MAP& m, Connection* pconn, const std::string& key);
+private:
+    boost::asio::io_service::strand m_strand;
+    ConfigPortal *                  m_pconfig;
+    MessageOriginator               m_originator;
+    UNWATCH_HANDLER                 m_unwatch_handler;
+
+    WATCH_MAP                       m_keys;
+    WATCH_MAP                       m_prefixes;
+    // Length of prefixes watched, to look up prefixes of a key
+    std::map<size_t, size_t >       m_prefix_lens;
+
+    std::map<Connection*, Pending > m_pending;
+    bool                            m_flush_scheduled;
+    boost::asio::deadline_timer     m_flush_timer;
+
+    std::atomic<size_t>             m_watch_cnt;
+};
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+#endif // _WATCH_MANAGER_H_
+
@@ -0,0 +1,408 @@
+/**
+ *******************************************************************************
+ * WatchMessage.h                                                              *
+ *                                                                             *
+ * Watch/Unwatch request/response and change notification message             *
+ *******************************************************************************
+ */
+
+#ifndef _WATCH_MSG_COMMON_H_
+#define _WATCH_MSG_COMMON_H_
+
+/**
+ *******************************************************************************
+ * Headers                                                                     *
+ *******************************************************************************
+ */
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "stdinclude.h"
+#include "KVMessage.h"
+#include "ChangeFeed.h"
+#include "plexcept.h"
+
+/**
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+#define PLUTO_WATCH_FLAG_PREFIX   0x01
+
+/**
+ *******************************************************************************
+ * Class declaraction                                                          *
+ *******************************************************************************
+ */
+
+class WatchReqMessage : public StoreMessage {
+public:
+    WatchReqMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       StoreMessage(buf, sz, managebuf),
+       m_key(),
+       m_flags(0) {
+    };
+
+    WatchReqMessage(MsgType type,
+                    MessageOriginator originator,
+                    int64 txid) :
+       StoreMessage(type, originator, txid),
+       m_key(),
+       m_flags(0) {
+    }
+
+    virtual ~WatchReqMessage() {
+    }
+
+    // Key, or key prefix if prefix flag is set
+    void set_key(const std::string& key) {
+        m_key = key;
+    }
+
+    const std::string& get_key() const {
+        return m_key;
+    }
+
+    void set_prefix(bool prefix) {
+        if (prefix) {
+            m_flags |= PLUTO_WATCH_FLAG_PREFIX;
+        }
+        else {
+            m_flags &= ~PLUTO_WATCH_FLAG_PREFIX;
+        }
+    }
+
+    bool is_prefix() const {
+        return (m_flags & PLUTO_WATCH_FLAG_PREFIX) != 0;
+    }
+
+    int build_storemsg_body(unsigned char* buf, size_t sz) {
+        /**
+         * Format:
+         *  int32 -- flags
+         *  int32 -- reserved
+         *  int64 -- key length
+         *  char array -- key
+         *  pad -- to 4 bytes
+         */
+        if (buf == nullptr) {
+            getlog()->sendlog(LogLevel::ERROR, "Watch request message, build body nullptr received\n");
+            return -1;
+        }
+
+        if (sz < get_storemsg_bodysize()) {
+            getlog()->sendlog(LogLevel::ERROR, "Watch request message, build body no enough buffer, size=%d, required %d\n",
+                                                sz, get_storemsg_bodysize());
+            return -1;
+        }
+
+        int32 ival = htonl(m_flags);
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = 0;
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        network_write_int64(buf, m_key.size());
+        buf += sizeof(int64);
+
+        memcpy(buf, m_key.c_str(), m_key.size());
+        buf += m_key.size();
+
+        size_t wrtlen = 2*sizeof(int32) + sizeof(int64) + m_key.size();
+        if (get_storemsg_bodysize() > wrtlen) {
+            memset(buf, 0, get_storemsg_bodysize() - wrtlen);
+        }
+        return 0;
+    }
+
+    void parse_storemsg_body(const unsigned char* buf, const size_t sz)
+       throw (parse_error) {
+        if (buf == nullptr) {
+            throw parse_error("WatchReqMessage: parse got null ptr!");
+        }
+
+        size_t hdrsz = 2*sizeof(int32) + sizeof(int64);
+        if (sz < hdrsz) {
+            throw parse_error("WatchReqMessage: invalid length expected: " + std::to_string(hdrsz));
+        }
+
+        int32 ival;
+        memcpy(&ival, buf, sizeof(int32));
+        m_flags = ntohl(ival);
+        buf += sizeof(int32);
+
+        // The reserved field
+        buf += sizeof(int32);
+
+        int64 lval = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        if (sz < lval + hdrsz) {
+            throw parse_error("WatchReqMessage: in-complete message, recevied size: " + std::to_string(sz));
+        }
+        m_key.assign((const char*)buf, lval);
+
+        // No need to read paddings
+    }
+
+    size_t get_storemsg_bodysize() const {
+        return 2*sizeof(int32) + sizeof(int64) + (m_key.size()+3)/4*4;
+    }
+
+    void dump_storemsg_body(int (*output)(const char*, ...)=printf,
+                            bool verbose=false) const {
+        output("Key   : '%s'\n", m_key.c_str());
+        output("Prefix: '%s'\n", is_prefix() ? "yes" : "no");
+    }
+private:
+    std::string m_key;
+    int32       m_flags;
+};
+
+/**
+ * Watches are registered on the node receiving the request and fire for the
+ * mutations applied to the replicas held by that node. Clients register key
+ * watches on one of the key's replicas, prefix watches on every node.
+ * Notifications carry the txid of the watch request.
+ */
+class WatchRequestMessage : public WatchReqMessage {
+public:
+    WatchRequestMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       WatchReqMessage(buf, sz, managebuf) {
+    };
+
+    WatchRequestMessage(MessageOriginator originator,
+                        int64 txid) :
+        WatchReqMessage(MsgType::WATCHREQ, originator, txid) {
+    }
+
+    ~WatchRequestMessage() {
+    }
+};
+
+class WatchResponseMessage : public KVRespMessage {
+public:
+    WatchResponseMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       KVRespMessage(buf, sz, managebuf) {
+    }
+
+    WatchResponseMessage(MessageOriginator originator,
+                         int64 txid,
+                         MsgStatus status) :
+       KVRespMessage(MsgType::WATCHRESP, originator, txid, status) {
+    }
+    ~WatchResponseMessage() {
+    }
+};
+
+class UnwatchRequestMessage : public WatchReqMessage {
+public:
+    UnwatchRequestMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       WatchReqMessage(buf, sz, managebuf) {
+    };
+
+    UnwatchRequestMessage(MessageOriginator originator,
+                          int64 txid) :
+        WatchReqMessage(MsgType::UNWATCHREQ, originator, txid) {
+    }
+
+    ~UnwatchRequestMessage() {
+    }
+};
+
+class UnwatchResponseMessage : public KVRespMessage {
+public:
+    UnwatchResponseMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       KVRespMessage(buf, sz, managebuf) {
+    }
+
+    UnwatchResponseMessage(MessageOriginator originator,
+                           int64 txid,
+                           MsgStatus status) :
+       KVRespMessage(MsgType::UNWATCHRESP, originator, txid, status) {
+    }
+    ~UnwatchResponseMessage() {
+    }
+};
+
+class WatchNotifyMessage : public StoreMessage {
+public:
+    WatchNotifyMessage(unsigned char* buf, const size_t sz, bool managebuf = false) :
+       StoreMessage(buf, sz, managebuf),
+       m_seq(0),
+       m_op(ChangeOperation::UPDATE),
+       m_key(),
+       m_value() {
+    }
+
+    WatchNotifyMessage(MessageOriginator originator,
+                       int64 txid) :
+       StoreMessage(MsgType::WATCHNOTIFY, originator, txid),
+       m_seq(0),
+       m_op(ChangeOperation::UPDATE),
+       m_key(),
+       m_value() {
+    }
+
+    ~WatchNotifyMessage() {
+    }
+
+    void set_change(const ChangeRecord& rec) {
+        m_seq   = rec.seq;
+        m_op    = rec.op;
+        m_key   = rec.key;
+        m_value = rec.value;
+    }
+
+    uint64 get_seq() const {
+        return m_seq;
+    }
+
+    ChangeOperation get_operation() const {
+        return m_op;
+    }
+
+    const std::string& get_key() const {
+        return m_key;
+    }
+
+    void get_value(std::vector<unsigned char> & val) const {
+        val = m_value;
+    }
+
+    int build_storemsg_body(unsigned char* buf, size_t sz) {
+        /**
+         * Format:
+         *  int64 -- change feed sequence
+         *  int32 -- operation
+         *  int32 -- reserved
+         *  int64 -- key size
+         *  int64 -- value size
+         *  unsigned char array -- key
+         *  unsigned char array -- value
+         *  pad to 4 bytes
+         */
+        if (buf == nullptr) {
+            getlog()->sendlog(LogLevel::ERROR, "Watch notify message, build body nullptr received\n");
+            return -1;
+        }
+
+        if (sz < get_storemsg_bodysize()) {
+            getlog()->sendlog(LogLevel::ERROR, "Watch notify message, build body no enough buffer, size=%d, required %d\n",
+                                                sz, get_storemsg_bodysize());
+            return -1;
+        }
+
+        network_write_int64(buf, m_seq);
+        buf += sizeof(int64);
+
+        int32 ival = htonl(static_cast<int32>(m_op));
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        ival = 0;
+        memcpy(buf, &ival, sizeof(int32));
+        buf += sizeof(int32);
+
+        network_write_int64(buf, m_key.size());
+        buf += sizeof(int64);
+
+        network_write_int64(buf, m_value.size());
+        buf += sizeof(int64);
+
+        memcpy(buf, m_key.c_str(), m_key.size());
+        buf += m_key.size();
+
+        memcpy(buf, m_value.data(), m_value.size());
+        buf += m_value.size();
+
+        size_t wrtlen = get_hdrsize() + m_key.size() + m_value.size();
+        if (get_storemsg_bodysize() > wrtlen) {
+            memset(buf, 0, get_storemsg_bodysize() - wrtlen);
+        }
+        return 0;
+    }
+
+    void parse_storemsg_body(const unsigned char* buf, const size_t sz)
+       throw (parse_error) {
+        if (buf == nullptr) {
+            throw parse_error("WatchNotifyMessage: parse got null ptr!");
+        }
+
+        if (sz < get_hdrsize()) {
+            throw parse_error("WatchNotifyMessage: invalid length expected: " + std::to_string(get_hdrsize()));
+        }
+
+        m_seq = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        int32 ival;
+        memcpy(&ival, buf, sizeof(int32));
+        ival = ntohl(ival);
+        buf += sizeof(int32);
+
+        int hi, low;
+        low = static_cast<int>(ChangeOperation::PLUTO_FIRST);
+        hi  = static_cast<int>(ChangeOperation::PLUTO_LAST);
+        if (ival<low || ival>=hi) {
+            throw parse_error("WatchNotifyMessage: invalid operation " + std::to_string(ival));
+        }
+        m_op = static_cast<ChangeOperation>(ival);
+
+        // The reserved field
+        buf += sizeof(int32);
+
+        int64 keylen = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        int64 vallen = network_read_int64(buf);
+        buf += sizeof(int64);
+
+        if (sz < get_hdrsize() + keylen + vallen) {
+            throw parse_error("WatchNotifyMessage: in-complete message, received length: " + std::to_string(sz));
+        }
+
+        m_key.assign((const char*)buf, keylen);
+        buf += keylen;
+
+        m_value.resize(vallen);
+        memcpy(m_value.data(), buf, vallen);
+
+        // no need to read padding
+    }
+
+    size_t get_storemsg_bodysize() const {
+        return get_hdrsize() + (m_key.size() + m_value.size() + 3) / 4 * 4;
+    }
+
+    void dump_storemsg_body(int (*output)(const char*, ...)=printf,
+                            bool verbose=false) const {
+        output("Sequence : '%llu'\n", m_seq);
+        output("Operation: '%s'\n", get_change_op_desc(m_op).c_str());
+        output("Key      : '%s'\n", m_key.c_str());
+        if (verbose) {
+            dump_memory("VALUE", (const char*)m_value.data(), m_value.size(), output);
+        }
+    }
+private:
+    static size_t get_hdrsize() {
+        return 3*sizeof(int64) + 2*sizeof(int32);
+    }
+private:
+    uint64                     m_seq;
+    ChangeOperation            m_op;
+    std::string                m_key;
+    std::vector<unsigned char> m_value;
+};
+
+/**
+ *******************************************************************************
+ * Function declaractions                                                      *
+ *******************************************************************************
+ */
+
+#endif // _WATCH_MSG_COMMON_H_
+
@@ -0,0 +1,202 @@
+
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <tuple>
+
+#include <boost/logic/tribool.hpp>
+
+#include "stdinclude.h"
+#include "CreatMessage.h"
+#include "DeleteMessage.h"
+#include "RepairMessage.h"
+#include "BatchMessage.h"
+#include "StoreMsgFact.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+
+/*
+ * Batch message checks: replica writes built into one frame parse back to
+ * the same messages, and frames whose count or message sizes don't match
+ * the payload are rejected.
+ */
+
+// Offset of the first message in a built batch: common header, store
+// message header, message count
+const size_t PAYLOAD_OFFSET = sizeof(MsgCommonHdr) + sizeof(int64) * 2 +
+                              sizeof(int32) * 3 + sizeof(int32);
+
+StoreMessageFactory msgfact;
+
+vector<StoreMessage* > make_requests()
+{
+    vector<StoreMessage* > reqs;
+
+    KVReqMessage * pcreat = new CreatRequestMessage(MessageOriginator::Server, 11);
+    pcreat->set_key("k1");
+    pcreat->set_value(reinterpret_cast<const unsigned char*>("value1"), 6);
+    pcreat->set_version(3);
+    pcreat->set_replica_type(1);
+    reqs.push_back(pcreat);
+
+    KeyReqMessage * pdel = new DeleteRequestMessage(MessageOriginator::Server, 12);
+    pdel->set_key("k2");
+    pdel->set_expected_version(7);
+    pdel->set_replica_type(2);
+    reqs.push_back(pdel);
+
+    KVReqMessage * prepair = new RepairRequestMessage(MessageOriginator::Server, 13);
+    prepair->set_key("key3");
+    prepair->set_value(reinterpret_cast<const unsigned char*>("v3"), 2);
+    prepair->set_version(9);
+    reqs.push_back(prepair);
+
+    for (auto&& p : reqs) {
+        CHECK(p->build_msg() == 0);
+    }
+    return reqs;
+}
+
+// Built batch of the requests, as received
+vector<unsigned char> make_frame(const vector<StoreMessage* >& reqs)
+{
+    BatchRequestMessage batch(MessageOriginator::Server, 0);
+    for (auto&& p : reqs) {
+        CHECK(batch.add_message(p) == 0);
+    }
+    CHECK(batch.get_count() == reqs.size());
+    CHECK(batch.build_msg() == 0);
+    return vector<unsigned char>(batch.get_raw(), batch.get_raw() + batch.get_size());
+}
+
+// Parses the frame as the peer does, nullptr if it is rejected
+BatchMessage * parse_frame(vector<unsigned char>& frame)
+{
+    boost::tribool result;
+    StoreMessage * pmsg = nullptr;
+    tie(result, pmsg) = msgfact.extract(frame.data(), frame.size());
+    if (!result) {
+        return nullptr;
+    }
+    CHECK((pmsg != nullptr) && (pmsg->get_msgtype() == MsgType::BATCHREQ));
+    return dynamic_cast<BatchMessage*>(pmsg);
+}
+
+void set_uint32(vector<unsigned char>& frame, size_t offset, uint32 val)
+{
+    memcpy(frame.data() + offset, &val, sizeof(uint32));
+}
+
+void test_round_trip()
+{
+    vector<StoreMessage* > reqs = make_requests();
+    vector<unsigned char> frame = make_frame(reqs);
+
+    BatchMessage * pbatch = parse_frame(frame);
+    CHECK(pbatch != nullptr);
+    if (pbatch == nullptr) {
+        return;
+    }
+    CHECK(pbatch->get_count() == reqs.size());
+
+    for (size_t i=0; i<pbatch->get_count() && i<reqs.size(); i++) {
+        size_t sz = 0;
+        unsigned char * raw = pbatch->get_message(i, sz);
+        CHECK((sz == reqs[i]->get_size()) && (memcmp(raw, reqs[i]->get_raw(), sz) == 0));
+
+        boost::tribool result;
+        StoreMessage * pmsg = nullptr;
+        tie(result, pmsg) = msgfact.extract(raw, sz);
+        CHECK(result && (pmsg != nullptr));
+        if (pmsg == nullptr) {
+            continue;
+        }
+        CHECK(pmsg->get_msgtype() == reqs[i]->get_msgtype());
+        CHECK(pmsg->get_txid() == reqs[i]->get_txid());
+        CHECK(pmsg->get_replica_type() == reqs[i]->get_replica_type());
+        delete pmsg;
+    }
+
+    // Empty batch is a valid frame too
+    vector<unsigned char> empty = make_frame(vector<StoreMessage* >());
+    BatchMessage * pempty = parse_frame(empty);
+    CHECK((pempty != nullptr) && (pempty->get_count() == 0));
+
+    // Message not built can't be batched
+    BatchRequestMessage batch(MessageOriginator::Server, 0);
+    CreatRequestMessage creat(MessageOriginator::Server, 1);
+    CHECK(batch.add_message(&creat) == -1);
+    CHECK(batch.add_message(nullptr) == -1);
+    CHECK(batch.get_count() == 0);
+
+    delete pempty;
+    delete pbatch;
+    for (auto&& p : reqs) {
+        delete p;
+    }
+    printf("round trip: done\n");
+}
+
+void test_bad_sizes()
+{
+    vector<StoreMessage* > reqs = make_requests();
+    const vector<unsigned char> good = make_frame(reqs);
+    const size_t count_offset = PAYLOAD_OFFSET - sizeof(int32);
+    const size_t size_offset  = PAYLOAD_OFFSET + offsetof(MsgCommonHdr, size);
+
+    // More messages counted than carried
+    vector<unsigned char> frame = good;
+    set_uint32(frame, count_offset, htonl(reqs.size() + 1));
+    CHECK(parse_frame(frame) == nullptr);
+
+    // Fewer messages counted, the rest are trailing bytes
+    frame = good;
+    set_uint32(frame, count_offset, htonl(reqs.size() - 1));
+    CHECK(parse_frame(frame) == nullptr);
+
+    // Message smaller than its header, which would loop on it
+    frame = good;
+    set_uint32(frame, size_offset, sizeof(MsgCommonHdr) - 1);
+    CHECK(parse_frame(frame) == nullptr);
+    set_uint32(frame, size_offset, 0);
+    CHECK(parse_frame(frame) == nullptr);
+
+    // Message past the end of the frame
+    frame = good;
+    set_uint32(frame, size_offset, frame.size());
+    CHECK(parse_frame(frame) == nullptr);
+
+    // Frame cut inside the header of the last message
+    frame = good;
+    frame.resize(good.size() - reqs.back()->get_size() + sizeof(MsgCommonHdr) / 2);
+    set_uint32(frame, offsetof(MsgCommonHdr, size), frame.size());
+    CHECK(parse_frame(frame) == nullptr);
+
+    // Frame too short for the count
+    frame.assign(good.begin(), good.begin() + count_offset + 2);
+    set_uint32(frame, offsetof(MsgCommonHdr, size), frame.size());
+    CHECK(parse_frame(frame) == nullptr);
+
+    // Untouched frame still parses
+    frame = good;
+    BatchMessage * pbatch = parse_frame(frame);
+    CHECK((pbatch != nullptr) && (pbatch->get_count() == reqs.size()));
+
+    delete pbatch;
+    for (auto&& p : reqs) {
+        delete p;
+    }
+    printf("bad sizes: done\n");
+}
+
+int main(int argc, char* argv[])
+{
+    test_round_trip();
+    test_bad_sizes();
+
+    return check_result();
+}
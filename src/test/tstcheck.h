@@ -0,0 +1,45 @@
+/**
+ *******************************************************************************
+ * tstcheck.h                                                                  *
+ *                                                                             *
+ * Test checks:                                                                *
+ *   - Counts and reports failed checks of a test program                      *
+ *******************************************************************************
+ */
+
+#ifndef _TST_CHECK_H_
+#define _TST_CHECK_H_
+
+/*
+ *******************************************************************************
+ *  Headers                                                                    *
+ *******************************************************************************
+ */
+#include <cstdio>
+
+/*
+ *******************************************************************************
+ *  Inline functions                                                           *
+ *******************************************************************************
+ */
+
+// A test program is one translation unit, the count is its own
+static int fail_cnt = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            fail_cnt++; \
+        } \
+    } while (0)
+
+// Prints the result, returns the exit code of the program
+inline int check_result()
+{
+    printf("%s, %d failure(s)\n", fail_cnt == 0 ? "PASS" : "FAIL", fail_cnt);
+    return fail_cnt == 0 ? 0 : 1;
+}
+
+#endif // _TST_CHECK_H_
+
@@ -0,0 +1,327 @@
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <new>
+
+#include <boost/asio.hpp>
+
+#include "stdinclude.h"
+#include "CreatMessage.h"
+#include "ReadMessage.h"
+#include "UpdateMessage.h"
+#include "DeleteMessage.h"
+#include "ClientTransaction.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+using namespace boost::asio;
+using std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+using std::chrono::duration_cast;
+
+/*
+ * Micro benchmark of client transaction lifecycle: a quorum read of 3
+ * replicas, one replies the value and the others digests. The layout the
+ * flat transaction replaced is the baseline. Reuse of pooled transactions
+ * is checked first.
+ */
+
+static size_t alloc_cnt = 0;
+
+void* operator new(size_t sz)
+{
+    alloc_cnt++;
+    void * p = malloc(sz);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+#define  LOOP_CNT   1000000
+#define  VALUE_SIZE 256
+
+vector<MemberEntry > nodes;
+vector<ip::tcp::endpoint > eps;
+vector<unsigned char > value(VALUE_SIZE, 'v');
+StoreMessage * pmsg = nullptr;
+uint64 digest = 0;
+
+void init_nodes()
+{
+    for (int i=0; i<PLUTO_NODE_REPLICAS_NUM; i++) {
+        MemberEntry e;
+        memset(&e, 0, sizeof(e));
+        e.af         = AF_INET;
+        e.type       = SOCK_STREAM;
+        e.address[0] = 10;
+        e.address[3] = i + 1;
+        e.portnumber = 7000;
+        nodes.push_back(e);
+        eps.push_back(ip::tcp::endpoint(ip::address_v4(0x0A000000 + i + 1), 7000));
+    }
+    digest = get_value_digest(value.data(), value.size());
+    pmsg = new ReadRequestMessage(MessageOriginator::Client, 1);
+}
+
+/*
+ * Layout of ClientTransaction before the inline slots, cut to what a read
+ * uses: nodes copied to a vector, a map entry a reply, values copied out.
+ */
+class MapTransaction {
+public:
+    MapTransaction(StoreMessage * pmsg,
+                   const vector<struct MemberEntry > & nodes,
+                   int required) :
+       m_pmsg(pmsg),
+       m_required(required),
+       m_waitcnt(0),
+       m_rplycnt(0),
+       m_succcnt(0),
+       m_nodes(nodes),
+       m_replys() {
+    }
+
+    void start_wait_reply(const ip::tcp::endpoint& ep, int replica_type) {
+        m_waitcnt++;
+        NodeReply & r   = m_replys[ep];
+        r.replied       = false;
+        r.status        = -1;
+        r.replica_type  = replica_type;
+        r.version       = 0;
+        r.digest        = 0;
+        r.has_value     = false;
+        r.value.clear();
+    }
+
+    int add_reply(const ip::tcp::endpoint& ep, int status,
+                  const unsigned char* data, size_t sz,
+                  uint64 version, uint64 digest, bool has_value) {
+        map<ip::tcp::endpoint, NodeReply >::iterator it = m_replys.find(ep);
+        if ((it == m_replys.end()) || it->second.replied) {
+            return -1;
+        }
+        it->second.replied = true;
+        it->second.status  = status;
+        if (status == 0) {
+            it->second.version   = version;
+            it->second.digest    = digest;
+            it->second.has_value = has_value;
+            if (has_value) {
+                it->second.value.resize(sz);
+                memcpy(it->second.value.data(), data, sz);
+            }
+            m_succcnt++;
+        }
+        m_rplycnt++;
+        return 0;
+    }
+
+    int get_read_value(vector<unsigned char>& v, uint64& version) const {
+        const NodeReply * pnewest = nullptr;
+        for (auto&& r : m_replys) {
+            if (r.second.replied && (r.second.status == 0) &&
+                ((pnewest == nullptr) || (r.second.version > pnewest->version))) {
+                pnewest = &r.second;
+            }
+        }
+        if (pnewest == nullptr) {
+            return -1;
+        }
+        for (auto&& r : m_replys) {
+            if ((r.second.version == pnewest->version) &&
+                (r.second.digest == pnewest->digest) && r.second.has_value) {
+                v       = r.second.value;
+                version = r.second.version;
+                return 0;
+            }
+        }
+        return -1;
+    }
+
+    bool has_newest_value() const {
+        vector<unsigned char> v;
+        uint64 version;
+        return get_read_value(v, version) == 0;
+    }
+private:
+    struct NodeReply {
+        bool                  replied;
+        int                   status;
+        int                   replica_type;
+        uint64                version;
+        uint64                digest;
+        bool                  has_value;
+        vector<unsigned char> value;
+    };
+private:
+    StoreMessage *                          m_pmsg;
+    int                                     m_required;
+    int                                     m_waitcnt;
+    int                                     m_rplycnt;
+    int                                     m_succcnt;
+    vector<struct MemberEntry >             m_nodes;
+    map<ip::tcp::endpoint, NodeReply >      m_replys;
+};
+
+size_t run_map_tran(MapTransaction * p)
+{
+    for (int i=0; i<PLUTO_NODE_REPLICAS_NUM; i++) {
+        p->start_wait_reply(eps[i], i);
+    }
+    p->add_reply(eps[0], 0, value.data(), value.size(), 1, digest, true);
+    for (int i=1; i<PLUTO_NODE_REPLICAS_NUM; i++) {
+        p->add_reply(eps[i], 0, nullptr, 0, 1, digest, false);
+    }
+
+    vector<unsigned char> v;
+    uint64 version = 0;
+    p->get_read_value(v, version);
+    return p->has_newest_value() ? v.size() : 0;
+}
+
+// Returns read value size to keep the work from being optimized out
+size_t run_tran(ClientTransaction * p)
+{
+    for (int i=0; i<PLUTO_NODE_REPLICAS_NUM; i++) {
+        p->start_wait_reply(eps[i], i);
+    }
+    p->set_data_node(eps[0]);
+    p->add_reply(eps[0], 0, value.data(), value.size(), 1, digest, true);
+    for (int i=1; i<PLUTO_NODE_REPLICAS_NUM; i++) {
+        p->add_reply(eps[i], 0, nullptr, 0, 1, digest, false);
+    }
+
+    ClientTransaction::ValueView v = { nullptr, 0 };
+    uint64 version = 0;
+    p->get_read_value(v, version);
+    return p->has_newest_value() ? v.size : 0;
+}
+
+void check_reuse()
+{
+    ClientTransactionPool pool(1);
+
+    ClientTransaction * p = pool.acquire(pmsg, ClientTransaction::REQUEST_TYPE::READ, nodes, 2, 1000);
+    CHECK(run_tran(p) == VALUE_SIZE);
+    CHECK(std::get<0>(p->get_reply_count()) == PLUTO_NODE_REPLICAS_NUM);
+    p->mark_send_clnt_resp();
+    pool.release(p);
+    CHECK(pool.get_free_count() == 1);
+
+    // Reused transaction carries nothing of the last request
+    ClientTransaction * q = pool.acquire(pmsg, ClientTransaction::REQUEST_TYPE::UPDATE, nodes, 3, 500);
+    CHECK(q == p);
+    CHECK(pool.get_free_count() == 0);
+    CHECK(q->get_type() == ClientTransaction::REQUEST_TYPE::UPDATE);
+    CHECK(q->get_required_count() == 3);
+    CHECK(q->get_timeout() == 500);
+    CHECK(q->get_node_count() == nodes.size());
+    CHECK(std::get<0>(q->get_reply_count()) == 0);
+    CHECK(std::get<1>(q->get_reply_count()) == 0);
+    CHECK(q->get_wait_count() == 0);
+    CHECK(!q->is_client_response());
+    CHECK(!q->has_data_node());
+    CHECK(q->has_spare_node());
+    for (auto&& ep : eps) {
+        CHECK(!q->is_node_asked(ep));
+        CHECK(q->get_replica_type(ep) == -1);
+    }
+    ClientTransaction::ValueView v = { nullptr, 0 };
+    uint64 version = 0;
+    CHECK(q->get_read_value(v, version) != 0);
+
+    // Replies of the new request only
+    q->start_wait_reply(eps[1], 0);
+    CHECK(q->add_reply(eps[0], 0) != 0);
+    CHECK(q->add_reply(eps[1], static_cast<int>(MsgStatus::ERROR)) == 0);
+    CHECK(std::get<0>(q->get_reply_count()) == 1);
+    CHECK(std::get<1>(q->get_reply_count()) == 0);
+
+    // Free list is bounded, the extra transaction is freed
+    ClientTransaction * r = pool.acquire(pmsg, ClientTransaction::REQUEST_TYPE::READ, nodes, 2, 1000);
+    CHECK(r != q);
+    pool.release(q);
+    pool.release(r);
+    CHECK(pool.get_free_count() == 1);
+
+    printf("reuse   : %s\n", fail_cnt == 0 ? "PASS" : "FAIL");
+}
+
+void report(const char* name, steady_clock::duration d, size_t allocs, size_t total)
+{
+    long long ns = duration_cast<nanoseconds>(d).count();
+    printf("%-8s: %8.1f ns/transaction, %5.2f allocations/transaction (%zu)\n",
+           name, double(ns) / LOOP_CNT, double(allocs) / LOOP_CNT, total);
+}
+
+void bench_map()
+{
+    size_t total = 0;
+
+    size_t allocs = alloc_cnt;
+    steady_clock::time_point start = steady_clock::now();
+    for (int i=0; i<LOOP_CNT; i++) {
+        MapTransaction * p = new MapTransaction(pmsg, nodes, 2);
+        total += run_map_tran(p);
+        delete p;
+    }
+    steady_clock::duration d = steady_clock::now() - start;
+    report("map", d, alloc_cnt - allocs, total);
+}
+
+void bench(const char* name, bool pooled)
+{
+    ClientTransactionPool pool;
+    size_t total = 0;
+
+    size_t allocs = alloc_cnt;
+    steady_clock::time_point start = steady_clock::now();
+    for (int i=0; i<LOOP_CNT; i++) {
+        ClientTransaction * p = nullptr;
+        if (pooled) {
+            p = pool.acquire(pmsg, ClientTransaction::REQUEST_TYPE::READ, nodes, 2, 1000);
+        }
+        else {
+            p = new ClientTransaction(pmsg, ClientTransaction::REQUEST_TYPE::READ, nodes, 2, 1000);
+        }
+
+        total += run_tran(p);
+
+        if (pooled) {
+            pool.release(p);
+        }
+        else {
+            delete p;
+        }
+    }
+    steady_clock::duration d = steady_clock::now() - start;
+    report(name, d, alloc_cnt - allocs, total);
+}
+
+int main(int argc, char* argv[])
+{
+    init_nodes();
+
+    check_reuse();
+    bench_map();
+    bench("new", false);
+    bench("pooled", true);
+
+    delete pmsg;
+    return check_result();
+}
+
@@ -0,0 +1,93 @@
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include "stdinclude.h"
+#include "ChangeFeed.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+
+/*
+ * Change feed checks: records are read back in sequence from any position
+ * retained, and a position the ring has overwritten returns -1 with the
+ * oldest sequence to resync from.
+ */
+
+#define  FEED_SIZE  4
+
+void append(ChangeFeed& feed, int cnt)
+{
+    vector<unsigned char> v(8, 'v');
+    for (int i=0; i<cnt; i++) {
+        uint64 next = feed.get_next_seq();
+        ChangeOperation op = (i % 3 == 2) ? ChangeOperation::DELETE : ChangeOperation::UPDATE;
+        CHECK(feed.append(op, 0, "k" + to_string(next), v) == next);
+    }
+}
+
+void test_read()
+{
+    ChangeFeed feed(FEED_SIZE);
+    vector<ChangeRecord> v;
+    uint64 next = 0;
+
+    // Empty feed, nothing to read from the start
+    CHECK(feed.read(0, 10, v, next) == 0);
+    CHECK(v.empty() && (next == 1));
+
+    append(feed, 3);
+    CHECK(feed.get_first_seq() == 1);
+    CHECK(feed.read(0, 2, v, next) == 0);
+    CHECK((v.size() == 2) && (v[0].seq == 1) && (v[1].seq == 2) && (next == 3));
+    CHECK((v[0].key == "k1") && !v[0].value.empty() && !v[0].moved);
+
+    CHECK(feed.read(next, 10, v, next) == 0);
+    CHECK((v.size() == 1) && (v[0].seq == 3) && (next == 4));
+    CHECK((v[0].op == ChangeOperation::DELETE) && v[0].value.empty());
+
+    // Caught up, resumes from the same sequence
+    CHECK(feed.read(next, 10, v, next) == 0);
+    CHECK(v.empty() && (next == 4));
+    printf("read: done\n");
+}
+
+void test_overwrite()
+{
+    ChangeFeed feed(FEED_SIZE);
+    vector<ChangeRecord> v;
+    uint64 next = 0;
+
+    append(feed, FEED_SIZE + 2);
+    CHECK(feed.get_first_seq() == 3);
+    CHECK(feed.get_next_seq() == FEED_SIZE + 3);
+
+    // Consumer fell behind the ring
+    CHECK(feed.read(1, 10, v, next) == -1);
+    CHECK(v.empty() && (next == 3));
+    CHECK(feed.read(2, 10, v, next) == -1);
+    CHECK(next == 3);
+
+    // Resync from the oldest retained
+    CHECK(feed.read(next, 10, v, next) == 0);
+    CHECK((v.size() == FEED_SIZE) && (next == FEED_SIZE + 3));
+    for (size_t i=0; i<v.size(); i++) {
+        CHECK((v[i].seq == i + 3) && (v[i].key == "k" + to_string(i + 3)));
+    }
+
+    // 0 is the oldest retained, never overwritten
+    CHECK(feed.read(0, 1, v, next) == 0);
+    CHECK((v.size() == 1) && (v[0].seq == 3));
+    printf("overwrite: done\n");
+}
+
+int main(int argc, char* argv[])
+{
+    test_read();
+    test_overwrite();
+
+    return check_result();
+}
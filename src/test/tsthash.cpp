@@ -0,0 +1,95 @@
+
+#include <cstdio>
+#include <cstring>
+
+#include <set>
+#include <string>
+
+#include "stdinclude.h"
+#include "util.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+
+/*
+ * Key hash checks: digests are pinned, since they place keys on the token
+ * ring of every node and must not change between builds or machines. The
+ * lengths cover each path of get_hash64: empty, 1-3, 4-16, 17-48 and the
+ * 48 byte lanes.
+ */
+
+struct Digest {
+    size_t len;
+    uint64 hash;
+};
+
+const Digest DIGESTS[] = {
+    {   0, 0xda9a8b841a007253ULL },
+    {   3, 0x4822fb9097d3e30eULL },
+    {   4, 0x89b90e95d594ed2fULL },
+    {  16, 0x921ed7d01c77b7caULL },
+    {  17, 0xc6f4b0fdd566f9f8ULL },
+    {  48, 0xbf74d7d32cb2de0aULL },
+    {  49, 0x0aae2022c9d5df00ULL },
+    { 100, 0x710445c6f93528b8ULL },
+};
+
+void fill(unsigned char* buf, size_t sz)
+{
+    for (size_t i=0; i<sz; i++) {
+        buf[i] = static_cast<unsigned char>(i * 31 + 7);
+    }
+}
+
+void test_digests()
+{
+    unsigned char buf[100];
+    fill(buf, sizeof(buf));
+
+    for (auto&& d : DIGESTS) {
+        uint64 h = get_hash64(buf, d.len);
+        if (h != d.hash) {
+            printf("length %zu: got 0x%016llx\n", d.len, static_cast<unsigned long long>(h));
+        }
+        CHECK(h == d.hash);
+    }
+
+    // Digest doesn't depend on the alignment of the data
+    unsigned char moved[101];
+    memcpy(moved + 1, buf, sizeof(buf));
+    CHECK(get_hash64(moved + 1, 100) == DIGESTS[7].hash);
+    printf("digests: done\n");
+}
+
+void test_seed_key()
+{
+    unsigned char buf[16];
+    fill(buf, sizeof(buf));
+    CHECK(get_hash64(buf, sizeof(buf), 1) != get_hash64(buf, sizeof(buf)));
+
+    string key(reinterpret_cast<char*>(buf), sizeof(buf));
+    CHECK(get_key_hash(key) == get_hash64(buf, sizeof(buf), PLUTO_HASH_SEED));
+
+    // Every byte counts, and the length too
+    set<uint64 > seen;
+    for (size_t len=0; len<=64; len++) {
+        string k(len, 'k');
+        seen.insert(get_key_hash(k));
+        for (size_t i=0; i<len; i++) {
+            k[i] = 'x';
+            seen.insert(get_key_hash(k));
+            k[i] = 'k';
+        }
+    }
+    CHECK(seen.size() == 65 + 64 * 65 / 2);
+    printf("seed/key: %zu distinct hashes\n", seen.size());
+}
+
+int main(int argc, char* argv[])
+{
+    test_digests();
+    test_seed_key();
+
+    return check_result();
+}
@@ -0,0 +1,202 @@
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "stdinclude.h"
+#include "config.h"
+#include "util.h"
+#include "HotKeyCache.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+/*
+ * Hot key cache checks: only keys read up to the threshold are cached,
+ * counters decay every window, a write mark keeps a read started before
+ * the write from filling the old value, and values expire after the TTL.
+ */
+
+#define  CFG_FILE  "tsthot.json"
+
+ConfigPortal * load_config(const string& json)
+{
+    ofstream f(CFG_FILE);
+    f << json;
+    f.close();
+
+    ConfigPortal * pcfg = ConfigPortal::get_config();
+    CHECK(pcfg->load(CFG_FILE));
+    remove(CFG_FILE);
+    return pcfg;
+}
+
+ConfigPortal * load_hot_config(int threshold, int window, int ttl, int capacity)
+{
+    return load_config(
+        "{ \"STORE_PARAM\" : { \"HOT_KEY\" : {"
+        " \"THRESHOLD\" : " + to_string(threshold) + ","
+        " \"WINDOW\" : "    + to_string(window)    + ","
+        " \"TTL\" : "       + to_string(ttl)       + ","
+        " \"CAPACITY\" : "  + to_string(capacity)  + " } } }");
+}
+
+const vector<unsigned char > VALUE1(16, 'a');
+const vector<unsigned char > VALUE2(16, 'b');
+
+void record(HotKeyCache& cache, const string& key, int cnt)
+{
+    for (int i=0; i<cnt; i++) {
+        cache.record(get_key_hash(key));
+    }
+}
+
+void fill(HotKeyCache& cache, const string& key, const vector<unsigned char>& v,
+          uint64 version, HotKeyCache::TIME_POINT since, int required = 2)
+{
+    cache.fill(key, get_key_hash(key), required, v.data(), v.size(), version, since);
+}
+
+void test_threshold()
+{
+    HotKeyCache cache(load_hot_config(4, 60000, 60000, 16));
+    CHECK(cache.is_enabled());
+
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    // Below the threshold the key isn't cached
+    record(cache, "k1", 3);
+    fill(cache, "k1", VALUE1, 1, steady_clock::now());
+    CHECK(!cache.lookup("k1", 2, v, version));
+
+    record(cache, "k1", 1);
+    fill(cache, "k1", VALUE1, 1, steady_clock::now());
+    CHECK(cache.lookup("k1", 2, v, version));
+    CHECK((v == VALUE1) && (version == 1));
+
+    // Value read by fewer replies than asked isn't used
+    CHECK(!cache.lookup("k1", 3, v, version));
+    CHECK(cache.lookup("k1", 1, v, version));
+
+    // Older value doesn't replace the cached one
+    fill(cache, "k1", VALUE2, 0, steady_clock::now());
+    CHECK(cache.lookup("k1", 2, v, version));
+    CHECK((v == VALUE1) && (version == 1));
+
+    // Other keys are still cold
+    fill(cache, "k2", VALUE1, 1, steady_clock::now());
+    CHECK(!cache.lookup("k2", 2, v, version));
+    printf("threshold: done\n");
+}
+
+void test_decay()
+{
+    HotKeyCache cache(load_hot_config(4, 20, 60000, 16));
+
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    record(cache, "k1", 4);
+    this_thread::sleep_for(milliseconds(30));
+    // Counters are halved by the first read of the next window
+    record(cache, "k2", 1);
+    fill(cache, "k1", VALUE1, 1, steady_clock::now());
+    CHECK(!cache.lookup("k1", 2, v, version));
+
+    record(cache, "k1", 2);
+    fill(cache, "k1", VALUE1, 1, steady_clock::now());
+    CHECK(cache.lookup("k1", 2, v, version));
+    printf("decay: done\n");
+}
+
+void test_write_mark()
+{
+    HotKeyCache cache(load_hot_config(1, 60000, 60000, 16));
+
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    record(cache, "k1", 1);
+    fill(cache, "k1", VALUE1, 1, steady_clock::now());
+    CHECK(cache.lookup("k1", 2, v, version));
+
+    // Read started before the write
+    HotKeyCache::TIME_POINT since = steady_clock::now();
+    this_thread::sleep_for(milliseconds(1));
+    cache.invalidate("k1", get_key_hash("k1"));
+    CHECK(!cache.lookup("k1", 2, v, version));
+
+    fill(cache, "k1", VALUE1, 1, since);
+    CHECK(!cache.lookup("k1", 2, v, version));
+
+    // Read started after the write fills it
+    this_thread::sleep_for(milliseconds(1));
+    fill(cache, "k1", VALUE2, 2, steady_clock::now());
+    CHECK(cache.lookup("k1", 2, v, version));
+    CHECK((v == VALUE2) && (version == 2));
+
+    // Write of a hot key not cached yet leaves a mark too
+    record(cache, "k2", 1);
+    since = steady_clock::now();
+    this_thread::sleep_for(milliseconds(1));
+    cache.invalidate("k2", get_key_hash("k2"));
+    fill(cache, "k2", VALUE1, 1, since);
+    CHECK(!cache.lookup("k2", 2, v, version));
+    printf("write mark: done\n");
+}
+
+void test_ttl()
+{
+    HotKeyCache cache(load_hot_config(1, 60000, 20, 16));
+
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    record(cache, "k1", 1);
+    fill(cache, "k1", VALUE1, 1, steady_clock::now());
+    CHECK(cache.lookup("k1", 2, v, version));
+
+    this_thread::sleep_for(milliseconds(30));
+    CHECK(!cache.lookup("k1", 2, v, version));
+
+    // Read older than the TTL may have missed the mark of a write
+    HotKeyCache::TIME_POINT since = steady_clock::now();
+    this_thread::sleep_for(milliseconds(30));
+    fill(cache, "k1", VALUE1, 1, since);
+    CHECK(!cache.lookup("k1", 2, v, version));
+    printf("ttl: done\n");
+}
+
+void test_disabled()
+{
+    HotKeyCache cache(load_hot_config(0, 60000, 60000, 16));
+    CHECK(!cache.is_enabled());
+
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    record(cache, "k1", 10);
+    fill(cache, "k1", VALUE1, 1, steady_clock::now());
+    CHECK(!cache.lookup("k1", 2, v, version));
+    printf("disabled: done\n");
+}
+
+int main(int argc, char* argv[])
+{
+    test_threshold();
+    test_decay();
+    test_write_mark();
+    test_ttl();
+    test_disabled();
+
+    return check_result();
+}
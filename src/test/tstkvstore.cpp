@@ -0,0 +1,123 @@
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include "stdinclude.h"
+#include "KVStore.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+
+/*
+ * Store checks of conditional writes: update and delete with an expected
+ * version change the replica only when it holds that version, otherwise
+ * PLCONFLICT is returned and nothing is recorded. Repair only replaces older
+ * versions.
+ */
+
+const vector<unsigned char > VALUE1(8, 'a');
+const vector<unsigned char > VALUE2(8, 'b');
+
+// Sequence the next mutation of the store is given
+uint64 get_next_seq(KVStore& store)
+{
+    vector<ChangeRecord> v;
+    uint64 next = 0;
+    store.do_read_changes(0, 1024, v, next);
+    return next;
+}
+
+void test_update()
+{
+    KVStore store;
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    // Missing key, plain update fails, conditional one conflicts
+    CHECK(store.do_update("k1", 0, VALUE1, 2) == -1);
+    CHECK(store.do_update("k1", 0, VALUE1, 2, 1) == PLCONFLICT);
+
+    CHECK(store.do_write("k1", 0, VALUE1, 5) == 0);
+    uint64 seq = get_next_seq(store);
+
+    CHECK(store.do_update("k1", 0, VALUE2, 7, 4) == PLCONFLICT);
+    CHECK(store.do_update("k1", 0, VALUE2, 7, 6) == PLCONFLICT);
+    CHECK(store.do_read("k1", 0, v, version) == 0);
+    CHECK((v == VALUE1) && (version == 5));
+    CHECK(get_next_seq(store) == seq);
+
+    // Expected version matches, version bumped by the store
+    CHECK(store.do_update("k1", 0, VALUE2, 0, 5) == 0);
+    CHECK(store.do_read("k1", 0, v, version) == 0);
+    CHECK((v == VALUE2) && (version == 6));
+    CHECK(get_next_seq(store) == seq + 1);
+
+    // Other replica types are versioned on their own
+    CHECK(store.do_update("k1", 1, VALUE2, 0, 6) == PLCONFLICT);
+
+    // Unconditional update ignores the version held
+    CHECK(store.do_update("k1", 0, VALUE1, 9) == 0);
+    CHECK(store.do_read("k1", 0, v, version) == 0);
+    CHECK((v == VALUE1) && (version == 9));
+    printf("update: done\n");
+}
+
+void test_delete()
+{
+    KVStore store;
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    CHECK(store.do_delete("k1", 0, 1) == PLCONFLICT);
+    CHECK(store.do_delete("k1", 0) == 0);
+
+    CHECK(store.do_write("k1", 0, VALUE1, 3) == 0);
+    uint64 seq = get_next_seq(store);
+
+    CHECK(store.do_delete("k1", 0, 2) == PLCONFLICT);
+    CHECK(store.do_read("k1", 0, v, version) == 0);
+    CHECK(version == 3);
+    CHECK(get_next_seq(store) == seq);
+
+    CHECK(store.do_delete("k1", 0, 3) == 0);
+    CHECK(store.do_read("k1", 0, v, version) == -1);
+    CHECK(get_next_seq(store) == seq + 1);
+
+    // Deleted key conflicts with the version it had
+    CHECK(store.do_delete("k1", 0, 3) == PLCONFLICT);
+    printf("delete: done\n");
+}
+
+void test_repair()
+{
+    KVStore store;
+    vector<unsigned char> v;
+    uint64 version = 0;
+
+    CHECK(store.do_repair("k1", 0, VALUE1, 4) == 0);
+    CHECK(store.do_read("k1", 0, v, version) == 0);
+    CHECK((v == VALUE1) && (version == 4));
+
+    // Replica holds a newer version
+    CHECK(store.do_repair("k1", 0, VALUE2, 3) == 0);
+    CHECK(store.do_repair("k1", 0, VALUE2, 4) == 0);
+    CHECK(store.do_read("k1", 0, v, version) == 0);
+    CHECK((v == VALUE1) && (version == 4));
+
+    CHECK(store.do_repair("k1", 0, VALUE2, 5) == 0);
+    CHECK(store.do_read("k1", 0, v, version) == 0);
+    CHECK((v == VALUE2) && (version == 5));
+    printf("repair: done\n");
+}
+
+int main(int argc, char* argv[])
+{
+    test_update();
+    test_delete();
+    test_repair();
+
+    return check_result();
+}
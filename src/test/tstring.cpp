@@ -0,0 +1,217 @@
+
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "stdinclude.h"
+#include "TokenRing.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+
+/*
+ * Token ring checks: replica lists are distinct members spread over zones,
+ * independent of member order, and a joining member takes keys from the
+ * others only.
+ */
+
+#define  VNODES     128
+#define  KEY_CNT    100000
+
+MemberEntry make_member(int idx, uint16 zone)
+{
+    MemberEntry e;
+    memset(&e, 0, sizeof(e));
+    e.af         = AF_INET;
+    e.type       = SOCK_STREAM;
+    e.address[0] = 10;
+    e.address[3] = idx + 1;
+    e.portnumber = 7000;
+    e.zone       = zone;
+    return e;
+}
+
+string make_key(int i)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "key-%d", i);
+    return string(buf);
+}
+
+bool is_distinct(const vector<MemberEntry >& v)
+{
+    for (size_t i=0; i<v.size(); i++) {
+        for (size_t j=i+1; j<v.size(); j++) {
+            if (v[i] == v[j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t get_zone_count(const vector<MemberEntry >& v)
+{
+    set<int > zones;
+    int unknown = 0;
+    for (auto&& m : v) {
+        if (m.zone == 0) {
+            // Unknown zone counts as a zone of its own
+            zones.insert(-(++unknown));
+        }
+        else {
+            zones.insert(m.zone);
+        }
+    }
+    return zones.size();
+}
+
+void test_small()
+{
+    TokenRing ring;
+    CHECK(ring.get_nodes("a").empty());
+
+    // Less members than replicas
+    vector<MemberEntry > members;
+    members.push_back(make_member(0, 0));
+    members.push_back(make_member(1, 0));
+    ring.build(members, VNODES);
+    CHECK(ring.get_token_count() == 2 * VNODES);
+    for (int i=0; i<1000; i++) {
+        vector<MemberEntry > v = ring.get_nodes(make_key(i));
+        CHECK(v.size() == 2);
+        CHECK(is_distinct(v));
+    }
+
+    // At least one token a member
+    ring.build(members, 0);
+    CHECK(ring.get_token_count() == 2);
+    printf("small ring: done\n");
+}
+
+void test_preference()
+{
+    vector<MemberEntry > members;
+    for (int i=0; i<8; i++) {
+        members.push_back(make_member(i, 0));
+    }
+    TokenRing ring;
+    ring.build(members, VNODES);
+
+    // Same ring whatever order the members are listed in
+    vector<MemberEntry > reversed(members.rbegin(), members.rend());
+    TokenRing other;
+    other.build(reversed, VNODES);
+
+    map<int, size_t > primary;
+    for (int i=0; i<KEY_CNT; i++) {
+        string key = make_key(i);
+        vector<MemberEntry > v = ring.get_nodes(key);
+        CHECK(v.size() == PLUTO_NODE_REPLICAS_NUM);
+        CHECK(is_distinct(v));
+        CHECK(v == other.get_nodes(key));
+        CHECK(v == ring.get_nodes(::get_key_hash(key)));
+        primary[v[0].address[3]]++;
+    }
+
+    // Virtual nodes even out the primary share of every member
+    size_t even = KEY_CNT / members.size();
+    size_t lo = KEY_CNT, hi = 0;
+    for (auto&& p : primary) {
+        lo = min(lo, p.second);
+        hi = max(hi, p.second);
+    }
+    CHECK(primary.size() == members.size());
+    CHECK((lo > even * 3 / 4) && (hi < even * 5 / 4));
+    printf("preference: primary keys a member %zu..%zu, even %zu\n", lo, hi, even);
+}
+
+void test_join()
+{
+    vector<MemberEntry > members;
+    for (int i=0; i<6; i++) {
+        members.push_back(make_member(i, 0));
+    }
+    TokenRing before;
+    before.build(members, VNODES);
+
+    MemberEntry joined = make_member(6, 0);
+    members.push_back(joined);
+    TokenRing after;
+    after.build(members, VNODES);
+
+    // Primary moves to the joining member or stays where it was
+    size_t moved = 0;
+    for (int i=0; i<KEY_CNT; i++) {
+        string key = make_key(i);
+        MemberEntry p0 = before.get_nodes(key)[0];
+        MemberEntry p1 = after.get_nodes(key)[0];
+        if (p0 != p1) {
+            CHECK(p1 == joined);
+            moved++;
+        }
+    }
+    CHECK((moved > KEY_CNT / 14) && (moved < KEY_CNT * 3 / 14));
+    printf("join: %zu of %d keys moved\n", moved, KEY_CNT);
+}
+
+void test_zones()
+{
+    // 3 zones of 2 members, replicas in every zone
+    vector<MemberEntry > members;
+    for (int i=0; i<6; i++) {
+        members.push_back(make_member(i, i % 3 + 1));
+    }
+    TokenRing ring;
+    ring.build(members, VNODES);
+    for (int i=0; i<KEY_CNT; i++) {
+        vector<MemberEntry > v = ring.get_nodes(make_key(i));
+        CHECK(v.size() == PLUTO_NODE_REPLICAS_NUM);
+        CHECK(get_zone_count(v) == PLUTO_NODE_REPLICAS_NUM);
+    }
+
+    // 2 zones, the first replicas spread over both, the rest still distinct
+    members.clear();
+    for (int i=0; i<6; i++) {
+        members.push_back(make_member(i, i % 2 + 1));
+    }
+    ring.build(members, VNODES);
+    for (int i=0; i<KEY_CNT; i++) {
+        vector<MemberEntry > v = ring.get_nodes(make_key(i));
+        CHECK(v.size() == PLUTO_NODE_REPLICAS_NUM);
+        CHECK(is_distinct(v));
+        CHECK(v[0].zone != v[1].zone);
+    }
+
+    // Members of unknown zone mixed with a zoned pair
+    members.clear();
+    members.push_back(make_member(0, 5));
+    members.push_back(make_member(1, 5));
+    members.push_back(make_member(2, 0));
+    members.push_back(make_member(3, 0));
+    ring.build(members, VNODES);
+    for (int i=0; i<KEY_CNT; i++) {
+        vector<MemberEntry > v = ring.get_nodes(make_key(i));
+        CHECK(v.size() == PLUTO_NODE_REPLICAS_NUM);
+        CHECK(get_zone_count(v) == PLUTO_NODE_REPLICAS_NUM);
+    }
+    printf("zones: done\n");
+}
+
+int main(int argc, char* argv[])
+{
+    test_small();
+    test_preference();
+    test_join();
+    test_zones();
+
+    return check_result();
+}
@@ -0,0 +1,164 @@
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <boost/asio.hpp>
+
+#include "stdinclude.h"
+#include "config.h"
+#include "ReadMessage.h"
+#include "FairScheduler.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+using namespace boost::asio;
+
+/*
+ * Fair scheduler checks: tenants share the node in-flight limit by weight,
+ * a tenant at its own cap waits for its completions while the others go
+ * on, and without a node limit requests are dispatched at once.
+ */
+
+#define  CFG_FILE  "tstsched.json"
+
+ConfigPortal * load_config(const string& json)
+{
+    ofstream f(CFG_FILE);
+    f << json;
+    f.close();
+
+    ConfigPortal * pcfg = ConfigPortal::get_config();
+    CHECK(pcfg->load(CFG_FILE));
+    remove(CFG_FILE);
+    return pcfg;
+}
+
+StoreMessage * make_request(int32 tenant)
+{
+    StoreMessage * pmsg = new ReadRequestMessage(MessageOriginator::Client, 1);
+    pmsg->set_tenant(tenant);
+    return pmsg;
+}
+
+void test_weights()
+{
+    ConfigPortal * pcfg = load_config(
+        "{ \"STORE_PARAM\" : { \"SCHED\" : { \"MAX_INFLIGHT\" : 1 },"
+        "  \"TENANTS\" : { \"1\" : { \"WEIGHT\" : 3 }, \"2\" : { \"WEIGHT\" : 1 } } } }");
+
+    io_service io;
+    vector<int32 > order;
+    FairScheduler * psched = nullptr;
+    FairScheduler sched(io, pcfg, [&](StoreMessage* pmsg) {
+        order.push_back(pmsg->get_tenant());
+        psched->complete(pmsg->get_tenant());
+        delete pmsg;
+    });
+    psched = &sched;
+
+    for (int i=0; i<8; i++) {
+        sched.submit(make_request(1));
+    }
+    for (int i=0; i<8; i++) {
+        sched.submit(make_request(2));
+    }
+    io.run();
+
+    CHECK(order.size() == 16);
+    // Tenant 1 runs alone until tenant 2 queues, then 3 to 1 while both wait
+    const int32 expect[] = { 1, 1, 1, 2, 1, 1, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 };
+    for (size_t i=0; i<order.size() && i<16; i++) {
+        CHECK(order[i] == expect[i]);
+    }
+    printf("weights: done\n");
+}
+
+void test_caps()
+{
+    ConfigPortal * pcfg = load_config(
+        "{ \"STORE_PARAM\" : { \"SCHED\" : { \"MAX_INFLIGHT\" : 4 },"
+        "  \"TENANTS\" : { \"3\" : { \"MAX_INFLIGHT\" : 1 } } } }");
+
+    io_service io;
+    map<int32, int > inflight;
+    map<int32, int > dispatched;
+    int max_capped = 0;
+    FairScheduler sched(io, pcfg, [&](StoreMessage* pmsg) {
+        int32 tenant = pmsg->get_tenant();
+        inflight[tenant]++;
+        dispatched[tenant]++;
+        if (tenant == 3) {
+            max_capped = max(max_capped, inflight[tenant]);
+        }
+        delete pmsg;
+    });
+
+    for (int i=0; i<3; i++) {
+        sched.submit(make_request(3));
+    }
+    for (int i=0; i<3; i++) {
+        sched.submit(make_request(4));
+    }
+    io.run();
+
+    // Capped tenant holds one slot, the others are left to tenant 4
+    CHECK(dispatched[3] == 1);
+    CHECK(dispatched[4] == 3);
+
+    // Completion of tenant 4 frees a node slot, tenant 3 is still capped
+    inflight[4]--;
+    sched.complete(4);
+    io.reset();
+    io.run();
+    CHECK(dispatched[3] == 1);
+
+    // Completion of tenant 3 lets its next request go
+    inflight[3]--;
+    sched.complete(3);
+    io.reset();
+    io.run();
+    CHECK(dispatched[3] == 2);
+
+    inflight[3]--;
+    sched.complete(3);
+    io.reset();
+    io.run();
+    CHECK(dispatched[3] == 3);
+    CHECK(max_capped == 1);
+    printf("caps: done\n");
+}
+
+void test_disabled()
+{
+    ConfigPortal * pcfg = load_config(
+        "{ \"STORE_PARAM\" : { \"SCHED\" : { \"MAX_INFLIGHT\" : 0 } } }");
+
+    io_service io;
+    size_t dispatched = 0;
+    FairScheduler sched(io, pcfg, [&](StoreMessage* pmsg) {
+        dispatched++;
+        delete pmsg;
+    });
+
+    // Dispatched by the caller, nothing waits for the strand
+    for (int i=0; i<10; i++) {
+        sched.submit(make_request(i % 2));
+    }
+    CHECK(dispatched == 10);
+    printf("disabled: done\n");
+}
+
+int main(int argc, char* argv[])
+{
+    test_weights();
+    test_caps();
+    test_disabled();
+
+    return check_result();
+}
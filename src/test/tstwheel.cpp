@@ -0,0 +1,171 @@
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <map>
+#include <vector>
+
+#include "stdinclude.h"
+#include "TimingWheel.h"
+
+#include "tstcheck.h"
+
+using namespace std;
+
+/*
+ * Timing wheel checks: every timer fires at the first advance reaching its
+ * tick, across the wraps of level 0 and the upper levels.
+ */
+
+// Advance tick by tick to 'end', the tick every timer fired at is kept
+void run_ticks(TimingWheel& tw, uint64 end, map<TimingWheel::TIMER_ID, uint64 >& fired)
+{
+    vector<TimingWheel::TIMER_ID > expired;
+    for (uint64 now = tw.get_now(); now <= end; now++) {
+        expired.clear();
+        tw.advance(now, expired);
+        for (auto&& id : expired) {
+            CHECK(fired.find(id) == fired.end());
+            fired[id] = now;
+        }
+    }
+}
+
+void test_cascade()
+{
+    // Level 0 wrap, level 1 wrap and a level 2 timer
+    const uint64 expires[] = { 1, 10, 255, 256, 257, 300, 511, 512,
+                               16383, 16384, 16385, 70000, 1048577 };
+    const size_t cnt = sizeof(expires) / sizeof(expires[0]);
+
+    TimingWheel tw(0);
+    for (size_t i=0; i<cnt; i++) {
+        tw.add(i, expires[i]);
+    }
+    CHECK(tw.size() == cnt);
+
+    map<TimingWheel::TIMER_ID, uint64 > fired;
+    run_ticks(tw, expires[cnt-1], fired);
+
+    CHECK(tw.empty());
+    CHECK(fired.size() == cnt);
+    for (size_t i=0; i<cnt; i++) {
+        CHECK(fired[i] == expires[i]);
+    }
+    printf("cascade: %zu timers checked\n", cnt);
+}
+
+void test_start_offset()
+{
+    // Wheel not starting at 0, first timer crosses the level 0 wrap
+    TimingWheel tw(250);
+    tw.add(1, 260);
+    tw.add(2, 250 + 256);
+    tw.add(3, 250 + 300);
+
+    map<TimingWheel::TIMER_ID, uint64 > fired;
+    run_ticks(tw, 600, fired);
+
+    CHECK(fired[1] == 260);
+    CHECK(fired[2] == 250 + 256);
+    CHECK(fired[3] == 250 + 300);
+    printf("start offset: done\n");
+}
+
+void test_cancel_replace()
+{
+    TimingWheel tw(0);
+    tw.add(1, 100);
+    tw.add(2, 1000);
+    tw.add(3, 20000);
+    // Replaced timer fires at the new tick only
+    tw.add(1, 700);
+
+    CHECK(tw.cancel(3));
+    CHECK(!tw.cancel(3));
+    CHECK(tw.size() == 2);
+
+    map<TimingWheel::TIMER_ID, uint64 > fired;
+    run_ticks(tw, 30000, fired);
+
+    CHECK(fired.size() == 2);
+    CHECK(fired[1] == 700);
+    CHECK(fired[2] == 1000);
+    CHECK(fired.find(3) == fired.end());
+    // Expired already
+    CHECK(!tw.cancel(2));
+    printf("cancel/replace: done\n");
+}
+
+void test_jump()
+{
+    // Timers passed by one advance all fire, later ones don't
+    TimingWheel tw(0);
+    vector<TimingWheel::TIMER_ID > expired;
+    tw.advance(1000, expired);
+    CHECK(expired.empty());
+
+    tw.add(1, 500);       // passed already, fires on next advance
+    tw.add(2, 1300);
+    tw.add(3, 5000);
+    tw.add(4, 5001);
+
+    tw.advance(1001, expired);
+    CHECK((expired.size() == 1) && (expired[0] == 1));
+
+    expired.clear();
+    tw.advance(5000, expired);
+    CHECK(expired.size() == 2);
+    CHECK(tw.size() == 1);
+
+    expired.clear();
+    tw.advance(5001, expired);
+    CHECK((expired.size() == 1) && (expired[0] == 4));
+    CHECK(tw.empty());
+    printf("jump: done\n");
+}
+
+void test_random()
+{
+    // Random expires and advance steps, a timer never fires early nor
+    // later than the first advance past its tick
+    const int TIMER_CNT = 20000;
+    srand(20200601);
+
+    TimingWheel tw(0);
+    map<TimingWheel::TIMER_ID, uint64 > expires;
+    for (int i=0; i<TIMER_CNT; i++) {
+        uint64 e = rand() % (1 << 20);
+        tw.add(i, e);
+        expires[i] = e;
+    }
+
+    size_t fired = 0;
+    uint64 prev = 0;
+    vector<TimingWheel::TIMER_ID > expired;
+    while (!tw.empty() && (prev < (1 << 20))) {
+        uint64 now = prev + 1 + rand() % 3000;
+        expired.clear();
+        tw.advance(now, expired);
+        for (auto&& id : expired) {
+            CHECK(expires[id] <= now);
+            CHECK((expires[id] > prev) || (prev == 0));
+            fired++;
+        }
+        prev = now;
+    }
+    CHECK(tw.empty());
+    CHECK(fired == TIMER_CNT);
+    printf("random: %zu timers fired\n", fired);
+}
+
+int main(int argc, char* argv[])
+{
+    test_cascade();
+    test_start_offset();
+    test_cancel_replace();
+    test_jump();
+    test_random();
+
+    return check_result();
+}